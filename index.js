@@ -1,53 +1,64 @@
 var native = require( 'bindings' )( 'addon' );
 
-module.exports.load = function( path ) {
+/**
+ * Loads the type library.
+ *
+ * Options:
+ * - lazy: Initialize the types only when they are first used instead of
+ *         during load.
+ * - snapshot: Path to a metadata snapshot created with writeSnapshot().
+ *             Ignored if it doesn't match the library.
+ */
+module.exports.load = function( path, options ) {
+
+    options = options || {};
 
     // Load the native library.
-    var lib = native.load( path );
-
-    // Enhance the types.
-    Object.keys( lib ).forEach( function( obj ) {
-
-        // Go through all prototype methods.
-        var cls = lib[ obj ];
-
-        // Gather all gettable/settable properties.
-        var properties = {};
-        Object.keys( cls.prototype ).forEach( function( funcName ) {
-
-            var func = cls.prototype[ funcName ];
-
-            // Only interested in getter/setter properties.
-            var propName = func.getter || func.setter;
-            if( !propName )
-                return;
-
-            // Ensure we got the property tracked.
-            properties[ propName ] = properties[ propName ] || {};
-            
-            // Check whether the current function is getter or setter.
-            if( func.getter ) {
-
-                // Getter. Define the getter alias.
-                properties[ propName ].get = function() {
-                    return this[ funcName ].apply( this, arguments );
-                };
-
-            } else if( func.setter ) {
-                
-                // Setter. Define the setter alias.
-                properties[ propName ].set = function() {
-                    return this[ funcName ].apply( this, arguments );
-                };
-            }
-        } );
-
-        // Define all the proeprties on the object prototype.
-        Object.keys( properties ).forEach( function( propName ) {
-            Object.defineProperty( cls.prototype, propName, properties[ propName ] );
-        } );
+    return native.load( path, {
+        lazy: !!options.lazy,
+        snapshot: options.snapshot
     } );
-
-    return lib;
 };
 
+// Precompiles the library metadata for faster loading: writeSnapshot( library, snapshot ).
+module.exports.writeSnapshot = native.writeSnapshot;
+
+// Generates vtable bindings and TypeScript declarations: writeBindings( library, { source, declarations } ).
+module.exports.writeBindings = native.writeBindings;
+
+// Executes the async calls made in the callback in one worker thread trip.
+module.exports.batch = native.batch;
+
+// Runs a call chain in the worker: pipeline( obj, [ 'Vault', [ 'Item', 1 ], 'Name' ] ).
+module.exports.pipeline = native.pipeline;
+
+// Reads properties of every collection item into columns: project( collection, [ 'ID', 'Name' ] ).
+module.exports.project = native.project;
+
+// Reads an object graph into plain values: readGraph( obj, { Name: true, Items: [ { ID: true } ] } ).
+module.exports.readGraph = native.readGraph;
+
+// Async call thread pool: configurePool( { threads } ) before the first async call, { completionBudget } any time.
+module.exports.configurePool = native.configurePool;
+module.exports.poolStats = native.poolStats;
+
+// Vtable calls for dual interfaces: configureDirectCalls( { enabled } ).
+module.exports.configureDirectCalls = native.configureDirectCalls;
+
+// Async call state recycling: { slabs, capacity, inUse, free, acquired }.
+module.exports.batonStats = native.batonStats;
+
+// Enumeration chunk size: configureIterators( { chunkSize } ).
+module.exports.configureIterators = native.configureIterators;
+
+// Live counts of the BSTRs, VARIANTs, arrays and interfaces held by the addon.
+module.exports.resourceStats = native.resourceStats;
+
+// Load time statistics for a loaded library.
+module.exports.stats = native.stats;
+
+// Diagnostics for the HREFTYPE resolution cache.
+module.exports.refCacheStats = native.refCacheStats;
+
+// Debug builds only: number of heap allocations made by the addon so far.
+module.exports.allocationCount = native.allocationCount;
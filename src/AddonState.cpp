@@ -0,0 +1,48 @@
+#include "AddonState.h"
+
+#include <cassert>
+
+thread_local AddonState* AddonState::current = nullptr;
+
+AddonState& AddonState::Current()
+{
+	assert( current != nullptr );
+	return *current;
+}
+
+AddonState* AddonState::Create()
+{
+	if( current != nullptr )
+		return nullptr;
+
+	current = new AddonState();
+	return current;
+}
+
+void AddonState::AtExit( void ( *callback )() )
+{
+	Current().exitCallbacks.push_back( callback );
+}
+
+void AddonState::Destroy( void* arg )
+{
+	AddonState* addon = static_cast< AddonState* >( arg );
+	delete addon;
+	if( current == addon )
+		current = nullptr;
+}
+
+AddonState::~AddonState()
+{
+	// The callbacks stop the work that still refers to the states.
+	for( auto it = exitCallbacks.rbegin(); it != exitCallbacks.rend(); ++it )
+		( *it )();
+
+	// States can still be looked up while the others are destroyed.
+	while( !slots.empty() )
+	{
+		Slot slot = slots.back();
+		slots.pop_back();
+		slot.destroy( slot.value );
+	}
+}
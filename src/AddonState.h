@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * State of the addon in one Node.js environment.
+ *
+ * The addon is loaded once per environment: the main thread and each
+ * worker_threads Worker have their own isolate and event loop. The modules
+ * keep their persistent handles, type registries and loop handles in a
+ * State struct of their own that is reached through Get< State >() from
+ * the thread running the environment.
+ *
+ * The states are created on first use and destroyed in reverse order when
+ * the environment exits, while the isolate is still alive.
+ *
+ * Does not depend on V8. The module creates the state when the environment
+ * loads the addon and destroys it from the environment cleanup hook.
+ */
+class AddonState
+{
+public:
+	/**
+	 * Creates the state of the environment running on this thread. Returns
+	 * null if the environment already has one.
+	 */
+	static AddonState* Create();
+
+	/**
+	 * Runs the exit callbacks and destroys the states. Takes the AddonState
+	 * as the argument of the cleanup hook.
+	 */
+	static void Destroy( void* arg );
+
+	/**
+	 * Returns the state of type T in the current environment.
+	 */
+	template< typename T >
+	static T& Get()
+	{
+		AddonState& addon = Current();
+		for( auto&& slot : addon.slots )
+			if( slot.key == &Key< T >::id )
+				return *static_cast< T* >( slot.value );
+
+		T* value = new T();
+		addon.slots.push_back( Slot( &Key< T >::id, value, &Destroy< T > ) );
+		return *value;
+	}
+
+	/**
+	 * Registers a function called before the states are destroyed.
+	 */
+	static void AtExit( void ( *callback )() );
+
+private:
+	AddonState() {}
+	~AddonState();
+
+	struct Slot
+	{
+		Slot( const void* key, void* value, void ( *destroy )( void* ) ) : key( key ), value( value ), destroy( destroy ) {}
+
+		const void* key;
+		void* value;
+		void ( *destroy )( void* );
+	};
+
+	template< typename T >
+	struct Key { static const char id; };
+
+	template< typename T >
+	static void Destroy( void* value ) { delete static_cast< T* >( value ); }
+
+	static AddonState& Current();
+
+	std::vector< Slot > slots;
+	std::vector< void ( * )() > exitCallbacks;
+
+	// Each environment runs on a thread of its own.
+	static thread_local AddonState* current;
+};
+
+template< typename T >
+const char AddonState::Key< T >::id = 0;
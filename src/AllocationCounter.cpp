@@ -0,0 +1,54 @@
+#include "AllocationCounter.h"
+
+#ifdef DEBUG
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic< uint64_t > allocations( 0 );
+
+	void* CountedAlloc( size_t size )
+	{
+		allocations++;
+		void* ptr = malloc( size != 0 ? size : 1 );
+		if( ptr == nullptr )
+			throw std::bad_alloc();
+
+		return ptr;
+	}
+}
+
+void* operator new( size_t size ) { return CountedAlloc( size ); }
+void* operator new[]( size_t size ) { return CountedAlloc( size ); }
+void* operator new( size_t size, const std::nothrow_t& ) noexcept { allocations++; return malloc( size != 0 ? size : 1 ); }
+void* operator new[]( size_t size, const std::nothrow_t& ) noexcept { allocations++; return malloc( size != 0 ? size : 1 ); }
+void operator delete( void* ptr ) noexcept { free( ptr ); }
+void operator delete[]( void* ptr ) noexcept { free( ptr ); }
+void operator delete( void* ptr, const std::nothrow_t& ) noexcept { free( ptr ); }
+void operator delete[]( void* ptr, const std::nothrow_t& ) noexcept { free( ptr ); }
+
+uint64_t AllocationCounter::Count()
+{
+	return allocations.load();
+}
+
+/**
+ * Returns the number of allocations made so far.
+ */
+NAN_METHOD( AllocationCounter::GetCount )
+{
+	info.GetReturnValue().Set( Nan::New< v8::Number >( static_cast< double >( Count() ) ) );
+}
+
+void AllocationCounter::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > count = Nan::New< v8::FunctionTemplate >( GetCount );
+	exports->Set( Nan::New( "allocationCount" ).ToLocalChecked(), count->GetFunction() );
+}
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <nan.h>
+
+#include <cstdint>
+
+/**
+ * Counts the heap allocations made by the addon.
+ *
+ * Only available in debug builds where the global operator new of the addon
+ * is replaced with a counting one. Used for checking that the hot paths,
+ * such as the synchronous invocation, don't allocate.
+ */
+class AllocationCounter
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+	static NAN_METHOD( GetCount );
+
+	static uint64_t Count();
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "utils.h"
+
+#include <new>
+
+/**
+ * DISPPARAMS argument array with inline storage.
+ *
+ * Calls with up to InlineCount parameters keep the arguments on the stack.
+ * Longer argument lists fall back to the heap.
+ */
+class ArgBuffer
+{
+public:
+	static const size_t InlineCount = 8;
+
+	explicit ArgBuffer( size_t count ) : count( count )
+	{
+		if( count <= InlineCount )
+		{
+			args = reinterpret_cast< CComVariant* >( storage );
+			for( size_t i = 0; i < count; i++ )
+				new( &args[ i ] ) CComVariant();
+		}
+		else
+		{
+			args = new CComVariant[ count ];
+		}
+	}
+
+	~ArgBuffer()
+	{
+		if( count <= InlineCount )
+		{
+			for( size_t i = 0; i < count; i++ )
+				args[ i ].~CComVariant();
+		}
+		else
+		{
+			delete[] args;
+		}
+	}
+
+	CComVariant* data() { return args; }
+	size_t size() const { return count; }
+
+private:
+	ArgBuffer( const ArgBuffer& );
+	ArgBuffer& operator=( const ArgBuffer& );
+
+	CComVariant* args;
+	size_t count;
+	alignas( CComVariant ) unsigned char storage[ InlineCount * sizeof( CComVariant ) ];
+};
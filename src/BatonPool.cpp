@@ -0,0 +1,60 @@
+#include "BatonPool.h"
+
+#include "AddonState.h"
+#include "InvokeBaton.h"
+
+BatonPool::State& BatonPool::Get()
+{
+	return AddonState::Get< State >();
+}
+
+InvokeBaton* BatonPool::Acquire()
+{
+	State& state = Get();
+	if( state.free.empty() )
+	{
+		std::unique_ptr< InvokeBaton[] > slab( new InvokeBaton[ SlabSize ] );
+		state.free.reserve( state.free.size() + SlabSize );
+		for( size_t i = SlabSize; i > 0; --i )
+			state.free.push_back( &slab[ i - 1 ] );
+		state.slabs.push_back( std::move( slab ) );
+	}
+
+	InvokeBaton* baton = state.free.back();
+	state.free.pop_back();
+	state.acquired++;
+	state.inUse++;
+	return baton;
+}
+
+void BatonPool::Release( InvokeBaton* baton )
+{
+	baton->Reset();
+
+	State& state = Get();
+	state.free.push_back( baton );
+	state.inUse--;
+}
+
+/**
+ * Returns the baton allocation statistics.
+ */
+NAN_METHOD( BatonPool::GetStats )
+{
+	State& state = Get();
+	v8::Local< v8::Object > stats = Nan::New< v8::Object >();
+	Nan::Set( stats, Nan::New( "slabs" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.slabs.size() ) ) );
+	Nan::Set( stats, Nan::New( "capacity" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.slabs.size() * SlabSize ) ) );
+	Nan::Set( stats, Nan::New( "inUse" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.inUse ) ) );
+	Nan::Set( stats, Nan::New( "free" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.free.size() ) ) );
+	Nan::Set( stats, Nan::New( "acquired" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.acquired ) ) );
+	info.GetReturnValue().Set( stats );
+}
+
+void BatonPool::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > stats = Nan::New< v8::FunctionTemplate >( GetStats );
+	exports->Set( Nan::New( "batonStats" ).ToLocalChecked(), stats->GetFunction() );
+}
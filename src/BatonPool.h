@@ -0,0 +1,55 @@
+#pragma once
+
+#include <nan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct InvokeBaton;
+
+/**
+ * Recycled InvokeBatons for the asynchronous calls.
+ *
+ * The batons are allocated in slabs and returned to a free list once their
+ * call has completed. Released batons have their handles reset and their
+ * result cleared but keep the capacity of the argument vector so calls with
+ * the same arity don't reallocate it.
+ *
+ * Only used from the v8 thread. Each environment has a pool of its own.
+ */
+class BatonPool
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+	static NAN_METHOD( GetStats );
+
+	// Batons allocated at once when the free list runs out.
+	static const size_t SlabSize = 64;
+
+	static InvokeBaton* Acquire();
+	static void Release( InvokeBaton* baton );
+
+	struct Deleter
+	{
+		void operator()( InvokeBaton* baton ) const { Release( baton ); }
+	};
+
+	typedef std::unique_ptr< InvokeBaton, Deleter > Ptr;
+
+private:
+	struct State
+	{
+		State() : acquired( 0 ), inUse( 0 ) {}
+
+		std::vector< std::unique_ptr< InvokeBaton[] > > slabs;
+		std::vector< InvokeBaton* > free;
+
+		uint64_t acquired;
+		size_t inUse;
+	};
+
+	// The async calls still running are released before the pool is destroyed.
+	static State& Get();
+};
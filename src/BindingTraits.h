@@ -0,0 +1,210 @@
+#pragma once
+
+#include "utils.h"
+#include "DirectCall.h"
+#include "StaticBinding.h"
+
+#include <tuple>
+#include <utility>
+
+/**
+ * Marshaling traits and vtable thunks for the generated bindings.
+ *
+ * The generated sources describe each member with the traits of its
+ * parameters. The thunk converts the marshaled VARIANTs into the native
+ * types and calls the vtable slot through a function pointer of the exact
+ * signature, so the compiler takes care of the calling convention.
+ */
+
+/**
+ * Values stored in the VARIANT union.
+ */
+template< typename T, VARTYPE Vt >
+struct BindingScalar
+{
+	typedef T Native;
+
+	static bool FromArg( VARIANT& arg, CComVariant& scratch, OUT Native& value )
+	{
+		VARIANT* source = &arg;
+		if( arg.vt != Vt )
+		{
+			if( FAILED( scratch.ChangeType( Vt, &arg ) ) )
+				return false;
+			source = &scratch;
+		}
+
+		// All the union members start at the same address.
+		value = *reinterpret_cast< const Native* >( &source->llVal );
+		return true;
+	}
+
+	static void ToResult( Native value, OUT VARIANT& result )
+	{
+		result.vt = Vt;
+		*reinterpret_cast< Native* >( &result.llVal ) = value;
+	}
+};
+
+template< VARTYPE Vt > struct BindingTraits;
+template<> struct BindingTraits< VT_I1 > : BindingScalar< CHAR, VT_I1 > {};
+template<> struct BindingTraits< VT_UI1 > : BindingScalar< BYTE, VT_UI1 > {};
+template<> struct BindingTraits< VT_I2 > : BindingScalar< SHORT, VT_I2 > {};
+template<> struct BindingTraits< VT_UI2 > : BindingScalar< USHORT, VT_UI2 > {};
+template<> struct BindingTraits< VT_I4 > : BindingScalar< LONG, VT_I4 > {};
+template<> struct BindingTraits< VT_UI4 > : BindingScalar< ULONG, VT_UI4 > {};
+template<> struct BindingTraits< VT_INT > : BindingScalar< INT, VT_INT > {};
+template<> struct BindingTraits< VT_UINT > : BindingScalar< UINT, VT_UINT > {};
+template<> struct BindingTraits< VT_I8 > : BindingScalar< LONGLONG, VT_I8 > {};
+template<> struct BindingTraits< VT_UI8 > : BindingScalar< ULONGLONG, VT_UI8 > {};
+template<> struct BindingTraits< VT_R4 > : BindingScalar< FLOAT, VT_R4 > {};
+template<> struct BindingTraits< VT_R8 > : BindingScalar< DOUBLE, VT_R8 > {};
+template<> struct BindingTraits< VT_BOOL > : BindingScalar< VARIANT_BOOL, VT_BOOL > {};
+template<> struct BindingTraits< VT_ERROR > : BindingScalar< SCODE, VT_ERROR > {};
+template<> struct BindingTraits< VT_DATE > : BindingScalar< DATE, VT_DATE > {};
+template<> struct BindingTraits< VT_BSTR > : BindingScalar< BSTR, VT_BSTR > {};
+
+/**
+ * VARIANTs by value. The callee gets a shallow copy of the marshaled argument.
+ */
+template<> struct BindingTraits< VT_VARIANT >
+{
+	typedef VARIANT Native;
+
+	static bool FromArg( VARIANT& arg, CComVariant& scratch, OUT Native& value )
+	{
+		value = arg;
+		return true;
+	}
+
+	static void ToResult( Native value, OUT VARIANT& result )
+	{
+		result = value;
+	}
+};
+
+/**
+ * Interface pointers queried for the declared interface.
+ */
+template< const IID* Iid, VARTYPE Vt = VT_DISPATCH >
+struct BindingInterface
+{
+	typedef IUnknown* Native;
+
+	static bool FromArg( VARIANT& arg, CComVariant& scratch, OUT Native& value )
+	{
+		value = nullptr;
+		if( arg.vt == VT_EMPTY || arg.vt == VT_NULL )
+			return true;
+
+		if( ( arg.vt != VT_DISPATCH && arg.vt != VT_UNKNOWN ) )
+			return false;
+		if( arg.punkVal == nullptr )
+			return true;
+
+		// The scratch VARIANT releases the queried interface.
+		if( FAILED( arg.punkVal->QueryInterface( *Iid, OUT reinterpret_cast< void** >( &scratch.punkVal ) ) ) )
+			return false;
+
+		scratch.vt = VT_UNKNOWN;
+		value = scratch.punkVal;
+		return true;
+	}
+
+	static void ToResult( Native value, OUT VARIANT& result )
+	{
+		result.vt = Vt;
+		result.punkVal = value;
+	}
+};
+
+template<> struct BindingTraits< VT_DISPATCH > : BindingInterface< &IID_IDispatch, VT_DISPATCH > {};
+template<> struct BindingTraits< VT_UNKNOWN > : BindingInterface< &IID_IUnknown, VT_UNKNOWN > {};
+
+/**
+ * Result of members without a [retval].
+ */
+struct BindingNoResult {};
+
+template< typename Result >
+struct BindingResult
+{
+	template< typename... Args >
+	static HRESULT Call( void* fn, IUnknown* self, OUT VARIANT& result, Args... args )
+	{
+		typedef HRESULT ( STDMETHODCALLTYPE* Fn )( IUnknown*, Args..., typename Result::Native* );
+
+		typename Result::Native value = typename Result::Native();
+		HRESULT hr = reinterpret_cast< Fn >( fn )( self, args..., &value );
+		if( SUCCEEDED( hr ) )
+			Result::ToResult( value, OUT result );
+
+		return hr;
+	}
+};
+
+template<>
+struct BindingResult< BindingNoResult >
+{
+	template< typename... Args >
+	static HRESULT Call( void* fn, IUnknown* self, OUT VARIANT& result, Args... args )
+	{
+		typedef HRESULT ( STDMETHODCALLTYPE* Fn )( IUnknown*, Args... );
+		return reinterpret_cast< Fn >( fn )( self, args... );
+	}
+};
+
+template< const IID* Iid, size_t Slot, typename Result, typename Indices, typename... Params >
+struct BindingThunk;
+
+template< const IID* Iid, size_t Slot, typename Result, size_t... I, typename... Params >
+struct BindingThunk< Iid, Slot, Result, std::index_sequence< I... >, Params... >
+{
+	static bool Invoke(
+			IDispatch* obj,
+			CComVariant* args,
+			size_t argCount,
+			OUT VARIANT* presult,
+			OUT EXCEPINFO* pexcepInfo,
+			OUT HRESULT& hr )
+	{
+		if( argCount != sizeof...( Params ) )
+			return false;
+
+		static std::atomic< void* > dualVtable( nullptr );
+		CComPtr< IUnknown > queried;
+		IUnknown* target = DirectCall::VtableTarget( obj, *Iid, dualVtable, OUT queried );
+		if( target == nullptr )
+			return false;
+
+		// The arguments are in DISPPARAMS order, last parameter first.
+		// Omitted arguments need the defaults of the IDispatch path.
+		std::tuple< typename Params::Native... > values;
+		CComVariant scratch[ sizeof...( Params ) + 1 ];
+		bool converted[] = { true, (
+				!( args[ argCount - 1 - I ].vt == VT_ERROR && args[ argCount - 1 - I ].scode == DISP_E_PARAMNOTFOUND ) &&
+				Params::FromArg( args[ argCount - 1 - I ], scratch[ I ], OUT std::get< I >( values ) ) )... };
+		for( bool ok : converted )
+			if( !ok )
+				return false;
+
+		ResultVariant unused;
+		VARIANT& result = presult != nullptr ? *presult : unused;
+		VariantClear( &result );
+
+		void** vtable = *reinterpret_cast< void*** >( target );
+		hr = BindingResult< Result >::Call( vtable[ Slot ], target, OUT result, std::get< I >( values )... );
+		if( FAILED( hr ) )
+			hr = DirectCall::FillException( target, *Iid, hr, OUT pexcepInfo );
+
+		return true;
+	}
+};
+
+/**
+ * Thunk of a generated member: BindingCall< &Iid, slot, result traits, parameter traits... >.
+ */
+template< const IID* Iid, size_t Slot, typename Result, typename... Params >
+struct BindingCall : BindingThunk< Iid, Slot, Result, std::index_sequence_for< Params... >, Params... >
+{
+};
@@ -0,0 +1,554 @@
+#include "BindingWriter.h"
+
+#include <cstdio>
+#include <set>
+
+namespace
+{
+	// FUNCKIND, CALLCONV and INVOKEKIND values.
+	const uint8_t FuncVirtual = 0;
+	const uint8_t FuncPureVirtual = 1;
+	const uint8_t CallConvStdcall = 4;
+	const uint8_t InvokePropertyGet = 2;
+	const uint8_t InvokePropertyPut = 4;
+	const uint8_t InvokePropertyPutRef = 8;
+
+	// FUNCFLAG_FRESTRICTED, PARAMFLAG_FOUT, PARAMFLAG_FOPT and IMPLTYPEFLAG_FDEFAULT.
+	const uint16_t FuncFlagRestricted = 0x1;
+	const uint16_t ParamFlagOut = 0x2;
+	const uint16_t ParamFlagOpt = 0x10;
+	const int32_t ImplTypeFlagDefault = 0x1;
+
+	const uint16_t VtHresult = 25;
+	const int32_t DispidNewEnum = -4;
+
+	// Same limit as DirectCall.
+	const size_t MaxParams = 16;
+
+	// Bases are followed only this deep to survive cyclic references in corrupt files.
+	const int MaxInheritanceDepth = 32;
+
+	/**
+	 * Returns the VT_ name of the types passed in the VARIANT union or null.
+	 */
+	const char* ScalarName( uint16_t vt )
+	{
+		switch( vt )
+		{
+		case 2: return "VT_I2";
+		case 3: return "VT_I4";
+		case 4: return "VT_R4";
+		case 5: return "VT_R8";
+		case 7: return "VT_DATE";
+		case 8: return "VT_BSTR";
+		case 9: return "VT_DISPATCH";
+		case 10: return "VT_ERROR";
+		case 11: return "VT_BOOL";
+		case 12: return "VT_VARIANT";
+		case 13: return "VT_UNKNOWN";
+		case 16: return "VT_I1";
+		case 17: return "VT_UI1";
+		case 18: return "VT_UI2";
+		case 19: return "VT_UI4";
+		case 20: return "VT_I8";
+		case 21: return "VT_UI8";
+		case 22: return "VT_INT";
+		case 23: return "VT_UINT";
+		default: return nullptr;
+		}
+	}
+
+	bool IsNumeric( uint16_t vt )
+	{
+		switch( vt )
+		{
+		case 2: case 3: case 4: case 5: case 6: case 10: case 14:
+		case 16: case 17: case 18: case 19: case 20: case 21: case 22: case 23:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	std::string InvokeKindName( uint8_t invkind )
+	{
+		switch( invkind )
+		{
+		case InvokePropertyGet: return "INVOKE_PROPERTYGET";
+		case InvokePropertyPut: return "INVOKE_PROPERTYPUT";
+		case InvokePropertyPutRef: return "INVOKE_PROPERTYPUTREF";
+		default: return "INVOKE_FUNC";
+		}
+	}
+
+	/**
+	 * Parameter names that can't be used as TypeScript identifiers.
+	 */
+	std::string TsName( const std::string& name, size_t index )
+	{
+		static const std::set< std::string > reserved = {
+			"break", "case", "catch", "class", "const", "continue", "debugger", "default", "delete",
+			"do", "else", "enum", "export", "extends", "false", "finally", "for", "function", "if",
+			"import", "in", "instanceof", "new", "null", "return", "super", "switch", "this", "throw",
+			"true", "try", "typeof", "var", "void", "while", "with"
+		};
+
+		if( name.empty() )
+			return "arg" + std::to_string( index );
+
+		return reserved.count( name ) ? name + "_" : name;
+	}
+}
+
+bool BindingWriter::WriteFile( const std::string& content, const std::string& path )
+{
+	FILE* file = fopen( path.c_str(), "wb" );
+	if( file == nullptr )
+		return false;
+
+	bool success = fwrite( content.data(), 1, content.size(), file ) == content.size();
+	return fclose( file ) == 0 && success;
+}
+
+/**
+ * Generates the C++ source with the vtable thunks of the dual interfaces.
+ */
+std::string BindingWriter::WriteSource( const TypeLibReader& reader )
+{
+	BindingWriter writer( reader );
+
+	std::stringstream members;
+	std::stringstream interfaces;
+	size_t interfaceCount = 0;
+
+	for( size_t t = 0; t < reader.types.size(); ++t )
+	{
+		const TypeLibReader::TypeInfo& type = reader.types[ t ];
+		if( type.typekind != TypeLibReader::TkDispatch || ( type.flags & TypeLibReader::TypeFlagDual ) == 0 )
+			continue;
+
+		std::vector< TypeLibReader::FuncInfo > funcs;
+		writer.CollectVtable( type, funcs, 0 );
+
+		std::stringstream entries;
+		size_t entryCount = 0;
+		for( size_t f = 0; f < funcs.size(); ++f )
+		{
+			const TypeLibReader::FuncInfo& func = funcs[ f ];
+
+			std::string result;
+			std::vector< std::string > params;
+			if( !writer.MemberTraits( func, result, params ) )
+				continue;
+
+			char memid[ 16 ];
+			snprintf( memid, sizeof( memid ), "0x%08X", static_cast< uint32_t >( func.memid ) );
+
+			entries << "\t\t// " << func.name << "\n";
+			entries << "\t\t{ static_cast< MEMBERID >( " << memid << " ), " << InvokeKindName( func.invkind ) << ",\n";
+			entries << "\t\t\t&BindingCall< &" << writer.IidName( type ) << ", "
+					<< func.oVft / reader.PointerSize() << ", " << result;
+			for( size_t p = 0; p < params.size(); ++p )
+				entries << ", " << params[ p ];
+			entries << " >::Invoke },\n";
+			entryCount++;
+		}
+
+		if( entryCount == 0 )
+			continue;
+
+		members << "\t// " << type.name << "\n";
+		members << "\tconst StaticBinding::Member Members_" << type.name << "[] = {\n" << entries.str() << "\t};\n\n";
+		interfaces << "\t\t{ &" << writer.IidName( type ) << ", Members_" << type.name << ", " << entryCount << " },\n";
+		interfaceCount++;
+	}
+
+	std::stringstream out;
+	out << "// Generated by cominterop.writeBindings() from " << reader.name << " "
+		<< reader.majorVersion << "." << reader.minorVersion << ". Do not edit.\n";
+	out << "// Compiled into the addon when placed in src/.\n\n";
+	out << "#include \"BindingTraits.h\"\n\n";
+	out << "namespace\n{\n";
+	out << writer.iids.str();
+	if( !writer.iidNames.empty() )
+		out << "\n";
+	out << members.str();
+
+	if( interfaceCount > 0 )
+	{
+		out << "\tconst StaticBinding::Interface Interfaces[] = {\n" << interfaces.str() << "\t};\n\n";
+		out << "\tStaticBinding::Registration registration( Interfaces, " << interfaceCount << " );\n";
+	}
+
+	out << "}\n";
+	return out.str();
+}
+
+/**
+ * Lists the vtable functions of the dual interface and its dual bases.
+ */
+void BindingWriter::CollectVtable(
+		const TypeLibReader::TypeInfo& type,
+		std::vector< TypeLibReader::FuncInfo >& funcs,
+		int depth ) const
+{
+	// The external base is IDispatch which has no members of interest.
+	const TypeLibReader::TypeInfo* base = BaseType( type );
+	if( base != nullptr && depth < MaxInheritanceDepth &&
+		( base->typekind == TypeLibReader::TkInterface || ( base->flags & TypeLibReader::TypeFlagDual ) != 0 ) )
+		CollectVtable( *base, funcs, depth + 1 );
+
+	funcs.insert( funcs.end(), type.funcs.begin(), type.funcs.end() );
+}
+
+/**
+ * Resolves the traits of the parameters. Only plain HRESULT members with
+ * [in] parameters and a [retval] are bound.
+ */
+bool BindingWriter::MemberTraits( const TypeLibReader::FuncInfo& func, std::string& result, std::vector< std::string >& params )
+{
+	if( ( func.funckind != FuncVirtual && func.funckind != FuncPureVirtual ) ||
+		func.callconv != CallConvStdcall ||
+		func.cParamsOpt != 0 ||
+		func.returnType.vt != VtHresult ||
+		func.params.size() > MaxParams )
+		return false;
+
+	result = "BindingNoResult";
+	for( size_t i = 0; i < func.params.size(); ++i )
+	{
+		const TypeLibReader::ParamInfo& param = func.params[ i ];
+		if( param.flags & TypeLibReader::ParamFlagRetval )
+		{
+			if( i + 1 != func.params.size() || param.type.vt != TypeLibReader::VtPtr || !param.type.pointee ||
+				!Traits( *param.type.pointee, result ) )
+				return false;
+		}
+		else
+		{
+			std::string traits;
+			if( ( param.flags & ParamFlagOut ) != 0 || !Traits( param.type, traits ) )
+				return false;
+			params.push_back( traits );
+		}
+	}
+
+	return true;
+}
+
+bool BindingWriter::Traits( const TypeLibReader::TypeDesc& desc, std::string& traits )
+{
+	const char* scalar = ScalarName( desc.vt );
+	if( scalar != nullptr )
+	{
+		traits = std::string( "BindingTraits< " ) + scalar + " >";
+		return true;
+	}
+
+	// Enums by value and local dispatch interfaces by pointer.
+	if( desc.vt == TypeLibReader::VtUserDefined )
+	{
+		const TypeLibReader::TypeInfo* ref = reader.GetRefType( desc.hreftype );
+		if( ref == nullptr )
+			return false;
+
+		if( ref->typekind == TypeLibReader::TkEnum )
+		{
+			traits = "BindingTraits< VT_I4 >";
+			return true;
+		}
+
+		return ref->typekind == TypeLibReader::TkAlias && Traits( ref->aliasType, traits );
+	}
+
+	if( desc.vt == TypeLibReader::VtPtr && desc.pointee && desc.pointee->vt == TypeLibReader::VtUserDefined )
+	{
+		const TypeLibReader::TypeInfo* ref = reader.GetRefType( desc.pointee->hreftype );
+		if( ref == nullptr ||
+			( ref->typekind != TypeLibReader::TkDispatch && ( ref->flags & TypeLibReader::TypeFlagDual ) == 0 ) )
+			return false;
+
+		traits = "BindingInterface< &" + IidName( *ref ) + " >";
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Returns the name of the IID constant of the type, defining it on first use.
+ */
+std::string BindingWriter::IidName( const TypeLibReader::TypeInfo& type )
+{
+	std::string key = type.guid.ToString();
+	auto it = iidNames.find( key );
+	if( it != iidNames.end() )
+		return it->second;
+
+	std::string name = "Iid_" + type.name;
+	iidNames[ key ] = name;
+
+	char value[ 96 ];
+	const uint8_t* d = type.guid.data4;
+	snprintf( value, sizeof( value ),
+			"{ 0x%08X, 0x%04X, 0x%04X, { 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X, 0x%02X } }",
+			type.guid.data1, type.guid.data2, type.guid.data3,
+			d[ 0 ], d[ 1 ], d[ 2 ], d[ 3 ], d[ 4 ], d[ 5 ], d[ 6 ], d[ 7 ] );
+
+	iids << "\tconst IID " << name << " = " << value << ";\n";
+	return name;
+}
+
+/**
+ * Generates the TypeScript declarations of the library.
+ */
+std::string BindingWriter::WriteDeclarations( const TypeLibReader& reader )
+{
+	BindingWriter writer( reader );
+
+	std::stringstream out;
+	out << "// Generated by cominterop.writeBindings() from " << reader.name << " "
+		<< reader.majorVersion << "." << reader.minorVersion << ". Do not edit.\n\n";
+
+	std::stringstream library;
+	for( size_t t = 0; t < reader.types.size(); ++t )
+	{
+		const TypeLibReader::TypeInfo& type = reader.types[ t ];
+		switch( type.typekind )
+		{
+		case TypeLibReader::TkEnum:
+			writer.DeclareEnum( type, out );
+			library << "    " << type.name << ": Function;\n";
+			break;
+
+		case TypeLibReader::TkDispatch:
+		case TypeLibReader::TkInterface:
+			writer.DeclareInterface( type, out );
+			library << "    " << type.name << ": { prototype: " << type.name << " };\n";
+			break;
+
+		case TypeLibReader::TkCoclass:
+		{
+			// Coclasses expose their default interface.
+			const TypeLibReader::TypeInfo* defaultType = nullptr;
+			for( size_t i = 0; i < type.implTypes.size() && defaultType == nullptr; ++i )
+				if( type.implTypes[ i ].flags & ImplTypeFlagDefault )
+					defaultType = reader.GetRefType( type.implTypes[ i ].hreftype );
+
+			out << "export interface " << type.name;
+			if( defaultType != nullptr )
+				out << " extends " << defaultType->name;
+			out << " {}\n\n";
+			library << "    " << type.name << ": { new(): " << type.name << " };\n";
+			break;
+		}
+
+		default:
+			library << "    " << type.name << ": Function;\n";
+			break;
+		}
+	}
+
+	out << "export interface Library {\n" << library.str() << "}\n";
+	return out.str();
+}
+
+void BindingWriter::DeclareEnum( const TypeLibReader::TypeInfo& type, std::ostream& out ) const
+{
+	out << "export const enum " << type.name << " {\n";
+	for( size_t i = 0; i < type.vars.size(); ++i )
+	{
+		const TypeLibReader::VarInfo& var = type.vars[ i ];
+		if( var.hasValue )
+			out << "    " << var.name << " = " << var.value.intValue << ",\n";
+	}
+	out << "}\n\n";
+}
+
+/**
+ * Declares the sync interface and its .Async facade.
+ */
+void BindingWriter::DeclareInterface( const TypeLibReader::TypeInfo& type, std::ostream& out ) const
+{
+	std::vector< TypeLibReader::FuncInfo > funcs;
+	CollectDispatch( type, funcs );
+
+	// The base members are declared by the base interface.
+	const TypeLibReader::TypeInfo* base = BaseType( type );
+	std::string extends = base != nullptr ? " extends " + base->name : "";
+	std::string asyncExtends = base != nullptr ? " extends " + base->name + "Async" : "";
+
+	std::stringstream members;
+	std::stringstream asyncMembers;
+	std::map< std::string, bool > properties;
+	std::string itemType;
+	bool enumerable = false;
+
+	for( size_t i = 0; i < funcs.size(); ++i )
+	{
+		const TypeLibReader::FuncInfo& func = funcs[ i ];
+		if( func.memid == DispidNewEnum )
+			enumerable = true;
+		if( func.flags & FuncFlagRestricted )
+			continue;
+
+		std::string name = func.name;
+		std::string result = TsType( func.returnType, 0 );
+		if( func.invkind == InvokePropertyGet )
+		{
+			// Getters are also properties. Indexed ones only through the get_ function.
+			if( func.params.empty() && properties.find( func.name ) == properties.end() )
+				properties[ func.name ] = false;
+			if( func.name == "Item" )
+				itemType = result;
+			name = "get_" + name;
+		}
+		else if( func.invkind == InvokePropertyPut )
+		{
+			properties[ func.name ] = true;
+			name = "put_" + name;
+		}
+		else if( func.invkind == InvokePropertyPutRef )
+		{
+			continue;
+		}
+		else if( func.name == "Item" )
+		{
+			itemType = result;
+		}
+
+		std::string params = TsParams( func, func.params.size() );
+		members << "    " << name << "( " << params << " ): " << result << ";\n";
+		asyncMembers << "    " << name << "( " << params << " ): Promise< " << result << " >;\n";
+	}
+
+	out << "export interface " << type.name << extends << " {\n";
+	for( auto&& property : properties )
+	{
+		// The type of the property comes from the getter or the setter value.
+		std::string propertyType = "any";
+		for( size_t i = 0; i < funcs.size(); ++i )
+		{
+			const TypeLibReader::FuncInfo& func = funcs[ i ];
+			if( func.name != property.first )
+				continue;
+			if( func.invkind == InvokePropertyGet )
+				propertyType = TsType( func.returnType, 0 );
+			else if( func.invkind == InvokePropertyPut && !func.params.empty() && propertyType == "any" )
+				propertyType = TsType( func.params.back().type, 0 );
+		}
+
+		out << "    " << ( property.second ? "" : "readonly " ) << property.first << ": " << propertyType << ";\n";
+	}
+	out << members.str();
+	if( enumerable )
+		out << "    [ Symbol.iterator ](): Iterator< " << ( itemType.empty() ? "any" : itemType ) << " >;\n";
+	out << "    readonly Async: " << type.name << "Async;\n";
+	out << "}\n\n";
+
+	out << "export interface " << type.name << "Async" << asyncExtends << " {\n";
+	out << asyncMembers.str();
+	if( enumerable )
+		out << "    [ Symbol.asyncIterator ](): AsyncIterator< " << ( itemType.empty() ? "any" : itemType ) << " >;\n";
+	out << "}\n\n";
+}
+
+/**
+ * Lists the own functions of the type in their dispatch form.
+ */
+void BindingWriter::CollectDispatch( const TypeLibReader::TypeInfo& type, std::vector< TypeLibReader::FuncInfo >& funcs ) const
+{
+	bool vtable = type.typekind == TypeLibReader::TkInterface || ( type.flags & TypeLibReader::TypeFlagDual ) != 0;
+	for( size_t i = 0; i < type.funcs.size(); ++i )
+		funcs.push_back( vtable ? TypeLibReader::ToDispatch( type.funcs[ i ] ) : type.funcs[ i ] );
+}
+
+const TypeLibReader::TypeInfo* BindingWriter::BaseType( const TypeLibReader::TypeInfo& type ) const
+{
+	if( type.implTypes.empty() )
+		return nullptr;
+
+	const TypeLibReader::TypeInfo* base = reader.GetRefType( type.implTypes[ 0 ].hreftype );
+	if( base == nullptr || base == &type )
+		return nullptr;
+
+	return base;
+}
+
+std::string BindingWriter::TsParams( const TypeLibReader::FuncInfo& func, size_t count ) const
+{
+	std::stringstream out;
+	bool optional = false;
+	for( size_t i = 0; i < count; ++i )
+	{
+		const TypeLibReader::ParamInfo& param = func.params[ i ];
+
+		// Nothing required can follow an optional parameter.
+		optional = optional || param.hasDefault || ( param.flags & ParamFlagOpt ) != 0;
+		if( i > 0 )
+			out << ", ";
+		out << TsName( param.name, i ) << ( optional ? "?" : "" ) << ": " << TsType( param.type, 0 );
+	}
+
+	return out.str();
+}
+
+/**
+ * Returns the JavaScript type of the value as converted by the addon.
+ */
+std::string BindingWriter::TsType( const TypeLibReader::TypeDesc& desc, int depth ) const
+{
+	if( depth > MaxInheritanceDepth )
+		return "any";
+
+	if( IsNumeric( desc.vt ) )
+		return "number";
+
+	switch( desc.vt )
+	{
+	case 7: return "Date";
+	case 8: return "string";
+	case 11: return "boolean";
+	case 24:
+	case VtHresult:
+		return "void";
+
+	case TypeLibReader::VtPtr:
+		return desc.pointee ? TsType( *desc.pointee, depth + 1 ) : "any";
+
+	case TypeLibReader::VtSafeArray:
+	{
+		// Numeric arrays are returned as TypedArrays and bytes as Buffers.
+		if( !desc.pointee )
+			return "any[]";
+		if( desc.pointee->vt == 17 )
+			return "Buffer";
+		if( IsNumeric( desc.pointee->vt ) )
+			return "ArrayLike< number >";
+		return "Array< " + TsType( *desc.pointee, depth + 1 ) + " >";
+	}
+
+	case TypeLibReader::VtUserDefined:
+	{
+		const TypeLibReader::TypeInfo* ref = reader.GetRefType( desc.hreftype );
+		if( ref == nullptr )
+			return "any";
+
+		switch( ref->typekind )
+		{
+		case TypeLibReader::TkEnum:
+		case TypeLibReader::TkDispatch:
+		case TypeLibReader::TkInterface:
+		case TypeLibReader::TkCoclass:
+			return ref->name;
+		case TypeLibReader::TkAlias:
+			return TsType( ref->aliasType, depth + 1 );
+		default:
+			return "any";
+		}
+	}
+
+	default:
+		return "any";
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "TypeLibReader.h"
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Generates the static bindings and TypeScript declarations of a type library.
+ *
+ * The C++ source registers a statically typed vtable thunk for each member
+ * of the dual interfaces that has a supported signature. It is compiled
+ * into the addon by placing it in src/. The declarations describe the
+ * JavaScript view of the library: the types, their properties and methods
+ * and the promise based .Async facades.
+ */
+class BindingWriter
+{
+public:
+	static std::string WriteSource( const TypeLibReader& reader );
+	static std::string WriteDeclarations( const TypeLibReader& reader );
+	static bool WriteFile( const std::string& content, const std::string& path );
+
+private:
+	BindingWriter( const TypeLibReader& reader ) : reader( reader ) {}
+
+	// C++ source.
+	void CollectVtable( const TypeLibReader::TypeInfo& type, std::vector< TypeLibReader::FuncInfo >& funcs, int depth ) const;
+	bool MemberTraits( const TypeLibReader::FuncInfo& func, std::string& result, std::vector< std::string >& params );
+	bool Traits( const TypeLibReader::TypeDesc& desc, std::string& traits );
+	std::string IidName( const TypeLibReader::TypeInfo& type );
+
+	// TypeScript declarations.
+	void CollectDispatch( const TypeLibReader::TypeInfo& type, std::vector< TypeLibReader::FuncInfo >& funcs ) const;
+	void DeclareInterface( const TypeLibReader::TypeInfo& type, std::ostream& out ) const;
+	void DeclareEnum( const TypeLibReader::TypeInfo& type, std::ostream& out ) const;
+	std::string TsType( const TypeLibReader::TypeDesc& desc, int depth ) const;
+	std::string TsParams( const TypeLibReader::FuncInfo& func, size_t count ) const;
+	const TypeLibReader::TypeInfo* BaseType( const TypeLibReader::TypeInfo& type ) const;
+
+	const TypeLibReader& reader;
+
+	// IID constants referenced by the thunks.
+	std::map< std::string, std::string > iidNames;
+	std::stringstream iids;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Double buffered chunks of an enumeration.
+ *
+ * The items of the current chunk are taken in order. The async iteration
+ * reads the next chunk into the prefetch buffer in a worker thread while
+ * the current one is consumed; only the worker touches that buffer while
+ * a fetch is running. The synchronous iteration refills the current chunk
+ * in place.
+ *
+ * Does not depend on COM or V8. EnumIterator keeps the enumerator and the
+ * fetch results.
+ */
+template< typename Item >
+class ChunkBuffer
+{
+public:
+	ChunkBuffer() : position( 0 ), exhausted( false ), closed( false ), fetching( false ), prefetchReady( false ) {}
+
+	bool HasItem() const { return position < chunk.size(); }
+	Item& Take() { return chunk[ position++ ]; }
+
+	bool IsExhausted() const { return exhausted; }
+	bool IsClosed() const { return closed; }
+	bool IsFetching() const { return fetching; }
+
+	/**
+	 * Returns true if the synchronous iteration must read the next chunk.
+	 */
+	bool NeedsRefill() const { return position == chunk.size() && !exhausted && !closed; }
+
+	/**
+	 * Returns the chunk to read the next items into in place.
+	 */
+	std::vector< Item >& BeginRefill()
+	{
+		position = 0;
+		chunk.clear();
+		return chunk;
+	}
+
+	void EndRefill( bool end ) { exhausted = end; }
+
+	/**
+	 * Returns true if the next chunk can be prefetched now.
+	 */
+	bool CanPrefetch() const { return !fetching && !prefetchReady && !exhausted && !closed; }
+
+	/**
+	 * Returns the buffer the worker reads the next chunk into.
+	 */
+	std::vector< Item >& BeginPrefetch()
+	{
+		fetching = true;
+		return prefetched;
+	}
+
+	/**
+	 * Takes the prefetched chunk unless the buffer was closed in the meantime.
+	 */
+	void EndPrefetch( bool succeeded, bool end )
+	{
+		fetching = false;
+		if( closed )
+		{
+			prefetched.clear();
+		}
+		else if( succeeded )
+		{
+			prefetchReady = true;
+			exhausted = end;
+		}
+	}
+
+	/**
+	 * Moves to the prefetched chunk once the current one is consumed.
+	 */
+	void Advance()
+	{
+		if( position == chunk.size() && prefetchReady )
+		{
+			chunk.swap( prefetched );
+			prefetched.clear();
+			position = 0;
+			prefetchReady = false;
+		}
+	}
+
+	/**
+	 * Drops the items. Returns false while a fetch still writes the prefetch
+	 * buffer; the enumerator is then released once the fetch ends.
+	 */
+	bool Close()
+	{
+		closed = true;
+		chunk.clear();
+		position = 0;
+
+		if( fetching )
+			return false;
+
+		prefetched.clear();
+		prefetchReady = false;
+		return true;
+	}
+
+private:
+	ChunkBuffer( const ChunkBuffer& );
+	ChunkBuffer& operator=( const ChunkBuffer& );
+
+	// The chunk being consumed.
+	std::vector< Item > chunk;
+	size_t position;
+
+	// Set when the enumerator has no items beyond the ones fetched.
+	bool exhausted;
+	bool closed;
+
+	std::vector< Item > prefetched;
+	bool fetching;
+	bool prefetchReady;
+};
@@ -1,22 +1,57 @@
 #include "CollectionInfo.h"
 
+thread_local CollectionInfo::FillList* CollectionInfo::deferred = nullptr;
+
 /**
- * Adds an item to the target collection.
+ * Converts the array items and adds them to the collection.
  */
-void CollectionInfo::AddItem( CComPtr< IDispatch > collection, CComVariant item )
+void CollectionInfo::Populate( const CComPtr< IDispatch >& collection, v8::Local< v8::Array > array ) const
 {
-	// Create parameters.
-	std::vector< CComVariant > args;
-	args.resize( 2 );
-	args[ 0 ].ChangeType( VT_I4 );
-	args[ 0 ].lVal = -1;
-	args[ 1 ] = item;
-
-	// Invoke the add.
-	VARIANT result;
-	EXCEPINFO exception;
-	HRESULT hr = addMethod->Invoke( collection, args, OUT &result, OUT &exception );
-
-	// There should be no result, but process the HR anyway in case of an exception.
-	addMethod->GetInvokeResult( hr, result, exception );
+	std::unique_ptr< Fill > fill( new Fill( this, collection ) );
+
+	// The item conversion was resolved with the Add method.
+	const TypePlan& itemPlan = addMethod->plan->params[ 1 ].type;
+	uint32_t length = array->Length();
+	fill->items.resize( length );
+	for( uint32_t i = 0; i < length; i++ )
+		itemPlan.toVariant( itemPlan, array->Get( i ), OUT fill->items[ i ] );
+
+	if( deferred != nullptr && length >= DeferLength )
+	{
+		deferred->push_back( std::move( fill ) );
+		return;
+	}
+
+	ExcepInfo exception;
+	HRESULT hr = AddItems( collection, fill->items, OUT &exception );
+	if( hr == DISP_E_EXCEPTION )
+		JsException::Throw( exception );
+
+	VERIFY( hr );
+}
+
+/**
+ * Adds the items to the target collection.
+ *
+ * The same argument buffer is used for all the items. The items are moved
+ * into it so the list is left empty.
+ */
+HRESULT CollectionInfo::AddItems( IDispatch* collection, std::vector< CComVariant >& items, OUT EXCEPINFO* exception ) const
+{
+	// Parameters are stored in reverse order: Add( index, item ).
+	std::vector< CComVariant > args( 2 );
+	args[ 1 ] = -1L;
+
+	for( auto&& item : items )
+	{
+		args[ 0 ].Attach( &item );
+
+		// There should be no result.
+		ResultVariant result;
+		HRESULT hr = addMethod->Invoke( collection, args, OUT &result, OUT exception );
+		if( FAILED( hr ) )
+			return hr;
+	}
+
+	return S_OK;
 }
@@ -2,6 +2,7 @@
 
 #include "MethodInfo.h"
 #include <memory>
+#include <vector>
 
 /**
  * Extra information for collection types.
@@ -10,6 +11,40 @@ class CollectionInfo
 {
 public:
 
+	/**
+	 * Collection waiting to be populated.
+	 */
+	struct Fill
+	{
+		Fill( const CollectionInfo* info, const CComPtr< IDispatch >& collection )
+			: info( info ), collection( collection ) {}
+
+		const CollectionInfo* info;
+		CComPtr< IDispatch > collection;
+		std::vector< CComVariant > items;
+	};
+
+	typedef std::vector< std::unique_ptr< Fill > > FillList;
+
+	/**
+	 * Defers the population of large collections created within the scope.
+	 *
+	 * Used while converting the arguments of async calls so the Add calls
+	 * run in the worker thread with the call itself.
+	 */
+	class DeferScope
+	{
+	public:
+		DeferScope( FillList* fills ) : outer( deferred ) { deferred = fills; }
+		~DeferScope() { deferred = outer; }
+
+	private:
+		FillList* outer;
+	};
+
+	// Arrays at least this long are populated in the worker thread for async calls.
+	static const size_t DeferLength = 256;
+
 	/**
 	 * Constructor. Takes ownership of method info.
 	 */
@@ -31,11 +66,18 @@ public:
 	}
 
 	/**
-	 * Adds an item to the collection.
+	 * Populates the collection from the array or defers it if a DeferScope is active.
+	 */
+	void Populate( const CComPtr< IDispatch >& collection, v8::Local< v8::Array > array ) const;
+
+	/**
+	 * Adds the items to the collection. Usable from the worker threads.
 	 */
-	void AddItem( CComPtr< IDispatch > collection, CComVariant item );
+	HRESULT AddItems( IDispatch* collection, std::vector< CComVariant >& items, OUT EXCEPINFO* exception ) const;
 
 private:
 	std::unique_ptr< MethodInfo > addMethod;
-};
 
+	// Fills deferred by the call being made on this thread.
+	static thread_local FillList* deferred;
+};
@@ -0,0 +1,339 @@
+#include "ColumnProjection.h"
+
+#include "EnumIterator.h"
+#include "InteropInstance.h"
+#include "InteropType.h"
+#include "InvokePool.h"
+#include "MethodInfo.h"
+
+#include <limits>
+#include <memory>
+#include <sstream>
+
+namespace
+{
+	/**
+	 * Copies the values into a Buffer and returns a view of the element type.
+	 */
+	template< typename TArray, typename T >
+	v8::Local< v8::Value > NewColumnArray( const std::vector< T >& values )
+	{
+		v8::Local< v8::Object > buffer = Nan::CopyBuffer(
+				reinterpret_cast< const char* >( values.data() ), values.size() * sizeof( T ) ).ToLocalChecked();
+
+		v8::Local< v8::Uint8Array > bytes = buffer.As< v8::Uint8Array >();
+		return TArray::New( bytes->Buffer(), bytes->ByteOffset(), values.size() );
+	}
+}
+
+/**
+ * Queues the projection: project( collection, [ 'ID', 'Created', 'Title' ] ).
+ *
+ * Returns a promise of { length, columns } where each column is a TypedArray
+ * or a { data, offsets } string table.
+ */
+NAN_METHOD( ColumnProjection::Project )
+{
+	if( info.Length() < 2 || !info[ 0 ]->IsObject() || !info[ 1 ]->IsArray() ) {
+		Nan::ThrowTypeError( "Usage: project( collection, properties )" );
+		return;
+	}
+
+	InteropInstance* obj = InteropInstance::FromValue( info[ 0 ] );
+	if( obj == nullptr ) {
+		Nan::ThrowTypeError( "The projected collection must be a COM object." );
+		return;
+	}
+
+	InteropType* type = obj->type != nullptr ? obj->type->FindCollectionType() : nullptr;
+	if( type == nullptr || type->itemType == nullptr ) {
+		Nan::ThrowTypeError( "The object is not a collection with a _NewEnum member and a typed Item method." );
+		return;
+	}
+
+	std::unique_ptr< ColumnProjection > projection( new ColumnProjection() );
+	v8::Local< v8::Array > names = info[ 1 ].As< v8::Array >();
+	projection->columns.resize( names->Length() );
+
+	try
+	{
+		// Resolve the getters once for the whole collection.
+		for( uint32_t i = 0; i < names->Length(); i++ )
+		{
+			Column& column = projection->columns[ i ];
+			column.name = *v8::String::Utf8Value( names->Get( i ) );
+			column.getter = type->itemType->FindMethod( column.name );
+			if( column.getter == nullptr )
+			{
+				std::stringstream ss;
+				ss << "Property '" << column.name << "' not found.";
+				JsException::Throw( ss.str().c_str() );
+			}
+
+			if( !Column::KindOf( column.getter->plan->result, OUT column.kind ) )
+			{
+				std::stringstream ss;
+				ss << "Property '" << column.name << "' has no numeric, date or string type.";
+				JsException::Throw( ss.str().c_str() );
+			}
+
+			column.getter->plan->InitArgs( ArrayArgs( Nan::New< v8::Array >() ), OUT column.args );
+			if( column.kind == Column::String )
+				column.offsets.push_back( 0 );
+		}
+	}
+	catch( JsException ex )
+	{
+		Nan::ThrowError( ex.GetError() );
+		return;
+	}
+
+	projection->collectionType = type;
+	projection->collection = obj->instance;
+	projection->collectionHandle.Reset( info[ 0 ].As< v8::Object >() );
+
+	auto resolver = v8::Promise::Resolver::New( info.GetIsolate() );
+	projection->resolver.Reset( resolver );
+	info.GetReturnValue().Set( resolver->GetPromise() );
+
+	InvokePool::Submit( projection.release(), obj->IsAgile() );
+}
+
+/**
+ * Walks the collection. Executed in the worker thread.
+ */
+void ColumnProjection::Execute()
+{
+	hr = EnumIterator::ForEach(
+			collectionType, collection,
+			[ this ]( VARIANT& item ) { return AddItem( item ); },
+			OUT &exception );
+	value.Clear();
+}
+
+HRESULT ColumnProjection::AddItem( VARIANT& item )
+{
+	CComPtr< IDispatch > dispatch;
+	if( item.vt == VT_DISPATCH )
+		dispatch = item.pdispVal;
+	else if( item.vt == VT_UNKNOWN && item.punkVal != nullptr )
+		item.punkVal->QueryInterface< IDispatch >( OUT &dispatch );
+
+	// Stops the walk. The HRESULT is not reported.
+	if( dispatch == nullptr )
+	{
+		nonObjectItem = true;
+		return E_ABORT;
+	}
+
+	// A failing getter fails the whole projection.
+	for( auto&& column : columns )
+	{
+		value.Clear();
+		HRESULT columnHr = column.getter->Invoke( dispatch, column.args, OUT &value, OUT &exception );
+		if( SUCCEEDED( columnHr ) )
+			columnHr = column.Add( value );
+
+		if( FAILED( columnHr ) )
+			return columnHr;
+	}
+
+	count++;
+	return S_OK;
+}
+
+/**
+ * Picks the column storage for the declared getter result.
+ */
+bool ColumnProjection::Column::KindOf( const TypePlan& result, OUT Kind& kind )
+{
+	switch( result.vt )
+	{
+	case VT_I1:
+	case VT_UI1:
+	case VT_I2:
+	case VT_UI2:
+	case VT_I4:
+	case VT_INT:
+	case VT_BOOL:
+	case VT_ERROR:
+		kind = Int32;
+		return true;
+	case VT_UI4:
+	case VT_UINT:
+	case VT_I8:
+	case VT_UI8:
+	case VT_R4:
+	case VT_R8:
+	case VT_CY:
+	case VT_DECIMAL:
+		kind = Float64;
+		return true;
+	case VT_DATE:
+		kind = Date;
+		return true;
+	case VT_BSTR:
+		kind = String;
+		return true;
+	case VT_USERDEFINED:
+		kind = Int32;
+		return result.refTypeKind == TKIND_ENUM;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Appends the value to the column. Empty and null values become 0, NaN or "".
+ */
+HRESULT ColumnProjection::Column::Add( VARIANT& value )
+{
+	bool missing = value.vt == VT_EMPTY || value.vt == VT_NULL;
+	CComVariant converted;
+
+	switch( kind )
+	{
+	case Int32:
+	{
+		if( missing )
+		{
+			ints.push_back( 0 );
+			return S_OK;
+		}
+
+		// Booleans as 1 and 0 instead of VARIANT_TRUE.
+		if( value.vt == VT_BOOL )
+		{
+			ints.push_back( value.boolVal != VARIANT_FALSE ? 1 : 0 );
+			return S_OK;
+		}
+
+		HRESULT hr = converted.ChangeType( VT_I4, &value );
+		if( FAILED( hr ) )
+			return hr;
+
+		ints.push_back( converted.lVal );
+		return S_OK;
+	}
+
+	case Float64:
+	case Date:
+	{
+		if( missing )
+		{
+			numbers.push_back( std::numeric_limits< double >::quiet_NaN() );
+			return S_OK;
+		}
+
+		HRESULT hr = converted.ChangeType( kind == Date ? VT_DATE : VT_R8, &value );
+		if( FAILED( hr ) )
+			return hr;
+
+		// Dates as JavaScript timestamps. COM counts days from Dec 30, 1899.
+		numbers.push_back( kind == Date ? DateToMilliseconds( converted.date ) : converted.dblVal );
+		return S_OK;
+	}
+
+	case String:
+	{
+		if( !missing )
+		{
+			BSTR bstr = value.bstrVal;
+			if( value.vt != VT_BSTR )
+			{
+				HRESULT hr = converted.ChangeType( VT_BSTR, &value );
+				if( FAILED( hr ) )
+					return hr;
+
+				bstr = converted.bstrVal;
+			}
+
+			// Convert straight into the end of the table.
+			int length = static_cast< int >( SysStringLen( bstr ) );
+			if( length > 0 )
+			{
+				int requiredLength = WideCharToMultiByte( CP_UTF8, 0, bstr, length, nullptr, 0, nullptr, nullptr );
+				size_t start = text.size();
+				if( start + requiredLength > std::numeric_limits< uint32_t >::max() )
+					return E_OUTOFMEMORY;
+
+				text.resize( start + requiredLength );
+				WideCharToMultiByte( CP_UTF8, 0, bstr, length, &text[ start ], requiredLength, nullptr, nullptr );
+			}
+		}
+
+		offsets.push_back( static_cast< uint32_t >( text.size() ) );
+		return S_OK;
+	}
+	}
+
+	return E_UNEXPECTED;
+}
+
+v8::Local< v8::Value > ColumnProjection::Column::ToValue() const
+{
+	switch( kind )
+	{
+	case Int32:
+		return NewColumnArray< v8::Int32Array >( ints );
+
+	case Float64:
+	case Date:
+		return NewColumnArray< v8::Float64Array >( numbers );
+
+	case String:
+	{
+		v8::Local< v8::Object > table = Nan::New< v8::Object >();
+		Nan::Set( table, Nan::New( "data" ).ToLocalChecked(), Nan::CopyBuffer( text.data(), text.size() ).ToLocalChecked() );
+		Nan::Set( table, Nan::New( "offsets" ).ToLocalChecked(), NewColumnArray< v8::Uint32Array >( offsets ) );
+		return table;
+	}
+	}
+
+	return Nan::Undefined();
+}
+
+/**
+ * Settles the promise with the columns. Executed in the v8 thread.
+ */
+void ColumnProjection::Complete()
+{
+	auto promiseResolver = Nan::New( resolver );
+	resolver.Reset();
+	collectionHandle.Reset();
+
+	if( nonObjectItem )
+	{
+		promiseResolver->Reject( Nan::TypeError( "The collection contains an item that is not an object." ) );
+		return;
+	}
+
+	try
+	{
+		if( hr == DISP_E_EXCEPTION )
+			JsException::Throw( exception );
+		else if( FAILED( hr ) )
+			JsException::Throw( hr );
+
+		v8::Local< v8::Object > columnValues = Nan::New< v8::Object >();
+		for( auto&& column : columns )
+			Nan::Set( columnValues, Nan::New( column.name ).ToLocalChecked(), column.ToValue() );
+
+		v8::Local< v8::Object > projected = Nan::New< v8::Object >();
+		Nan::Set( projected, Nan::New( "length" ).ToLocalChecked(), Nan::New< v8::Number >( count ) );
+		Nan::Set( projected, Nan::New( "columns" ).ToLocalChecked(), columnValues );
+		promiseResolver->Resolve( projected );
+	}
+	catch( JsException ex )
+	{
+		promiseResolver->Reject( ex.GetError() );
+	}
+}
+
+void ColumnProjection::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > project = Nan::New< v8::FunctionTemplate >( Project );
+	exports->Set( Nan::New( "project" ).ToLocalChecked(), project->GetFunction() );
+}
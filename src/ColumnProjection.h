@@ -0,0 +1,74 @@
+#pragma once
+
+#include "utils.h"
+#include "WorkerPool.h"
+#include <nan.h>
+
+#include <string>
+#include <vector>
+
+class InteropType;
+class MethodInfo;
+struct TypePlan;
+
+/**
+ * Reads the same properties from every item of a collection.
+ *
+ * The getters are resolved once from the item type and the collection is
+ * walked in the worker pool. The values are gathered per column so they
+ * reach JavaScript as TypedArrays and packed string tables instead of an
+ * object per item.
+ */
+class ColumnProjection : public WorkerPool::Task
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+	static NAN_METHOD( Project );
+
+	void Execute() override;
+	void Complete() override;
+
+private:
+	struct Column
+	{
+		enum Kind { Int32, Float64, Date, String };
+
+		std::string name;
+		MethodInfo* getter;
+		Kind kind;
+		std::vector< CComVariant > args;
+
+		std::vector< int32_t > ints;
+		std::vector< double > numbers;
+
+		// UTF-8 strings back to back. Item i is text[ offsets[ i ], offsets[ i + 1 ] ).
+		std::string text;
+		std::vector< uint32_t > offsets;
+
+		static bool KindOf( const TypePlan& result, OUT Kind& kind );
+
+		HRESULT Add( VARIANT& value );
+		v8::Local< v8::Value > ToValue() const;
+	};
+
+	ColumnProjection() : collectionType( nullptr ), count( 0 ), hr( S_OK ), nonObjectItem( false ) {}
+
+	HRESULT AddItem( VARIANT& item );
+
+	// Keeps the collection wrapper alive while the worker walks it.
+	Nan::Persistent< v8::Object > collectionHandle;
+	InteropType* collectionType;
+	CComPtr< IDispatch > collection;
+	std::vector< Column > columns;
+	uint32_t count;
+
+	ResultVariant value;
+	ExcepInfo exception;
+	HRESULT hr;
+
+	// Set when the walk stopped at an item that is not an object. The
+	// failures of the enumerator and the getters stay in hr unchanged.
+	bool nonObjectItem;
+
+	Nan::Persistent< v8::Promise::Resolver > resolver;
+};
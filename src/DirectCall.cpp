@@ -0,0 +1,371 @@
+#include "DirectCall.h"
+
+#include "VtableFrame.h"
+
+#include <cstdint>
+
+std::atomic< bool > DirectCall::enabled( true );
+
+static_assert( DirectCall::MaxParams == VtableFrame::MaxArgs, "The frame must hold every native parameter" );
+
+namespace
+{
+	/**
+	 * Returns the integer argument extended to the full register width the way
+	 * a compiler passes it.
+	 */
+	uint64_t IntegerBits( const VARIANT& arg )
+	{
+		switch( arg.vt )
+		{
+		case VT_I1: return static_cast< uint64_t >( static_cast< int64_t >( arg.cVal ) );
+		case VT_UI1: return arg.bVal;
+		case VT_I2: return static_cast< uint64_t >( static_cast< int64_t >( arg.iVal ) );
+		case VT_UI2: return arg.uiVal;
+		case VT_BOOL: return static_cast< uint64_t >( static_cast< int64_t >( arg.boolVal ) );
+		case VT_I4: return static_cast< uint64_t >( static_cast< int64_t >( arg.lVal ) );
+		case VT_ERROR: return static_cast< uint64_t >( static_cast< int64_t >( arg.scode ) );
+		case VT_INT: return static_cast< uint64_t >( static_cast< int64_t >( arg.intVal ) );
+		case VT_UI4: return arg.ulVal;
+		case VT_UINT: return arg.uintVal;
+		case VT_BSTR: return reinterpret_cast< uintptr_t >( arg.bstrVal );
+		default: return arg.ullVal;
+		}
+	}
+
+	/**
+	 * Returns the interface half of a dual dispinterface.
+	 */
+	CComPtr< ITypeInfo > VtableTypeInfo( ITypeInfo* typeInfo, OUT IID& iid )
+	{
+		CComPtr< ITypeInfo > vtableInfo;
+
+		TYPEATTR* typeattr;
+		if( FAILED( typeInfo->GetTypeAttr( OUT &typeattr ) ) )
+			return vtableInfo;
+
+		bool dual = typeattr->typekind == TKIND_DISPATCH && ( typeattr->wTypeFlags & TYPEFLAG_FDUAL ) != 0;
+		iid = typeattr->guid;
+		typeInfo->ReleaseTypeAttr( typeattr );
+
+		HREFTYPE vtableRef;
+		if( dual && SUCCEEDED( typeInfo->GetRefTypeOfImplType( -1, OUT &vtableRef ) ) )
+			typeInfo->GetRefTypeInfo( vtableRef, OUT &vtableInfo );
+
+		return vtableInfo;
+	}
+}
+
+DirectCall* DirectCall::Create( ITypeInfo* typeInfo, const FUNCDESC* funcdesc )
+{
+#if defined( VTABLE_FRAME_NATIVE )
+	IID iid;
+	CComPtr< ITypeInfo > vtableInfo = VtableTypeInfo( typeInfo, OUT iid );
+	CComQIPtr< ITypeInfo2 > vtableInfo2( vtableInfo );
+	if( !vtableInfo2 )
+		return nullptr;
+
+	UINT index;
+	if( FAILED( vtableInfo2->GetFuncIndexOfMemId( funcdesc->memid, funcdesc->invkind, OUT &index ) ) )
+		return nullptr;
+
+	FUNCDESC* vtableFunc;
+	if( FAILED( vtableInfo->GetFuncDesc( index, OUT &vtableFunc ) ) )
+		return nullptr;
+
+	std::unique_ptr< DirectCall > call( new DirectCall() );
+	call->iid = iid;
+	call->vtableIndex = vtableFunc->oVft / sizeof( void* );
+
+	// Only plain HRESULT members with [in] parameters and a [retval].
+	bool supported =
+			( vtableFunc->funckind == FUNC_PUREVIRTUAL || vtableFunc->funckind == FUNC_VIRTUAL ) &&
+			vtableFunc->callconv == CC_STDCALL &&
+			vtableFunc->cParamsOpt == 0 &&
+			vtableFunc->elemdescFunc.tdesc.vt == VT_HRESULT &&
+			static_cast< size_t >( vtableFunc->cParams ) <= MaxParams;
+
+	for( SHORT i = 0; supported && i < vtableFunc->cParams; i++ )
+	{
+		const ELEMDESC& elem = vtableFunc->lprgelemdescParam[ i ];
+		USHORT flags = elem.paramdesc.wParamFlags;
+		if( flags & PARAMFLAG_FRETVAL )
+		{
+			supported = i + 1 == vtableFunc->cParams && elem.tdesc.vt == VT_PTR &&
+					ResolveParam( vtableInfo, *elem.tdesc.lptdesc, OUT call->result );
+			call->hasResult = true;
+		}
+		else
+		{
+			Param param;
+			supported = ( flags & PARAMFLAG_FOUT ) == 0 && ResolveParam( vtableInfo, elem.tdesc, OUT param );
+			call->params.push_back( param );
+		}
+	}
+
+	vtableInfo->ReleaseFuncDesc( vtableFunc );
+
+	// The dispatch member must agree on the parameters the caller marshals.
+	if( !supported || call->params.size() != static_cast< size_t >( funcdesc->cParams ) )
+		return nullptr;
+
+	return call.release();
+#else
+	return nullptr;
+#endif
+}
+
+/**
+ * Maps the native parameter type to the way it is passed.
+ */
+bool DirectCall::ResolveParam( ITypeInfo* typeInfo, const TYPEDESC& typedesc, OUT Param& param )
+{
+	param.vt = typedesc.vt;
+	param.iid = IID_NULL;
+
+	switch( typedesc.vt )
+	{
+	case VT_I1:
+	case VT_UI1:
+	case VT_I2:
+	case VT_UI2:
+	case VT_I4:
+	case VT_UI4:
+	case VT_INT:
+	case VT_UINT:
+	case VT_I8:
+	case VT_UI8:
+	case VT_BOOL:
+	case VT_ERROR:
+	case VT_BSTR:
+		param.kind = Integer;
+		return true;
+
+	case VT_R4:
+		param.kind = Single;
+		return true;
+
+	case VT_R8:
+	case VT_DATE:
+		param.kind = Real;
+		return true;
+
+	// VARIANTs are passed as a pointer to the caller's copy.
+	case VT_VARIANT:
+		param.kind = Variant;
+		return true;
+
+	case VT_DISPATCH:
+		param.kind = Interface;
+		param.iid = IID_IDispatch;
+		return true;
+
+	case VT_UNKNOWN:
+		param.kind = Interface;
+		param.iid = IID_IUnknown;
+		return true;
+
+	case VT_USERDEFINED:
+	case VT_PTR:
+	{
+		// Enums by value and dispatch interfaces by pointer.
+		bool pointer = typedesc.vt == VT_PTR;
+		const TYPEDESC& target = pointer ? *typedesc.lptdesc : typedesc;
+		if( target.vt != VT_USERDEFINED )
+			return false;
+
+		CComPtr< ITypeInfo > refInfo;
+		TYPEATTR* refAttr;
+		if( FAILED( typeInfo->GetRefTypeInfo( target.hreftype, OUT &refInfo ) ) ||
+			FAILED( refInfo->GetTypeAttr( OUT &refAttr ) ) )
+			return false;
+
+		bool supported = false;
+		if( !pointer && refAttr->typekind == TKIND_ENUM )
+		{
+			param.kind = Integer;
+			param.vt = VT_I4;
+			supported = true;
+		}
+		else if( pointer && ( refAttr->typekind == TKIND_DISPATCH || ( refAttr->wTypeFlags & TYPEFLAG_FDUAL ) != 0 ) )
+		{
+			param.kind = Interface;
+			param.vt = VT_DISPATCH;
+			param.iid = refAttr->guid;
+			supported = true;
+		}
+
+		refInfo->ReleaseTypeAttr( refAttr );
+		return supported;
+	}
+
+	default:
+		return false;
+	}
+}
+
+bool DirectCall::Invoke(
+		IDispatch* obj,
+		CComVariant* args,
+		size_t argCount,
+		OUT VARIANT* presult,
+		OUT EXCEPINFO* pexcepInfo,
+		OUT HRESULT& hr )
+{
+#if defined( VTABLE_FRAME_NATIVE )
+	CComPtr< IUnknown > queried;
+	IUnknown* target = VtableTarget( obj, iid, dualVtable, OUT queried );
+	if( target == nullptr )
+		return false;
+
+	VtableFrame::Native frame;
+	CComVariant converted[ MaxParams ];
+	CComPtr< IUnknown > interfaces[ MaxParams ];
+
+	for( size_t i = 0; i < params.size(); i++ )
+	{
+		// The arguments are in DISPPARAMS order, last parameter first.
+		const Param& param = params[ i ];
+		VARIANT* arg = &args[ argCount - 1 - i ];
+
+		// Omitted arguments need the defaults of the IDispatch path.
+		if( arg->vt == VT_ERROR && arg->scode == DISP_E_PARAMNOTFOUND )
+			return false;
+
+		switch( param.kind )
+		{
+		case Variant:
+			frame.AddInteger( reinterpret_cast< uintptr_t >( arg ) );
+			break;
+
+		case Integer:
+		case Real:
+		case Single:
+			if( arg->vt != param.vt )
+			{
+				if( FAILED( converted[ i ].ChangeType( param.vt, arg ) ) )
+					return false;
+				arg = &converted[ i ];
+			}
+
+			if( param.kind == Real )
+				frame.AddReal( arg->dblVal );
+			else if( param.kind == Single )
+				frame.AddSingle( arg->fltVal );
+			else
+				frame.AddInteger( IntegerBits( *arg ) );
+			break;
+
+		case Interface:
+			if( arg->vt == VT_DISPATCH || arg->vt == VT_UNKNOWN )
+			{
+				if( arg->punkVal != nullptr &&
+					FAILED( arg->punkVal->QueryInterface( param.iid, OUT reinterpret_cast< void** >( &interfaces[ i ] ) ) ) )
+					return false;
+			}
+			else if( arg->vt != VT_EMPTY && arg->vt != VT_NULL )
+			{
+				return false;
+			}
+
+			frame.AddInteger( reinterpret_cast< uintptr_t >( interfaces[ i ].p ) );
+			break;
+		}
+	}
+
+	// The [retval] is written straight into the result VARIANT.
+	ResultVariant unused;
+	VARIANT* resultVariant = presult != nullptr ? presult : &unused;
+	VariantClear( resultVariant );
+	if( hasResult )
+	{
+		resultVariant->llVal = 0;
+		frame.AddInteger( result.kind == Variant
+				? reinterpret_cast< uintptr_t >( resultVariant )
+				: reinterpret_cast< uintptr_t >( &resultVariant->llVal ) );
+	}
+
+	void** vtable = *reinterpret_cast< void*** >( target );
+	hr = frame.Call< HRESULT >( vtable[ vtableIndex ], target );
+	if( FAILED( hr ) )
+	{
+		if( result.kind != Variant )
+			resultVariant->llVal = 0;
+		hr = FillException( target, iid, hr, OUT pexcepInfo );
+		return true;
+	}
+
+	if( hasResult && result.kind != Variant )
+		resultVariant->vt = result.vt;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+IUnknown* DirectCall::VtableTarget( IDispatch* obj, const IID& iid, std::atomic< void* >& dualVtable, OUT CComPtr< IUnknown >& queried )
+{
+	if( obj == nullptr )
+		return nullptr;
+
+	// An object whose IDispatch vtable was seen to be the dual interface is
+	// called as is.
+	void* vtable = *reinterpret_cast< void** >( obj );
+	if( vtable == dualVtable.load( std::memory_order_relaxed ) )
+		return obj;
+
+	// Objects behind proxies may not expose the vtable interface.
+	if( FAILED( obj->QueryInterface( iid, OUT reinterpret_cast< void** >( &queried ) ) ) )
+		return nullptr;
+
+	// Proxies may share their vtables between interfaces, so only in-process
+	// objects are remembered.
+	CComPtr< IClientSecurity > proxy;
+	if( queried.p == obj && FAILED( obj->QueryInterface< IClientSecurity >( OUT &proxy ) ) )
+		dualVtable.store( vtable, std::memory_order_relaxed );
+
+	return queried;
+}
+
+HRESULT DirectCall::FillException( IUnknown* target, const IID& iid, HRESULT hr, OUT EXCEPINFO* exception )
+{
+	CComPtr< ISupportErrorInfo > support;
+	CComPtr< IErrorInfo > errorInfo;
+	if( exception == nullptr ||
+		FAILED( target->QueryInterface< ISupportErrorInfo >( OUT &support ) ) ||
+		support->InterfaceSupportsErrorInfo( iid ) != S_OK ||
+		GetErrorInfo( 0, OUT &errorInfo ) != S_OK )
+		return hr;
+
+	errorInfo->GetSource( OUT &exception->bstrSource );
+	errorInfo->GetDescription( OUT &exception->bstrDescription );
+	errorInfo->GetHelpFile( OUT &exception->bstrHelpFile );
+	errorInfo->GetHelpContext( OUT &exception->dwHelpContext );
+	exception->scode = hr;
+	return DISP_E_EXCEPTION;
+}
+
+/**
+ * Switches the vtable calls on or off: configureDirectCalls( { enabled } ).
+ */
+NAN_METHOD( DirectCall::Configure )
+{
+	if( info.Length() < 1 || !info[ 0 ]->IsObject() ) {
+		Nan::ThrowTypeError( "Missing direct call options" );
+		return;
+	}
+
+	v8::Local< v8::Object > options = info[ 0 ].As< v8::Object >();
+	v8::Local< v8::Value > enabledValue = options->Get( Nan::New( "enabled" ).ToLocalChecked() );
+	if( !enabledValue->IsUndefined() )
+		enabled = enabledValue->BooleanValue();
+}
+
+void DirectCall::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > configure = Nan::New< v8::FunctionTemplate >( Configure );
+	exports->Set( Nan::New( "configureDirectCalls" ).ToLocalChecked(), configure->GetFunction() );
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "utils.h"
+#include <nan.h>
+
+#include <atomic>
+#include <vector>
+
+/**
+ * Calls a member of a dual interface through its vtable slot.
+ *
+ * The native signature is read from the interface half of the dual type
+ * once. The call then skips the DISPPARAMS, the DISPID lookup and the
+ * IDispatch invoke path: the arguments are taken from the marshaled
+ * VARIANTs and the result is written straight into the result VARIANT.
+ * VtableFrame lays the arguments out for the prototype of the slot; targets
+ * without a VtableFrame convention use IDispatch.
+ */
+class DirectCall
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+	static NAN_METHOD( Configure );
+
+	/**
+	 * Returns the direct call for the dispatch member or null if the member
+	 * can't be called through the vtable.
+	 */
+	static DirectCall* Create( ITypeInfo* typeInfo, const FUNCDESC* funcdesc );
+
+	bool Accepts( size_t argCount ) const { return enabled && argCount == params.size(); }
+
+	/**
+	 * Calls the member. Returns false without calling it if the object or the
+	 * arguments don't fit the native signature.
+	 */
+	bool Invoke(
+			IDispatch* obj,
+			CComVariant* args,
+			size_t argCount,
+			OUT VARIANT* presult,
+			OUT EXCEPINFO* pexcepInfo,
+			OUT HRESULT& hr );
+
+	/**
+	 * Returns the object the vtable call goes to, or null if the object doesn't
+	 * implement the interface. The queried pointer holds the reference when
+	 * the object isn't called as is.
+	 */
+	static IUnknown* VtableTarget( IDispatch* obj, const IID& iid, std::atomic< void* >& dualVtable, OUT CComPtr< IUnknown >& queried );
+
+	/**
+	 * Turns the error info of a failed vtable call into EXCEPINFO like IDispatch does.
+	 */
+	static HRESULT FillException( IUnknown* target, const IID& iid, HRESULT hr, OUT EXCEPINFO* exception );
+
+	// Native parameters including the retval.
+	static const size_t MaxParams = 16;
+
+	static std::atomic< bool > enabled;
+
+private:
+	enum Kind { Integer, Real, Single, Interface, Variant };
+
+	struct Param
+	{
+		Param() : kind( Integer ), vt( VT_EMPTY ), iid( IID_NULL ) {}
+
+		Kind kind;
+		VARTYPE vt;
+		IID iid;
+	};
+
+	DirectCall() : vtableIndex( 0 ), dualVtable( nullptr ), hasResult( false ) {}
+
+	static bool ResolveParam( ITypeInfo* typeInfo, const TYPEDESC& typedesc, OUT Param& param );
+
+	// The dual interface and the slot of the member in it.
+	IID iid;
+	size_t vtableIndex;
+
+	// IDispatch vtable of the objects that are the dual interface themselves.
+	// Saves the QueryInterface on each call.
+	std::atomic< void* > dualVtable;
+
+	// [in] parameters in declaration order.
+	std::vector< Param > params;
+
+	bool hasResult;
+	Param result;
+};
@@ -0,0 +1,492 @@
+#include "EnumIterator.h"
+
+#include "AddonState.h"
+#include "InteropInstance.h"
+#include "InteropType.h"
+#include "InvokePool.h"
+#include "MethodInfo.h"
+#include "SafeArray.h"
+
+std::atomic< ULONG > EnumIterator::defaultChunkSize( 256 );
+
+namespace
+{
+	/**
+	 * Returns Symbol[ name ] or an empty handle if the runtime doesn't have it.
+	 */
+	v8::Local< v8::Symbol > WellKnownSymbol( const char* name )
+	{
+		v8::Local< v8::Value > symbolClass = Nan::Get(
+				Nan::GetCurrentContext()->Global(), Nan::New( "Symbol" ).ToLocalChecked() ).ToLocalChecked();
+		if( !symbolClass->IsObject() )
+			return v8::Local< v8::Symbol >();
+
+		v8::Local< v8::Value > symbol = Nan::Get(
+				symbolClass.As< v8::Object >(), Nan::New( name ).ToLocalChecked() ).ToLocalChecked();
+		if( !symbol->IsSymbol() )
+			return v8::Local< v8::Symbol >();
+
+		return symbol.As< v8::Symbol >();
+	}
+
+	v8::Local< v8::Value > ErrorValue( HRESULT hr, EXCEPINFO& exception )
+	{
+		try
+		{
+			if( hr == DISP_E_EXCEPTION )
+				JsException::Throw( exception );
+
+			JsException::Throw( hr );
+		}
+		catch( JsException ex )
+		{
+			return ex.GetError();
+		}
+
+		return Nan::Undefined();
+	}
+}
+
+/**
+ * Fetches the next chunk in the worker pool.
+ */
+class EnumIterator::FetchTask : public WorkerPool::Task
+{
+public:
+	FetchTask( EnumIterator* iterator, std::vector< CComVariant >& target, v8::Local< v8::Object > handle )
+		: iterator( iterator ), target( target )
+	{
+		// Keep the iterator alive until the chunk has been delivered.
+		this->handle.Reset( handle );
+	}
+
+	~FetchTask()
+	{
+		handle.Reset();
+	}
+
+	void Execute() override
+	{
+		iterator->fetchHr = iterator->Fetch(
+				OUT target, OUT iterator->fetchEnd, OUT &iterator->fetchException );
+	}
+
+	void Complete() override
+	{
+		iterator->OnFetched( Nan::New( handle ) );
+	}
+
+private:
+	EnumIterator* iterator;
+	std::vector< CComVariant >& target;
+	Nan::Persistent< v8::Object > handle;
+};
+
+EnumIterator::EnumIterator( InteropType* type, IDispatch* instance, bool agile, ULONG chunkSize )
+	: type( type ), instance( instance ), chunkSize( chunkSize ), agile( agile ), fetchEnd( false ), fetchHr( S_OK )
+{
+}
+
+/**
+ * Calls _NewEnum for the enumerator.
+ */
+HRESULT EnumIterator::Open(
+		InteropType* type,
+		IDispatch* instance,
+		OUT CComPtr< IEnumVARIANT >& enumerator,
+		OUT EXCEPINFO* exception )
+{
+	std::vector< CComVariant > args;
+	ResultVariant result;
+	HRESULT hr = type->newEnumMethod->Invoke( instance, args, OUT &result, OUT exception );
+	if( FAILED( hr ) )
+		return hr;
+
+	// The enumerator is returned either as IUnknown or IDispatch.
+	if( ( result.vt != VT_UNKNOWN && result.vt != VT_DISPATCH ) || result.punkVal == nullptr )
+		return E_NOINTERFACE;
+
+	return result.punkVal->QueryInterface< IEnumVARIANT >( OUT &enumerator );
+}
+
+/**
+ * Reads the next chunk of items. Opens the enumerator on the first call.
+ */
+HRESULT EnumIterator::Fetch( OUT std::vector< CComVariant >& items, OUT bool& end, OUT EXCEPINFO* exception )
+{
+	items.clear();
+
+	if( !enumerator )
+	{
+		HRESULT hr = Open( type, instance, OUT enumerator, OUT exception );
+		if( FAILED( hr ) )
+			return hr;
+	}
+
+	items.resize( chunkSize );
+	ULONG fetched = 0;
+	HRESULT hr = enumerator->Next( chunkSize, items.data(), OUT &fetched );
+	if( FAILED( hr ) )
+	{
+		items.clear();
+		return hr;
+	}
+
+	items.resize( fetched );
+	end = hr == S_FALSE || fetched < chunkSize;
+	return S_OK;
+}
+
+HRESULT EnumIterator::ForEach(
+		InteropType* type,
+		IDispatch* instance,
+		const std::function< HRESULT( VARIANT& item ) >& visit,
+		OUT EXCEPINFO* exception )
+{
+	CComPtr< IEnumVARIANT > enumerator;
+	HRESULT hr = Open( type, instance, OUT enumerator, OUT exception );
+	if( FAILED( hr ) )
+		return hr;
+
+	// The chunk is reused and the items released as soon as they are visited.
+	ULONG chunkSize = defaultChunkSize;
+	std::vector< CComVariant > items( chunkSize );
+	for( ;; )
+	{
+		ULONG fetched = 0;
+		hr = enumerator->Next( chunkSize, items.data(), OUT &fetched );
+		if( FAILED( hr ) )
+			return hr;
+
+		for( ULONG i = 0; i < fetched; i++ )
+		{
+			HRESULT visitHr = visit( items[ i ] );
+			items[ i ].Clear();
+			if( FAILED( visitHr ) )
+				return visitHr;
+		}
+
+		if( hr == S_FALSE || fetched < chunkSize )
+			return S_OK;
+	}
+}
+
+/**
+ * Converts the next item of the chunk moving the strings and arrays out of it.
+ */
+v8::Local< v8::Value > EnumIterator::TakeItem()
+{
+	CComVariant& item = buffer.Take();
+
+	// The collection items are typed by the Item method.
+	if( item.vt == VT_DISPATCH )
+		return InteropInstance::GetWrapper( item.pdispVal, type->itemType );
+
+	return TakeVariant( item );
+}
+
+void EnumIterator::StartFetch( v8::Local< v8::Object > handle )
+{
+	InvokePool::Submit( new FetchTask( this, buffer.BeginPrefetch(), handle ), agile );
+}
+
+/**
+ * Receives the prefetched chunk. Executed in the v8 thread.
+ */
+void EnumIterator::OnFetched( v8::Local< v8::Object > handle )
+{
+	bool closed = buffer.IsClosed();
+	buffer.EndPrefetch( SUCCEEDED( fetchHr ), fetchEnd );
+
+	if( closed )
+		enumerator.Release();
+	else if( FAILED( fetchHr ) )
+		error.Reset( ErrorValue( fetchHr, fetchException ) );
+
+	Settle( handle );
+}
+
+/**
+ * Settles the waiting next() promises in order.
+ */
+void EnumIterator::Settle( v8::Local< v8::Object > handle )
+{
+	while( !pending.empty() )
+	{
+		buffer.Advance();
+
+		// Fetch the next chunk while this one is consumed.
+		if( buffer.CanPrefetch() && error.IsEmpty() )
+			StartFetch( handle );
+
+		v8::Local< v8::Promise::Resolver > resolver = Nan::New( *pending.front() );
+		if( buffer.HasItem() )
+		{
+			resolver->Resolve( Result( TakeItem(), false ) );
+		}
+		else if( !error.IsEmpty() )
+		{
+			// The iteration ends with the error.
+			resolver->Reject( Nan::New( error ) );
+			error.Reset();
+			Close();
+		}
+		else if( buffer.IsFetching() )
+		{
+			// Wait for the chunk.
+			return;
+		}
+		else
+		{
+			Close();
+			resolver->Resolve( Result( Nan::Undefined(), true ) );
+		}
+
+		pending.pop_front();
+	}
+}
+
+/**
+ * Releases the enumerator. Left to the fetch completion if a fetch is running.
+ */
+void EnumIterator::Close()
+{
+	if( buffer.Close() )
+		enumerator.Release();
+}
+
+v8::Local< v8::Object > EnumIterator::Result( v8::Local< v8::Value > value, bool done )
+{
+	v8::Local< v8::Object > result = Nan::New< v8::Object >();
+	State& state = Get();
+	Nan::Set( result, Nan::New( state.valueKey ), value );
+	Nan::Set( result, Nan::New( state.doneKey ), Nan::New( done ) );
+	return result;
+}
+
+EnumIterator* EnumIterator::This( Nan::NAN_METHOD_ARGS_TYPE info )
+{
+	// The iterator constructors are reachable from JavaScript through the prototypes.
+	if( info.This()->InternalFieldCount() != 1 || info.This()->GetAlignedPointerFromInternalField( 0 ) == nullptr )
+		return nullptr;
+
+	return Nan::ObjectWrap::Unwrap< EnumIterator >( info.This() );
+}
+
+/**
+ * Creates the iterator for the collection in 'this'.
+ */
+void EnumIterator::Create( bool async, Nan::NAN_METHOD_ARGS_TYPE info )
+{
+	v8::Local< v8::External > external = v8::Local< v8::External >::Cast( info.Data() );
+	InteropType* type = reinterpret_cast< InteropType* >( external->Value() );
+
+	// Optional chunk size overrides the default.
+	ULONG chunkSize = defaultChunkSize;
+	if( info.Length() > 0 && !info[ 0 ]->IsUndefined() )
+	{
+		double value = info[ 0 ]->NumberValue();
+		if( !( value >= 1 && value <= MaxChunkSize ) ) {
+			Nan::ThrowRangeError( "The chunk size must be between 1 and 65536." );
+			return;
+		}
+
+		chunkSize = static_cast< ULONG >( value );
+	}
+
+	InteropInstance* obj = InteropInstance::Unwrap< InteropInstance >( info.This() );
+	State& state = Get();
+	v8::Local< v8::Function > cons = Nan::New( async ? state.asyncIteratorConstructor : state.iteratorConstructor );
+	v8::Local< v8::Object > handle = Nan::NewInstance( cons ).ToLocalChecked();
+
+	EnumIterator* iterator = new EnumIterator( type, obj->instance, obj->IsAgile(), chunkSize );
+	iterator->Wrap( handle );
+
+	// The async iterator starts fetching right away.
+	if( async )
+		iterator->StartFetch( handle );
+
+	info.GetReturnValue().Set( handle );
+}
+
+NAN_METHOD( EnumIterator::Iterate )
+{
+	Create( false, info );
+}
+
+NAN_METHOD( EnumIterator::IterateAsync )
+{
+	Create( true, info );
+}
+
+/**
+ * Returns the next item. Fetches a new chunk once the current one runs out.
+ */
+NAN_METHOD( EnumIterator::Next )
+{
+	EnumIterator* iterator = This( info );
+	if( iterator == nullptr )
+		return Nan::ThrowTypeError( "Not an enumerator." );
+
+	try
+	{
+		if( iterator->buffer.NeedsRefill() )
+		{
+			bool end = false;
+			ExcepInfo exception;
+			HRESULT hr = iterator->Fetch( OUT iterator->buffer.BeginRefill(), OUT end, OUT &exception );
+			if( hr == DISP_E_EXCEPTION )
+				JsException::Throw( exception );
+
+			VERIFY( hr );
+			iterator->buffer.EndRefill( end );
+		}
+
+		if( iterator->buffer.HasItem() )
+		{
+			info.GetReturnValue().Set( Result( iterator->TakeItem(), false ) );
+			return;
+		}
+
+		iterator->Close();
+		info.GetReturnValue().Set( Result( Nan::Undefined(), true ) );
+	}
+	catch( JsException ex )
+	{
+		iterator->Close();
+		Nan::ThrowError( ex.GetError() );
+	}
+}
+
+/**
+ * Returns a promise of the next item.
+ */
+NAN_METHOD( EnumIterator::NextAsync )
+{
+	EnumIterator* iterator = This( info );
+	if( iterator == nullptr )
+		return Nan::ThrowTypeError( "Not an enumerator." );
+
+	auto resolver = v8::Promise::Resolver::New( info.GetIsolate() );
+	info.GetReturnValue().Set( resolver->GetPromise() );
+
+	iterator->pending.emplace_back( new Nan::Global< v8::Promise::Resolver >( resolver ) );
+	iterator->Settle( info.This() );
+}
+
+/**
+ * Ends the iteration early, for example on break out of a for-of loop.
+ */
+NAN_METHOD( EnumIterator::Return )
+{
+	EnumIterator* iterator = This( info );
+	if( iterator == nullptr )
+		return Nan::ThrowTypeError( "Not an enumerator." );
+
+	iterator->Close();
+	info.GetReturnValue().Set( Result( info[ 0 ], true ) );
+}
+
+NAN_METHOD( EnumIterator::ReturnAsync )
+{
+	EnumIterator* iterator = This( info );
+	if( iterator == nullptr )
+		return Nan::ThrowTypeError( "Not an enumerator." );
+
+	iterator->Close();
+
+	auto resolver = v8::Promise::Resolver::New( info.GetIsolate() );
+	resolver->Resolve( Result( info[ 0 ], true ) );
+	info.GetReturnValue().Set( resolver->GetPromise() );
+}
+
+NAN_METHOD( EnumIterator::Self )
+{
+	info.GetReturnValue().Set( info.This() );
+}
+
+/**
+ * Sets the iterator options: { chunkSize }.
+ */
+NAN_METHOD( EnumIterator::Configure )
+{
+	if( info.Length() < 1 || !info[ 0 ]->IsObject() ) {
+		Nan::ThrowTypeError( "Missing iterator options" );
+		return;
+	}
+
+	v8::Local< v8::Object > options = info[ 0 ].As< v8::Object >();
+	v8::Local< v8::Value > chunkSize = options->Get( Nan::New( "chunkSize" ).ToLocalChecked() );
+	if( !chunkSize->IsUndefined() )
+	{
+		double value = chunkSize->NumberValue();
+		if( !( value >= 1 && value <= MaxChunkSize ) ) {
+			Nan::ThrowRangeError( "The chunk size must be between 1 and 65536." );
+			return;
+		}
+
+		defaultChunkSize = static_cast< ULONG >( value );
+	}
+}
+
+void EnumIterator::Install(
+		InteropType* type,
+		v8::Local< v8::FunctionTemplate > constructorTemplate,
+		v8::Local< v8::FunctionTemplate > asyncConstructorTemplate )
+{
+	v8::Local< v8::Value > typeLocal = Nan::New< v8::External >( type );
+
+	v8::Local< v8::Symbol > iterator = WellKnownSymbol( "iterator" );
+	if( !iterator.IsEmpty() )
+	{
+		v8::Local< v8::FunctionTemplate > iterate = Nan::New< v8::FunctionTemplate >(
+				Iterate, typeLocal, Nan::New< v8::Signature >( constructorTemplate ) );
+		constructorTemplate->PrototypeTemplate()->Set( iterator, iterate );
+	}
+
+	v8::Local< v8::Symbol > asyncIterator = WellKnownSymbol( "asyncIterator" );
+	if( !asyncIterator.IsEmpty() )
+	{
+		v8::Local< v8::FunctionTemplate > iterateAsync = Nan::New< v8::FunctionTemplate >(
+				IterateAsync, typeLocal, Nan::New< v8::Signature >( asyncConstructorTemplate ) );
+		asyncConstructorTemplate->PrototypeTemplate()->Set( asyncIterator, iterateAsync );
+	}
+}
+
+EnumIterator::State& EnumIterator::Get()
+{
+	return AddonState::Get< State >();
+}
+
+void EnumIterator::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	State& state = Get();
+	state.valueKey.Reset( Nan::New( "value" ).ToLocalChecked() );
+	state.doneKey.Reset( Nan::New( "done" ).ToLocalChecked() );
+
+	// Iterators are iterable themselves.
+	v8::Local< v8::FunctionTemplate > iteratorTemplate = Nan::New< v8::FunctionTemplate >();
+	iteratorTemplate->SetClassName( Nan::New( "EnumIterator" ).ToLocalChecked() );
+	iteratorTemplate->InstanceTemplate()->SetInternalFieldCount( 1 );
+	Nan::SetPrototypeMethod( iteratorTemplate, "next", Next );
+	Nan::SetPrototypeMethod( iteratorTemplate, "return", Return );
+	v8::Local< v8::Symbol > iterator = WellKnownSymbol( "iterator" );
+	if( !iterator.IsEmpty() )
+		iteratorTemplate->PrototypeTemplate()->Set( iterator, Nan::New< v8::FunctionTemplate >( Self ) );
+	state.iteratorConstructor.Reset( iteratorTemplate->GetFunction() );
+
+	v8::Local< v8::FunctionTemplate > asyncIteratorTemplate = Nan::New< v8::FunctionTemplate >();
+	asyncIteratorTemplate->SetClassName( Nan::New( "AsyncEnumIterator" ).ToLocalChecked() );
+	asyncIteratorTemplate->InstanceTemplate()->SetInternalFieldCount( 1 );
+	Nan::SetPrototypeMethod( asyncIteratorTemplate, "next", NextAsync );
+	Nan::SetPrototypeMethod( asyncIteratorTemplate, "return", ReturnAsync );
+	v8::Local< v8::Symbol > asyncIterator = WellKnownSymbol( "asyncIterator" );
+	if( !asyncIterator.IsEmpty() )
+		asyncIteratorTemplate->PrototypeTemplate()->Set( asyncIterator, Nan::New< v8::FunctionTemplate >( Self ) );
+	state.asyncIteratorConstructor.Reset( asyncIteratorTemplate->GetFunction() );
+
+	v8::Local< v8::FunctionTemplate > configure = Nan::New< v8::FunctionTemplate >( Configure );
+	exports->Set( Nan::New( "configureIterators" ).ToLocalChecked(), configure->GetFunction() );
+}
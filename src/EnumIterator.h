@@ -0,0 +1,117 @@
+#pragma once
+
+#include "utils.h"
+#include "ChunkBuffer.h"
+#include "WorkerPool.h"
+#include <nan.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class InteropType;
+
+/**
+ * JavaScript iterator over the IEnumVARIANT of a collection.
+ *
+ * Types with a _NewEnum member get [Symbol.iterator] on the prototype and
+ * [Symbol.asyncIterator] on the async prototype. The items are fetched with
+ * IEnumVARIANT::Next in chunks. The async iterator fetches the next chunk in
+ * the worker pool while the current one is being consumed.
+ */
+class EnumIterator : public Nan::ObjectWrap
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+
+	/**
+	 * Adds the iterator methods to the prototypes of the collection type.
+	 */
+	static void Install(
+			InteropType* type,
+			v8::Local< v8::FunctionTemplate > constructorTemplate,
+			v8::Local< v8::FunctionTemplate > asyncConstructorTemplate );
+
+	static NAN_METHOD( Iterate );
+	static NAN_METHOD( IterateAsync );
+	static NAN_METHOD( Next );
+	static NAN_METHOD( NextAsync );
+	static NAN_METHOD( Return );
+	static NAN_METHOD( ReturnAsync );
+	static NAN_METHOD( Self );
+	static NAN_METHOD( Configure );
+
+	/**
+	 * Calls visit for each item of the collection. Usable from the worker threads.
+	 */
+	static HRESULT ForEach(
+			InteropType* type,
+			IDispatch* instance,
+			const std::function< HRESULT( VARIANT& item ) >& visit,
+			OUT EXCEPINFO* exception );
+
+	// Upper limit for the chunk size.
+	static const ULONG MaxChunkSize = 64 * 1024;
+
+private:
+	class FetchTask;
+
+	EnumIterator( InteropType* type, IDispatch* instance, bool agile, ULONG chunkSize );
+	~EnumIterator() {}
+
+	static void Create( bool async, Nan::NAN_METHOD_ARGS_TYPE info );
+	static EnumIterator* This( Nan::NAN_METHOD_ARGS_TYPE info );
+	static v8::Local< v8::Object > Result( v8::Local< v8::Value > value, bool done );
+
+	// Usable from the worker threads.
+	static HRESULT Open(
+			InteropType* type,
+			IDispatch* instance,
+			OUT CComPtr< IEnumVARIANT >& enumerator,
+			OUT EXCEPINFO* exception );
+	HRESULT Fetch( OUT std::vector< CComVariant >& items, OUT bool& end, OUT EXCEPINFO* exception );
+
+	v8::Local< v8::Value > TakeItem();
+	void StartFetch( v8::Local< v8::Object > handle );
+	void OnFetched( v8::Local< v8::Object > handle );
+	void Settle( v8::Local< v8::Object > handle );
+	void Close();
+
+	InteropType* type;
+	CComPtr< IDispatch > instance;
+	CComPtr< IEnumVARIANT > enumerator;
+	ULONG chunkSize;
+
+	// The fetches run in the pool only if the collection is agile.
+	bool agile;
+
+	ChunkBuffer< CComVariant > buffer;
+
+	// Worker side of the async iterator. Only the worker touches the
+	// results while fetching.
+	bool fetchEnd;
+	HRESULT fetchHr;
+	ExcepInfo fetchException;
+
+	// Error of a failed fetch waiting for the next next() call.
+	Nan::Global< v8::Value > error;
+
+	// Promises of the next() calls waiting for items.
+	std::deque< std::unique_ptr< Nan::Global< v8::Promise::Resolver > > > pending;
+
+	// Iterator classes of the environment.
+	struct State
+	{
+		Nan::Global< v8::Function > iteratorConstructor;
+		Nan::Global< v8::Function > asyncIteratorConstructor;
+		Nan::Global< v8::String > valueKey;
+		Nan::Global< v8::String > doneKey;
+	};
+
+	static State& Get();
+
+	// Read by the worker threads.
+	static std::atomic< ULONG > defaultChunkSize;
+};
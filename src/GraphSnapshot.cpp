@@ -0,0 +1,305 @@
+#include "GraphSnapshot.h"
+
+#include "EnumIterator.h"
+#include "InteropInstance.h"
+#include "InteropType.h"
+#include "InvokePool.h"
+#include "MethodInfo.h"
+#include "SafeArray.h"
+
+#include <sstream>
+
+namespace
+{
+	/**
+	 * Returns the object in the variant or null.
+	 */
+	CComPtr< IDispatch > ObjectOf( const VARIANT& variant )
+	{
+		CComPtr< IDispatch > dispatch;
+		if( variant.vt == VT_DISPATCH )
+			dispatch = variant.pdispVal;
+		else if( variant.vt == VT_UNKNOWN && variant.punkVal != nullptr )
+			variant.punkVal->QueryInterface< IDispatch >( OUT &dispatch );
+
+		return dispatch;
+	}
+
+	void ThrowSpec( const std::string& path, const char* message )
+	{
+		std::stringstream ss;
+		ss << "'" << ( path.empty() ? "<root>" : path ) << "': " << message;
+		JsException::Throw( ss.str().c_str() );
+	}
+}
+
+/**
+ * Queues the walk: readGraph( obj, { Title: true, Properties: [ { Value: { DisplayValue: true } } ] } ).
+ *
+ * Spec values are true for values, an object spec for a nested object and
+ * [ spec ] for the items of a collection. Returns a promise of the plain
+ * objects and arrays.
+ */
+NAN_METHOD( GraphSnapshot::Read )
+{
+	if( info.Length() < 2 || !info[ 0 ]->IsObject() || !info[ 1 ]->IsObject() ) {
+		Nan::ThrowTypeError( "Usage: readGraph( object, spec )" );
+		return;
+	}
+
+	InteropInstance* obj = InteropInstance::FromValue( info[ 0 ] );
+	if( obj == nullptr ) {
+		Nan::ThrowTypeError( "The graph root must be a COM object." );
+		return;
+	}
+
+	std::unique_ptr< GraphSnapshot > snapshot( new GraphSnapshot() );
+
+	try
+	{
+		Compile( obj->type, info[ 1 ], std::string(), OUT snapshot->rootField );
+	}
+	catch( JsException ex )
+	{
+		Nan::ThrowError( ex.GetError() );
+		return;
+	}
+
+	snapshot->root = obj->instance;
+	snapshot->rootHandle.Reset( info[ 0 ].As< v8::Object >() );
+
+	auto resolver = v8::Promise::Resolver::New( info.GetIsolate() );
+	snapshot->resolver.Reset( resolver );
+	info.GetReturnValue().Set( resolver->GetPromise() );
+
+	InvokePool::Submit( snapshot.release(), obj->IsAgile() );
+}
+
+/**
+ * Resolves the spec for a value of the given static type.
+ */
+void GraphSnapshot::Compile( InteropType* type, v8::Local< v8::Value > spec, const std::string& path, OUT Field& field )
+{
+	if( spec->IsArray() )
+	{
+		v8::Local< v8::Array > specArray = spec.As< v8::Array >();
+		if( specArray->Length() != 1 )
+			ThrowSpec( path, "Collection specs have a single item spec: [ spec ]." );
+
+		// Coclasses have the collection members on their default interface.
+		if( type != nullptr )
+			type = type->FindCollectionType();
+		if( type == nullptr )
+			ThrowSpec( path, "Not an enumerable collection." );
+
+		field.kind = Field::Items;
+		field.collectionType = type;
+		field.itemType = type->itemType;
+
+		v8::Local< v8::Value > itemSpec = specArray->Get( 0 );
+		if( itemSpec->IsTrue() )
+			return;
+
+		if( field.itemType == nullptr )
+			ThrowSpec( path, "The collection items have no static type." );
+
+		field.node.reset( new Node() );
+		CompileNode( field.itemType, itemSpec.As< v8::Object >(), path + "[]", OUT *field.node );
+	}
+	else if( spec->IsObject() )
+	{
+		if( type == nullptr )
+			ThrowSpec( path, "The object has no static type." );
+
+		field.kind = Field::Object;
+		field.node.reset( new Node() );
+		CompileNode( type, spec.As< v8::Object >(), path, OUT *field.node );
+	}
+	else if( spec->IsTrue() && field.getter != nullptr )
+	{
+		field.kind = Field::Scalar;
+	}
+	else
+	{
+		ThrowSpec( path, "Expected true, an object spec or [ spec ]." );
+	}
+}
+
+void GraphSnapshot::CompileNode( InteropType* type, v8::Local< v8::Object > spec, const std::string& path, OUT Node& node )
+{
+	if( !spec->IsObject() || spec->IsArray() )
+		ThrowSpec( path, "Expected an object spec." );
+
+	v8::Local< v8::Array > names = Nan::GetOwnPropertyNames( spec ).ToLocalChecked();
+	node.fields.resize( names->Length() );
+	for( uint32_t i = 0; i < names->Length(); i++ )
+	{
+		Field& field = node.fields[ i ];
+		v8::Local< v8::Value > name = names->Get( i );
+		field.name = *v8::String::Utf8Value( name );
+
+		std::string fieldPath = path.empty() ? field.name : path + "." + field.name;
+		field.getter = type->FindMethod( field.name );
+		if( field.getter == nullptr )
+			ThrowSpec( fieldPath, "Not found." );
+
+		field.getter->plan->InitArgs( ArrayArgs( Nan::New< v8::Array >() ), OUT field.args );
+		Compile( field.getter->plan->result.refType, Nan::Get( spec, name ).ToLocalChecked(), fieldPath, OUT field );
+	}
+}
+
+/**
+ * Walks the graph. Executed in the worker thread.
+ */
+void GraphSnapshot::Execute()
+{
+	hr = ReadField( rootField, root, OUT rootValue );
+}
+
+/**
+ * Reads the field of the object. The root field has no getter and stands for the object itself.
+ */
+HRESULT GraphSnapshot::ReadField( const Field& field, IDispatch* object, OUT Value& value )
+{
+	if( field.getter != nullptr )
+	{
+		HRESULT hr = field.getter->Invoke( object, field.args, OUT &value.value, OUT &exception );
+		if( FAILED( hr ) )
+			return hr;
+	}
+	else
+	{
+		value.value = object;
+	}
+
+	if( field.kind == Field::Scalar )
+	{
+		value.kind = Value::Scalar;
+		return S_OK;
+	}
+
+	// Objects and collections are read further and only their values kept.
+	CComPtr< IDispatch > child = ObjectOf( value.value );
+	value.value.Clear();
+	if( child == nullptr )
+		return S_OK;
+
+	if( field.kind == Field::Object )
+		return ReadObject( *field.node, child, OUT value );
+
+	value.kind = Value::Array;
+	return EnumIterator::ForEach(
+			field.collectionType, child,
+			[ this, &field, &value ]( VARIANT& item ) -> HRESULT {
+				value.children.emplace_back();
+				Value& itemValue = value.children.back();
+				if( !field.node )
+				{
+					itemValue.kind = Value::Scalar;
+					return itemValue.value.Attach( &item );
+				}
+
+				CComPtr< IDispatch > itemObject = ObjectOf( item );
+				if( itemObject == nullptr )
+					return S_OK;
+
+				return ReadObject( *field.node, itemObject, OUT itemValue );
+			},
+			OUT &exception );
+}
+
+HRESULT GraphSnapshot::ReadObject( const Node& node, IDispatch* object, OUT Value& value )
+{
+	value.kind = Value::Object;
+	value.children.resize( node.fields.size() );
+	for( size_t i = 0; i < node.fields.size(); i++ )
+	{
+		HRESULT hr = ReadField( node.fields[ i ], object, OUT value.children[ i ] );
+		if( FAILED( hr ) )
+			return hr;
+	}
+
+	return S_OK;
+}
+
+v8::Local< v8::Value > GraphSnapshot::ToValue( const Field& field, Value& value )
+{
+	switch( value.kind )
+	{
+	case Value::Scalar:
+		return field.getter->plan->ToValue( value.value );
+
+	case Value::Object:
+		return ToObject( *field.node, value );
+
+	case Value::Array:
+	{
+		v8::Local< v8::Array > items = Nan::New< v8::Array >( static_cast< int >( value.children.size() ) );
+		for( uint32_t i = 0; i < value.children.size(); i++ )
+		{
+			Value& item = value.children[ i ];
+
+			// Items without a spec are typed by the Item method like in iteration.
+			v8::Local< v8::Value > itemValue;
+			if( item.kind == Value::Object )
+				itemValue = ToObject( *field.node, item );
+			else if( item.kind == Value::Null )
+				itemValue = Nan::Null();
+			else if( item.value.vt == VT_DISPATCH )
+				itemValue = InteropInstance::GetWrapper( item.value.pdispVal, field.itemType );
+			else
+				itemValue = TakeVariant( item.value );
+
+			Nan::Set( items, i, itemValue );
+		}
+		return items;
+	}
+
+	default:
+		return Nan::Null();
+	}
+}
+
+v8::Local< v8::Object > GraphSnapshot::ToObject( const Node& node, Value& value )
+{
+	v8::Local< v8::Object > object = Nan::New< v8::Object >();
+	for( size_t i = 0; i < node.fields.size(); i++ )
+	{
+		const Field& field = node.fields[ i ];
+		Nan::Set( object, Nan::New( field.name ).ToLocalChecked(), ToValue( field, value.children[ i ] ) );
+	}
+
+	return object;
+}
+
+/**
+ * Settles the promise with the converted graph. Executed in the v8 thread.
+ */
+void GraphSnapshot::Complete()
+{
+	auto promiseResolver = Nan::New( resolver );
+	resolver.Reset();
+	rootHandle.Reset();
+
+	try
+	{
+		if( hr == DISP_E_EXCEPTION )
+			JsException::Throw( exception );
+		else if( FAILED( hr ) )
+			JsException::Throw( hr );
+
+		promiseResolver->Resolve( ToValue( rootField, rootValue ) );
+	}
+	catch( JsException ex )
+	{
+		promiseResolver->Reject( ex.GetError() );
+	}
+}
+
+void GraphSnapshot::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > read = Nan::New< v8::FunctionTemplate >( Read );
+	exports->Set( Nan::New( "readGraph" ).ToLocalChecked(), read->GetFunction() );
+}
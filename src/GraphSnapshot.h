@@ -0,0 +1,93 @@
+#pragma once
+
+#include "utils.h"
+#include "WorkerPool.h"
+#include <nan.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class InteropType;
+class MethodInfo;
+
+/**
+ * Reads a graph of objects into plain JavaScript values.
+ *
+ * The projection spec names the properties to read on each level. It is
+ * resolved against the static result types before the walk so the worker
+ * can follow the graph without JavaScript wrappers for the intermediate
+ * objects. The values are converted in one go once the walk is done.
+ */
+class GraphSnapshot : public WorkerPool::Task
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+	static NAN_METHOD( Read );
+
+	void Execute() override;
+	void Complete() override;
+
+private:
+	struct Node;
+
+	// Property of a spec level and what to do with its value.
+	struct Field
+	{
+		enum Kind { Scalar, Object, Items };
+
+		Field() : getter( nullptr ), kind( Scalar ), collectionType( nullptr ), itemType( nullptr ) {}
+
+		std::string name;
+		MethodInfo* getter;
+		std::vector< CComVariant > args;
+		Kind kind;
+
+		// Collection and item types of Items fields.
+		InteropType* collectionType;
+		InteropType* itemType;
+
+		// Spec of the object or of each item. Items without one are read as values.
+		std::unique_ptr< Node > node;
+	};
+
+	struct Node
+	{
+		std::vector< Field > fields;
+	};
+
+	// Value read by the worker. Objects have a child per field, arrays per item.
+	struct Value
+	{
+		enum Kind { Null, Scalar, Object, Array };
+
+		Value() : kind( Null ) {}
+
+		Kind kind;
+		CComVariant value;
+		std::vector< Value > children;
+	};
+
+	GraphSnapshot() : hr( S_OK ) {}
+
+	static void Compile( InteropType* type, v8::Local< v8::Value > spec, const std::string& path, OUT Field& field );
+	static void CompileNode( InteropType* type, v8::Local< v8::Object > spec, const std::string& path, OUT Node& node );
+
+	// Usable from the worker threads.
+	HRESULT ReadField( const Field& field, IDispatch* object, OUT Value& value );
+	HRESULT ReadObject( const Node& node, IDispatch* object, OUT Value& value );
+
+	static v8::Local< v8::Value > ToValue( const Field& field, Value& value );
+	static v8::Local< v8::Object > ToObject( const Node& node, Value& value );
+
+	// Keeps the root wrapper alive while the worker walks the graph.
+	Nan::Persistent< v8::Object > rootHandle;
+	CComPtr< IDispatch > root;
+	Field rootField;
+	Value rootValue;
+
+	ExcepInfo exception;
+	HRESULT hr;
+
+	Nan::Persistent< v8::Promise::Resolver > resolver;
+};
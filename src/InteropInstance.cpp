@@ -1,13 +1,189 @@
+
 #include "InteropInstance.h"
 
+#include "AddonState.h"
+#include "InteropType.h"
 
+InteropInstance::State& InteropInstance::Get()
+{
+	return AddonState::Get< State >();
+}
 
 InteropInstance::InteropInstance( const CComPtr< IDispatch >& ptr )
-	: instance( ptr )
+	: instance( ptr ), type( nullptr ), threading( ThreadingUnknown )
 {
+	if( instance )
+		ResourceStats::interfaces++;
 }
 
 
 InteropInstance::~InteropInstance()
 {
+	if( instance )
+		ResourceStats::interfaces--;
+
+	if( identity )
+	{
+		// Another wrapper might have taken over the identity.
+		auto& identityMap = Get().identityMap;
+		auto range = identityMap.equal_range( identity );
+		for( auto it = range.first; it != range.second; ++it )
+		{
+			if( it->second == this )
+			{
+				identityMap.erase( it );
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * Registers the wrapper as the JS object for its COM identity and type.
+ *
+ * The identity is queried from the instance unless it is already known.
+ */
+void InteropInstance::Track( IUnknown* knownIdentity )
+{
+	if( !instance || identity )
+		return;
+
+	if( knownIdentity != nullptr )
+		identity = knownIdentity;
+	else
+		instance->QueryInterface< IUnknown >( OUT &identity );
+
+	// Replace the previous wrapper of the same type.
+	auto& identityMap = Get().identityMap;
+	auto range = identityMap.equal_range( identity );
+	for( auto it = range.first; it != range.second; ++it )
+	{
+		if( it->second->type == type )
+		{
+			it->second = this;
+			return;
+		}
+	}
+
+	identityMap.emplace( identity, this );
+}
+
+/**
+ * Returns true if the object can be called from the multithreaded apartment.
+ *
+ * Other objects belong to the apartment of the main thread. Calling them from
+ * the pool's threads would bypass their threading model, or fail with
+ * RPC_E_WRONG_THREAD for proxies.
+ */
+bool InteropInstance::IsAgile()
+{
+	if( threading == ThreadingUnknown )
+		threading = instance && ::IsAgile( instance ) ? ThreadingAgile : ThreadingApartment;
+
+	return threading == ThreadingAgile;
+}
+
+/**
+ * Returns the live wrapper of the object with the type.
+ */
+InteropInstance* InteropInstance::Find( IUnknown* identity, InteropType* type )
+{
+	auto& identityMap = Get().identityMap;
+	auto range = identityMap.equal_range( identity );
+	for( auto it = range.first; it != range.second; ++it )
+		if( it->second->type == type )
+			return it->second;
+
+	return nullptr;
+}
+
+/**
+ * Returns the JS object for the pointer.
+ *
+ * Reuses the existing wrapper if the same COM object is still referenced
+ * from JS through the same type. Otherwise creates a new one using the type
+ * constructor if one is known.
+ */
+v8::Local< v8::Value > InteropInstance::GetWrapper( IDispatch* ptr, InteropType* type )
+{
+	if( ptr == nullptr )
+		return Nan::Null();
+
+	CComPtr< IUnknown > iunk;
+	ptr->QueryInterface< IUnknown >( OUT &iunk );
+	return GetWrapper( ptr, iunk, type );
+}
+
+/**
+ * Returns the JS object for the pointer whose COM identity is already known.
+ */
+v8::Local< v8::Value > InteropInstance::GetWrapper( IDispatch* ptr, IUnknown* identity, InteropType* type )
+{
+	if( ptr == nullptr )
+		return Nan::Null();
+
+	// Wrappers of other types call through a different ITypeInfo.
+	InteropInstance* existing = Find( identity, type );
+	if( existing != nullptr )
+		return existing->handle();
+
+	if( type != nullptr )
+	{
+		// The constructor tracks the new wrapper under the identity.
+		v8::Local< v8::Value > argv[ 2 ] = { Nan::New< v8::External >( ptr ), Nan::New< v8::External >( identity ) };
+		v8::Local< v8::Function > cons = type->GetConstructor();
+		return cons->NewInstance( Nan::GetCurrentContext(), 2, argv ).ToLocalChecked();
+	}
+
+	// No type information. Wrap into a plain object.
+	auto obj = Nan::NewInstance( GetObjectTemplate()->InstanceTemplate() ).ToLocalChecked();
+	InteropInstance* instance = new InteropInstance( ptr );
+	instance->Wrap( obj );
+	instance->Track( identity );
+	return obj;
+}
+
+/**
+ * Returns the wrapper of the value if it is a COM object or an async facade.
+ *
+ * The internal field count alone doesn't identify the wrappers: TypedArrays
+ * and the iterators have internal fields too.
+ */
+InteropInstance* InteropInstance::FromValue( v8::Local< v8::Value > value )
+{
+	if( value.IsEmpty() || !value->IsObject() )
+		return nullptr;
+
+	v8::Local< v8::Object > obj = value.As< v8::Object >();
+	if( !GetObjectTemplate()->HasInstance( obj ) && !GetFacadeTemplate()->HasInstance( obj ) )
+		return nullptr;
+
+	// The facades share the wrapper of their object in the same field.
+	return static_cast< InteropInstance* >( obj->GetAlignedPointerFromInternalField( 0 ) );
+}
+
+v8::Local< v8::FunctionTemplate > InteropInstance::GetObjectTemplate()
+{
+	State& state = Get();
+	if( state.objectTemplate.IsEmpty() )
+	{
+		v8::Local< v8::FunctionTemplate > objTemplate = Nan::New< v8::FunctionTemplate >();
+		objTemplate->InstanceTemplate()->SetInternalFieldCount( 1 );
+		state.objectTemplate.Reset( objTemplate );
+	}
+
+	return Nan::New( state.objectTemplate );
+}
+
+v8::Local< v8::FunctionTemplate > InteropInstance::GetFacadeTemplate()
+{
+	State& state = Get();
+	if( state.facadeTemplate.IsEmpty() )
+	{
+		v8::Local< v8::FunctionTemplate > facadeTemplate = Nan::New< v8::FunctionTemplate >();
+		facadeTemplate->InstanceTemplate()->SetInternalFieldCount( 2 );
+		state.facadeTemplate.Reset( facadeTemplate );
+	}
+
+	return Nan::New( state.facadeTemplate );
 }
@@ -3,6 +3,8 @@
 #include "utils.h"
 #include <nan.h>
 
+#include <unordered_map>
+
 class InteropType;
 
 class InteropInstance : public Nan::ObjectWrap
@@ -14,6 +16,9 @@ public:
 
 	CComPtr< IDispatch > instance;
 
+	// Type of the wrapper or null for untyped wrappers.
+	InteropType* type;
+
 	inline void Wrap( v8::Local< v8::Object > handle ) { Nan::ObjectWrap::Wrap( handle ); }
 
 	/*
@@ -24,6 +29,52 @@ public:
 	}
 	*/
 
+	void Track( IUnknown* knownIdentity = nullptr );
+
+	/**
+	 * Returns true if the threads of the invocation pool can call the object.
+	 */
+	bool IsAgile();
+
+	static v8::Local< v8::Value > GetWrapper( IDispatch* ptr, InteropType* type );
+	static v8::Local< v8::Value > GetWrapper( IDispatch* ptr, IUnknown* identity, InteropType* type );
+	static size_t TrackedCount() { return Get().identityMap.size(); }
+
+	/**
+	 * Returns the wrapper of a COM object or of its async facade. Other
+	 * values, including objects with internal fields of their own, give null.
+	 */
+	static InteropInstance* FromValue( v8::Local< v8::Value > value );
+
+	// Templates the type templates inherit from. Untyped wrappers are
+	// instances of the object template directly.
+	static v8::Local< v8::FunctionTemplate > GetObjectTemplate();
+	static v8::Local< v8::FunctionTemplate > GetFacadeTemplate();
+
 	friend InteropType;
-};
 
+private:
+
+	static InteropInstance* Find( IUnknown* identity, InteropType* type );
+
+	// Canonical IUnknown used as the identity map key.
+	CComPtr< IUnknown > identity;
+
+	// Checked on the first async call.
+	enum Threading { ThreadingUnknown, ThreadingAgile, ThreadingApartment };
+	Threading threading;
+
+	struct State
+	{
+		// Wrappers that are still alive, by their canonical IUnknown. An object
+		// returned through different interfaces has a wrapper for each type.
+		//
+		// Entries are removed in the destructor, which Nan::ObjectWrap invokes
+		// from the V8 weak callback once the JS object has been collected.
+		std::unordered_multimap< IUnknown*, InteropInstance* > identityMap;
+		Nan::Global< v8::FunctionTemplate > objectTemplate;
+		Nan::Global< v8::FunctionTemplate > facadeTemplate;
+	};
+
+	static State& Get();
+};
@@ -1,64 +1,63 @@
 
 #include "common.h"
+#include "ArgBuffer.h"
+#include "BatonPool.h"
 #include "CollectionInfo.h"
+#include "EnumIterator.h"
 #include "InteropType.h"
 #include "InteropInstance.h"
+#include "InvokeBaton.h"
+#include "InvokeBatch.h"
+#include "InvokePool.h"
 #include "MethodInfo.h"
+#include "Snapshot.h"
 #include "TypeLib.h"
+#include <map>
 #include <memory>
 
 #include <iostream>
 
-namespace {
-	void DoInvokeAsync( uv_work_t* req );
-	void DoInvokeAfter( uv_work_t* req, int status );
-	v8::Local< v8::Value > GetInvokeResult( HRESULT hr, MethodInfo* methodInfo, VARIANT& result, EXCEPINFO& exception );
-}
-
-struct InvokeBaton
-{
-	uv_work_t request;
-
-	// Make sure the target and callee don't go out of scope.
-	Nan::Persistent< v8::Object > target;
-	Nan::Persistent< v8::Function > callee;
-	std::unique_ptr< std::vector< CComVariant > > pargs;
-
-	// Method info reference is held by the callee.
-	// The pointer should stay alive as long as the callee stays alive.
-	InteropInstance* obj;
-	MethodInfo* methodInfo;
-
-	VARIANT result;
-	EXCEPINFO exception;
-	HRESULT hr;
-
-	Nan::Persistent< v8::Promise::Resolver > resolver;
-};
-
-InteropType::InteropType( const CComPtr< ITypeInfo >& typeInfo, TYPEATTR* typeattr, const TypeLib* typeLib )
-	: typeInfo( typeInfo ), typeattr( typeattr ), hasInit( false ), typeLib( typeLib )
+InteropType::InteropType( const CComPtr< ITypeInfo >& typeInfo, TYPEATTR* typeattr, const TypeLibSource& source )
+	: typeInfo( typeInfo ), itemType( nullptr ), baseType( nullptr ), snapshotType( nullptr ), source( source ), typeattr( typeattr ), hasInit( false )
 {
 	// Get the type name.
 	CComBSTR bstrName;
 	typeInfo->GetDocumentation( MEMBERID_NIL, OUT &bstrName, nullptr, nullptr, nullptr );
-	name = Nan::New( ToUTF8( bstrName ).c_str() ).ToLocalChecked();
+	v8::Local< v8::String > nameLocal = Nan::New( ToUTF8( bstrName ).c_str() ).ToLocalChecked();
+	name.Reset( nameLocal );
 
 	// Init the constructor template here. We'll need this when we are initing other classes.
-	constructorTemplate = Nan::New< v8::FunctionTemplate >( New, Nan::New< v8::External >( this ) );
-	constructorTemplate->SetClassName( name );
-	constructorTemplate->InstanceTemplate()->SetInternalFieldCount( 1 );
-
-	asyncConstructorTemplate = Nan::New< v8::FunctionTemplate >( NewAsync, Nan::New< v8::External >( this ) );
-	asyncConstructorTemplate->SetClassName( Nan::New( ( ToUTF8( bstrName ) + "$Async" ).c_str() ).ToLocalChecked() );
-	asyncConstructorTemplate->InstanceTemplate()->SetInternalFieldCount( 1 );
+	v8::Local< v8::FunctionTemplate > ctorTemplate = Nan::New< v8::FunctionTemplate >( New, Nan::New< v8::External >( this ) );
+	ctorTemplate->SetClassName( nameLocal );
+	ctorTemplate->InstanceTemplate()->SetInternalFieldCount( 1 );
+	constructorTemplate.Reset( ctorTemplate );
+
+	// The async facade shares the InteropInstance of its object and keeps the object alive.
+	v8::Local< v8::FunctionTemplate > asyncCtorTemplate = Nan::New< v8::FunctionTemplate >( NewAsync, Nan::New< v8::External >( this ) );
+	asyncCtorTemplate->SetClassName( Nan::New( ( ToUTF8( bstrName ) + "$Async" ).c_str() ).ToLocalChecked() );
+	asyncCtorTemplate->InstanceTemplate()->SetInternalFieldCount( 2 );
+	asyncConstructorTemplate.Reset( asyncCtorTemplate );
+
+	// The facade is created on the first .Async access.
+	v8::Local< v8::FunctionTemplate > asyncGetter = Nan::New< v8::FunctionTemplate >(
+			GetAsync, Nan::New< v8::External >( this ), Nan::New< v8::Signature >( ctorTemplate ) );
+	ctorTemplate->PrototypeTemplate()->SetAccessorProperty(
+			Nan::New( "Async" ).ToLocalChecked(),
+			asyncGetter,
+			v8::Local< v8::FunctionTemplate >(),
+			static_cast< v8::PropertyAttribute >( v8::DontEnum | v8::DontDelete ) );
 }
 
-void InteropType::Init( const TypeLib* typeLib )
+void InteropType::Init()
 {
 	if( hasInit ) return;
 	hasInit = true;
-	this->typeLib = typeLib;
+
+	Nan::HandleScope scope;
+	TypeLib::InitTimer timer( *source.stats );
+
+	v8::Local< v8::FunctionTemplate > constructorTemplate = Nan::New( this->constructorTemplate );
+	v8::Local< v8::FunctionTemplate > asyncConstructorTemplate = Nan::New( this->asyncConstructorTemplate );
 
 	// Check if this is a coclass that implements a type.
 	bool inherited = false;
@@ -81,51 +80,101 @@ void InteropType::Init( const TypeLib* typeLib )
 		typeInfo->GetRefTypeInfo( implRef, &implTypeInfo );
 
 		// Inherit from the type template.
-		std::shared_ptr< InteropType > implType = typeLib->GetInteropType( implTypeInfo );
-		implType->Init( typeLib );
+		std::shared_ptr< InteropType > implType = TypeLib::GetInteropType( implTypeInfo );
+		implType->Init();
 		implType->AddSubclass( this );
+		baseType = implType.get();
 
 		// Set the prototype path.
-		constructorTemplate->Inherit( implType->constructorTemplate );
-		asyncConstructorTemplate->Inherit( implType->asyncConstructorTemplate );
+		constructorTemplate->Inherit( Nan::New( implType->constructorTemplate ) );
+		asyncConstructorTemplate->Inherit( Nan::New( implType->asyncConstructorTemplate ) );
 		inherited = true;
 	}
 
+	// Types without a base inherit the common templates that identify the wrappers.
+	if( !inherited )
+	{
+		constructorTemplate->Inherit( InteropInstance::GetObjectTemplate() );
+		asyncConstructorTemplate->Inherit( InteropInstance::GetFacadeTemplate() );
+	}
+
+	// The snapshot lists the functions in the same order as the type info.
+	// Fall back to the type info if the library has changed since.
+	const Snapshot* snapshot = source.core->GetSnapshot();
+	const SnapshotFunc* snapshotFuncs = nullptr;
+	if( snapshot != nullptr && snapshotType != nullptr && snapshotType->funcCount == typeattr->cFuncs )
+		snapshotFuncs = snapshot->Funcs( *snapshotType );
+
+	// Property accessors are defined once both halves have been seen.
+	struct Accessor
+	{
+		v8::Local< v8::FunctionTemplate > getter;
+		v8::Local< v8::FunctionTemplate > setter;
+	};
+	std::map< std::string, Accessor > accessors;
+
 	// Create JS function templates for all COM functions.
 	for( WORD i = 0; i < typeattr->cFuncs; ++i )
 	{
 		// Generate the method info.
-		std::unique_ptr< MethodInfo > methodInfo( new MethodInfo( typeInfo, typeattr->guid, i, typeLib ) );
-		if( methodInfo->funcdesc->wFuncFlags & FUNCFLAG_FRESTRICTED )
+		std::unique_ptr< MethodInfo > methodInfo( new MethodInfo( typeInfo, typeattr->guid, i ) );
+		const FUNCDESC* funcdesc = methodInfo->funcdesc;
+
+		// A stale or reordered snapshot would bind the names to the wrong
+		// members. Stop using it for the rest of the type on any mismatch.
+		const SnapshotFunc* snapshotFunc = snapshotFuncs != nullptr ? &snapshotFuncs[ i ] : nullptr;
+		if( snapshotFunc != nullptr &&
+			( snapshotFunc->memid != funcdesc->memid ||
+			  snapshotFunc->invkind != funcdesc->invkind ||
+			  snapshotFunc->paramCount != funcdesc->cParams ) )
+		{
+			snapshotFuncs = nullptr;
+			snapshotFunc = nullptr;
+		}
+
+		// _NewEnum is usually restricted but is needed for the iterators.
+		if( funcdesc->memid == DISPID_NEWENUM )
+			newEnumMethod.reset( new MethodInfo( typeInfo, typeattr->guid, i ) );
+
+		if( funcdesc->wFuncFlags & FUNCFLAG_FRESTRICTED )
 			continue;
 
 		// Grab the important bits from the methodInfo before we release it to v8::External.
-		CComBSTR bstrFuncName;
-		typeInfo->GetDocumentation( methodInfo->funcdesc->memid, OUT &bstrFuncName, nullptr, nullptr, nullptr );
-		INVOKEKIND invkind = methodInfo->funcdesc->invkind;
+		std::string name;
+		if( snapshotFunc != nullptr )
+		{
+			name = snapshot->String( snapshotFunc->name );
+		}
+		else
+		{
+			CComBSTR bstrFuncName;
+			typeInfo->GetDocumentation( funcdesc->memid, OUT &bstrFuncName, nullptr, nullptr, nullptr );
+			name = ToUTF8( bstrFuncName );
+		}
+
+		INVOKEKIND invkind = funcdesc->invkind;
+		SHORT cParams = funcdesc->cParams;
+		bool indexParam = cParams > 0 &&
+				funcdesc->lprgelemdescParam[ 0 ].tdesc.vt == VT_I4 &&
+				funcdesc->lprgelemdescParam[ 0 ].paramdesc.wParamFlags & PARAMFLAG_FIN;
 
 		// If the type has 'Add' method it can be used to construct
 		// the type from an array.
-		if( wcscmp( bstrFuncName, L"Add" ) == 0 &&
-			methodInfo->funcdesc->cParams == 2 &&
-			methodInfo->funcdesc->lprgelemdescParam[ 0 ].tdesc.vt == VT_I4 &&
-			methodInfo->funcdesc->lprgelemdescParam[ 0 ].paramdesc.wParamFlags & PARAMFLAG_FIN )
+		if( name == "Add" && cParams == 2 && indexParam )
 		{
 			// Suitable Add-method was found.
 			// Create the collection info.
 			// We need to create a new MethodInfo as the current 'methodInfo' will be released for
 			// v8::External later.
 			this->collectionInfo.reset(
-					new CollectionInfo( new MethodInfo( typeInfo, typeattr->guid, i, typeLib ) ) );
+					new CollectionInfo( new MethodInfo( typeInfo, typeattr->guid, i ) ) );
 		}
 
 		// Check for 'Item( int )' method.
-		if( wcscmp( bstrFuncName, L"Item" ) == 0 &&
-			methodInfo->funcdesc->cParams == 1 &&
-			methodInfo->funcdesc->lprgelemdescParam[ 0 ].tdesc.vt == VT_I4 &&
-			methodInfo->funcdesc->lprgelemdescParam[ 0 ].paramdesc.wParamFlags & PARAMFLAG_FIN )
+		if( name == "Item" && cParams == 1 && indexParam )
 		{
 			Nan::SetIndexedPropertyHandler( constructorTemplate->PrototypeTemplate(), GetIndex );
+			itemType = methodInfo->plan->result.refType;
 		}
 
 		// Create the member function templates.
@@ -133,30 +182,30 @@ void InteropType::Init( const TypeLib* typeLib )
 		// We want to pass in methodInfo as external data so we need to do the
 		// function template definition ourselves. Nan::SetPrototypeMethod doesn't
 		// support the data parameter.
-		v8::Local< v8::Value > methodLocal = Nan::New< v8::External >( methodInfo.release() );
+		MethodInfo* method = methodInfo.release();
+		v8::Local< v8::Value > methodLocal = Nan::New< v8::External >( method );
 		v8::Local< v8::FunctionTemplate > funcTemplate = Nan::New< v8::FunctionTemplate >(
 				Invoke, methodLocal, Nan::New< v8::Signature >( constructorTemplate ) );
 		v8::Local< v8::FunctionTemplate > asyncFuncTemplate = Nan::New< v8::FunctionTemplate >(
 				InvokeAsync, methodLocal, Nan::New< v8::Signature >( asyncConstructorTemplate ) );
 
 		// Figure out whether this is a property getter/setter.
-		std::string name = ToUTF8( bstrFuncName );
+		// The same function template serves as the accessor.
 		if( invkind == INVOKE_PROPERTYGET ) {
 
 			// Getter
-			funcTemplate->Set( Nan::New( "getter" ).ToLocalChecked(), Nan::New( name.c_str() ).ToLocalChecked() );
-			asyncFuncTemplate->Set( Nan::New( "getter" ).ToLocalChecked(), Nan::New( name.c_str() ).ToLocalChecked() );
+			accessors[ name ].getter = funcTemplate;
 			name = "get_" + name;
 
 		} else if( invkind == INVOKE_PROPERTYPUT ) {
 
 			// Setter
-			funcTemplate->Set( Nan::New( "setter" ).ToLocalChecked(), Nan::New( name.c_str() ).ToLocalChecked() );
-			asyncFuncTemplate->Set( Nan::New( "setter" ).ToLocalChecked(), Nan::New( name.c_str() ).ToLocalChecked() );
+			accessors[ name ].setter = funcTemplate;
 			name = "put_" + name;
 		}
 
 		// Name the function.
+		methods[ name ] = method;
 		v8::Local< v8::String > funcName = Nan::New( name.c_str() ).ToLocalChecked();
 		funcTemplate->SetClassName( funcName );
 		asyncFuncTemplate->SetClassName( funcName );
@@ -166,16 +215,66 @@ void InteropType::Init( const TypeLib* typeLib )
 		asyncConstructorTemplate->PrototypeTemplate()->Set( funcName, asyncFuncTemplate );
 	}
 
+	// Map the get_/put_ functions to JavaScript properties on the sync prototype.
+	for( auto&& accessor : accessors )
+	{
+		constructorTemplate->PrototypeTemplate()->SetAccessorProperty(
+				Nan::New( accessor.first.c_str() ).ToLocalChecked(),
+				accessor.second.getter,
+				accessor.second.setter,
+				v8::DontEnum );
+	}
+
+	// Collections with _NewEnum can be iterated.
+	if( newEnumMethod )
+		EnumIterator::Install( this, constructorTemplate, asyncConstructorTemplate );
+
 	// Store the constructors.
 	constructor.Reset( constructorTemplate->GetFunction() );
 	asyncConstructor.Reset( asyncConstructorTemplate->GetFunction() );
 }
 
+/**
+ * Finds the function by its JavaScript name. Property names resolve to their getter.
+ */
+MethodInfo* InteropType::FindMethod( const std::string& name )
+{
+	EnsureInit();
+
+	auto it = methods.find( name );
+	if( it == methods.end() )
+		it = methods.find( "get_" + name );
+	if( it != methods.end() )
+		return it->second;
+
+	return baseType != nullptr ? baseType->FindMethod( name ) : nullptr;
+}
+
+/**
+ * Returns the type with the _NewEnum member. Coclasses have it on their default interface.
+ */
+InteropType* InteropType::FindCollectionType()
+{
+	EnsureInit();
+
+	if( newEnumMethod )
+		return this;
+
+	return baseType != nullptr ? baseType->FindCollectionType() : nullptr;
+}
+
 /**
  * Destructor
  */
 InteropType::~InteropType()
 {
+	// The types are destroyed with their environment.
+	name.Reset();
+	constructorTemplate.Reset();
+	asyncConstructorTemplate.Reset();
+	constructor.Reset();
+	asyncConstructor.Reset();
+
 	if( typeattr )
 	{
 		typeInfo->ReleaseTypeAttr( typeattr );
@@ -211,11 +310,16 @@ NAN_METHOD( InteropType::New )
 	// New can be either called with the external pointer when wrapping existing
 	// instances or with no parameters when creating instances.
 	CComPtr< IDispatch > ptr;
+	IUnknown* identity = nullptr;
 	if( info.Length() > 0 && info[ 0 ]->IsExternal() )
 	{
 		// External pointer found. Wrap that one.
 		v8::Local< v8::External > externalPtrToWrap = v8::Local< v8::External >::Cast( info[ 0 ] );
 		ptr = reinterpret_cast< IDispatch* >( externalPtrToWrap->Value() );
+
+		// The COM identity may have been resolved already.
+		if( info.Length() > 1 && info[ 1 ]->IsExternal() )
+			identity = reinterpret_cast< IUnknown* >( v8::Local< v8::External >::Cast( info[ 1 ] )->Value() );
 	}
 	else
 	{
@@ -232,19 +336,9 @@ NAN_METHOD( InteropType::New )
 
 	// Wrap the pointer.
 	InteropInstance* obj = new InteropInstance( ptr );
+	obj->type = interopType;
 	obj->Wrap( info.This() );
-
-	// Create the read-only hidden async member.
-	v8::Local< v8::Function > asyncCtorLocal = Nan::New( interopType->asyncConstructor );
-	v8::Local< v8::Value > argv[ 1 ] = { Nan::New< v8::External >( ptr.p ) };
-	info.This()->DefineOwnProperty(
-		Nan::GetCurrentContext(),
-		Nan::New( "Async" ).ToLocalChecked(),
-		asyncCtorLocal->NewInstance( 1, argv ),
-		static_cast< v8::PropertyAttribute >(
-				v8::PropertyAttribute::DontDelete |
-				v8::PropertyAttribute::DontEnum |
-				v8::PropertyAttribute::ReadOnly ) );
+	obj->Track( identity );
 
 	info.GetReturnValue().Set( info.This() );
 }
@@ -253,27 +347,44 @@ NAN_METHOD( InteropType::New )
  * Creates the async JavaScript interface for the object.
  */
 NAN_METHOD( InteropType::NewAsync )
+{
+	// Async interfaces can only be created for an existing object.
+	if( info.Length() < 2 || !info[ 0 ]->IsExternal() || !info[ 1 ]->IsObject() )
+		return Nan::ThrowTypeError( "Async interfaces are available behind .Async member on objects." );
+
+	// Share the wrapper of the object instead of wrapping the pointer again.
+	// The object reference keeps the wrapper alive as long as the facade.
+	v8::Local< v8::External > externalInstance = v8::Local< v8::External >::Cast( info[ 0 ] );
+	info.This()->SetAlignedPointerInInternalField( 0, externalInstance->Value() );
+	info.This()->SetInternalField( 1, info[ 1 ] );
+	info.GetReturnValue().Set( info.This() );
+}
+
+/**
+ * Returns the async facade of the object creating it on first access.
+ */
+NAN_METHOD( InteropType::GetAsync )
 {
 	// Unwrap the method data.
 	v8::Local< v8::External > external = v8::Local< v8::External >::Cast( info.Data() );
 	InteropType* interopType = reinterpret_cast< InteropType* >( external->Value() );
+	InteropInstance* obj = InteropInstance::Unwrap< InteropInstance >( info.This() );
 
-	// Async interfaces can only be created for an existing object.
-	CComPtr< IDispatch > ptr;
-	if( info.Length() > 0 && info[ 0 ]->IsExternal() )
-	{
-		v8::Local< v8::External > externalPtrToWrap = v8::Local< v8::External >::Cast( info[ 0 ] );
-		ptr = reinterpret_cast< IDispatch* >( externalPtrToWrap->Value() );
-	}
-	else
-	{
-		return Nan::ThrowTypeError( "Async interfaces are available behind .Async member on objects." );
-	}
+	v8::Local< v8::Value > argv[ 2 ] = { Nan::New< v8::External >( obj ), info.This() };
+	v8::Local< v8::Object > facade = Nan::NewInstance(
+			Nan::New( interopType->asyncConstructor ), 2, argv ).ToLocalChecked();
 
-	// Wrap the pointer.
-	InteropInstance* obj = new InteropInstance( ptr );
-	obj->Wrap( info.This() );
-	info.GetReturnValue().Set( info.This() );
+	// Cache the facade as a read-only own property shadowing this accessor.
+	info.This()->DefineOwnProperty(
+		Nan::GetCurrentContext(),
+		Nan::New( "Async" ).ToLocalChecked(),
+		facade,
+		static_cast< v8::PropertyAttribute >(
+				v8::PropertyAttribute::DontDelete |
+				v8::PropertyAttribute::DontEnum |
+				v8::PropertyAttribute::ReadOnly ) );
+
+	info.GetReturnValue().Set( facade );
 }
 
 /**
@@ -317,60 +428,18 @@ void InteropType::InvokeSyncOrAsync( bool isAsync, Nan::NAN_METHOD_ARGS_TYPE inf
 	v8::Local< v8::External > externalData = v8::Local< v8::External >::Cast( info.Data() );
 	MethodInfo* methodInfo = reinterpret_cast< MethodInfo* >( externalData->Value() );
 
-	// Gather the parameters.
-	std::unique_ptr< std::vector< CComVariant > > pargs( new std::vector< CComVariant >() );
-	pargs->resize( methodInfo->funcdesc->cParams );
-	for( int i = 0; i < methodInfo->funcdesc->cParams; ++i )
-	{
-		try
-		{
-			ELEMDESC& elem = methodInfo->funcdesc->lprgelemdescParam[ i ];
-
-			// Parameters are stored in reverse order.
-			unsigned int rgvarg_i = methodInfo->funcdesc->cParams - i - 1;
-
-			// Check whether there exists a JS parameter for the current COM parameter.
-			if( info.Length() <= i )
-			{
-				// No parameter exists. Try to use a default.
-				if( elem.paramdesc.pparamdescex )
-				{
-					// Default value.
-					( *pargs )[ rgvarg_i ] = elem.paramdesc.pparamdescex->varDefaultValue;
-				}
-				else if( elem.paramdesc.wParamFlags & PARAMFLAG_FOPT )
-				{
-					// Optional value. Leave empty.
-					( *pargs )[ rgvarg_i ].ChangeType( elem.tdesc.vt );
-				}
-				else
-				{
-					// Try to init from as the last resort.
-					InitVariant( methodInfo->typeInfo, elem.tdesc, Nan::Undefined(), OUT ( *pargs )[ rgvarg_i ] );
-				}
-			}
-			else
-			{
-				// We have JS parameter. Convert it.
-				InitVariant( methodInfo->typeInfo, elem.tdesc, info[ i ], OUT ( *pargs )[ rgvarg_i ] );
-			}
-
-		}
-		catch( JsException ex )
-		{
-			JsException::ThrowParameter( i, ex );
-		}
-
-	}  // end for
+	InteropInstance* obj = InteropInstance::Unwrap< InteropInstance >( info.This() );
 
 	// Check for sync vs async call.
-	InteropInstance* obj = InteropInstance::Unwrap< InteropInstance >( info.This() );
 	if( !isAsync )
 	{
-		// Synchronous call.
-		VARIANT result;
-		EXCEPINFO exception;
-		HRESULT hr = methodInfo->Invoke( obj->instance, *pargs, OUT &result, OUT &exception );
+		// Synchronous call. The arguments of the usual arities stay on the stack.
+		ArgBuffer args( methodInfo->plan->params.size() );
+		methodInfo->plan->InitArgs( info, OUT args.data() );
+
+		ResultVariant result;
+		ExcepInfo exception;
+		HRESULT hr = methodInfo->Invoke( obj->instance, args.data(), args.size(), OUT &result, OUT &exception );
 
 		info.GetReturnValue().Set( methodInfo->GetInvokeResult( hr, result, exception ) );
 	}
@@ -378,14 +447,19 @@ void InteropType::InvokeSyncOrAsync( bool isAsync, Nan::NAN_METHOD_ARGS_TYPE inf
 	{
 		// Asynchronous call.
 
-		// Create the baton passed to the other thread.
-		std::unique_ptr< InvokeBaton > baton( new InvokeBaton() );
-		baton->request.data = baton.get();
+		// Take a recycled baton for passing the call to the other thread.
+		BatonPool::Ptr baton( BatonPool::Acquire() );
+
+		// Gather the parameters straight into the baton.
+		// Large collection arguments are populated in the worker thread.
+		{
+			CollectionInfo::DeferScope defer( &baton->fills );
+			methodInfo->plan->InitArgs( info, OUT baton->args );
+		}
 
 		// Set the data.
 		baton->target.Reset( info.This() );
 		baton->callee.Reset( info.Callee() );
-		baton->pargs.swap( pargs );
 		baton->methodInfo = methodInfo;
 		baton->obj = obj;
 
@@ -393,13 +467,19 @@ void InteropType::InvokeSyncOrAsync( bool isAsync, Nan::NAN_METHOD_ARGS_TYPE inf
 		auto resolver = v8::Promise::Resolver::New( info.GetIsolate() );
 		baton->resolver.Reset( resolver );
 
-		// Queue the invocation and release the baton.
-		// libuv should take care of releasing it now.
-		uv_queue_work( uv_default_loop(), &baton.get()->request, DoInvokeAsync, DoInvokeAfter );
-		baton.release();
-
 		// Return the promise.
 		info.GetReturnValue().Set( resolver->GetPromise() );
+
+		// Calls made within cominterop.batch() are executed together.
+		InvokeBatch* batch = InvokeBatch::Current();
+		if( batch != nullptr )
+		{
+			batch->Add( baton.release() );
+			return;
+		}
+
+		// Queue the invocation. The pool owns the baton until the call completes.
+		InvokePool::Submit( baton.release(), obj->IsAgile() );
 	}
 }
 
@@ -409,45 +489,3 @@ NAN_INDEX_GETTER( InteropType::GetIndex )
 	v8::Local< v8::Value > localIndex = Nan::New( index + 1 );
 	info.GetReturnValue().Set( getter->Call( info.This(), 1, &localIndex ) );
 }
-
-namespace
-{
-
-	/**
-	 * Asynchronous invoke callback.
-	 *
-	 * Executed in a different thread. No access to v8 internals.
-	 */
-	void DoInvokeAsync( uv_work_t* req )
-	{
-		InvokeBaton* baton = static_cast< InvokeBaton* >( req->data );
-		baton->hr = baton->methodInfo->Invoke( baton->obj->instance, *( baton->pargs ), OUT &baton->result, OUT &baton->exception );
-	}
-
-	/**
-	 * Asynchronou result callback.
-	 *
-	 * Executed back in v8-thread.
-	 */
-	void DoInvokeAfter( uv_work_t* req, int status )
-	{
-		v8::HandleScope scope( v8::Isolate::GetCurrent() );
-
-		// Fetch the Promise from the baton.
-		InvokeBaton* baton = static_cast< InvokeBaton* >( req->data );
-		auto resolver = Nan::New( baton->resolver );
-
-		try
-		{
-			// Resolve the promise.
-			// GetInvokeResult will throw exception if the invoke failed.
-			resolver->Resolve( baton->methodInfo->GetInvokeResult( baton->hr, baton->result, baton->exception ) );
-		}
-		catch( JsException ex )
-		{
-			// Reject the promise on exception.
-			resolver->Reject( ex.GetError() );
-		}
-	}
-
-}
@@ -1,27 +1,42 @@
 #pragma once
 
 #include "utils.h"
+#include "TypeLibCore.h"
 #include <nan.h>
 
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 class TypeLib;
 class InteropInstance;
 class MethodInfo;
 class CollectionInfo;
+struct SnapshotType;
 
 class InteropType
 {
 public:
-	InteropType( const CComPtr< ITypeInfo >& typeInfo, TYPEATTR* typeattr, const TypeLib* typeLib );
+	InteropType( const CComPtr< ITypeInfo >& typeInfo, TYPEATTR* typeattr, const TypeLibSource& source );
 	~InteropType();
 
-	void Init( const TypeLib* typeLib );
+	void Init();
+	void EnsureInit() { Init(); }
+	bool IsInit() const { return hasInit; }
+	TYPEKIND TypeKind() const { return typeattr->typekind; }
+
+	v8::Local< v8::Function > GetConstructor() {
+		EnsureInit();
+		return Nan::New( constructor );
+	}
 
 	CComPtr< IDispatch > CreateInstance();
+	MethodInfo* FindMethod( const std::string& name );
+	InteropType* FindCollectionType();
 
 	static NAN_METHOD( New );
 	static NAN_METHOD( NewAsync );
+	static NAN_METHOD( GetAsync );
 	static NAN_METHOD( Invoke );
 	static NAN_METHOD( InvokeAsync );
 	static NAN_INDEX_GETTER( GetIndex );
@@ -43,9 +58,11 @@ public:
 		return nullptr;
 	}
 
-	v8::Local< v8::String > name;
-	v8::Local< v8::FunctionTemplate > constructorTemplate;
-	v8::Local< v8::FunctionTemplate > asyncConstructorTemplate;
+	// Templates are created in the constructor but the type might be
+	// initialized later in a different HandleScope.
+	Nan::Persistent< v8::String > name;
+	Nan::Persistent< v8::FunctionTemplate > constructorTemplate;
+	Nan::Persistent< v8::FunctionTemplate > asyncConstructorTemplate;
 
 	Nan::Persistent< v8::Function > constructor;
 	Nan::Persistent< v8::Function > asyncConstructor;
@@ -53,12 +70,25 @@ public:
 	CComPtr< ITypeInfo > typeInfo;
 	std::unique_ptr< CollectionInfo > collectionInfo;
 
+	// _NewEnum of enumerable collections and the item type from the Item method.
+	std::unique_ptr< MethodInfo > newEnumMethod;
+	InteropType* itemType;
+
+	// Default interface of a coclass.
+	InteropType* baseType;
+
+	// Precompiled metadata of the type if the library was loaded with a snapshot.
+	const SnapshotType* snapshotType;
+
 private:
-	const TypeLib* typeLib;
+	TypeLibSource source;
 
 	TYPEATTR* typeattr;
 	std::vector< FUNCDESC* > funcDescs;
 
+	// Member functions by their JavaScript names. Owned by the function templates.
+	std::unordered_map< std::string, MethodInfo* > methods;
+
 	bool hasInit;
 	CComPtr< ITypeInfo > itemInfo;
 	std::vector< InteropType* > subclasses;
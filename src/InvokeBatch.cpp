@@ -0,0 +1,111 @@
+#include "InvokeBatch.h"
+
+#include "InteropInstance.h"
+#include "InvokeBaton.h"
+#include "InvokePool.h"
+
+thread_local InvokeBatch* InvokeBatch::current = nullptr;
+
+InvokeBatch::InvokeBatch()
+{
+}
+
+InvokeBatch::~InvokeBatch()
+{
+}
+
+void InvokeBatch::Add( InvokeBaton* baton )
+{
+	batons.push_back( BatonPool::Ptr( baton ) );
+}
+
+/**
+ * Runs the callback and executes the async calls it made as one batch.
+ *
+ * The returned promise resolves to the per-call outcomes in call order in the
+ * same { status, value/reason } form Promise.allSettled uses. The promises
+ * returned by the individual calls are settled as well.
+ */
+NAN_METHOD( InvokeBatch::Run )
+{
+	if( info.Length() < 1 || !info[ 0 ]->IsFunction() ) {
+		Nan::ThrowTypeError( "Missing batch callback" );
+		return;
+	}
+
+	std::unique_ptr< InvokeBatch > batch( new InvokeBatch() );
+	auto resolver = v8::Promise::Resolver::New( info.GetIsolate() );
+	batch->resolver.Reset( resolver );
+	info.GetReturnValue().Set( resolver->GetPromise() );
+
+	// Collect the calls. Batches may nest so restore the outer one afterwards.
+	InvokeBatch* outer = current;
+	current = batch.get();
+
+	Nan::TryCatch tryCatch;
+	Nan::Call( info[ 0 ].As< v8::Function >(), Nan::GetCurrentContext()->Global(), 0, nullptr );
+
+	current = outer;
+
+	// The calls made before a throw are still executed so their promises settle.
+	if( batch->batons.empty() )
+	{
+		resolver->Resolve( Nan::New< v8::Array >() );
+	}
+	else
+	{
+		// One object of the main thread's apartment keeps the batch there.
+		bool agile = true;
+		for( auto&& baton : batch->batons )
+			agile = agile && baton->obj->IsAgile();
+
+		InvokePool::Submit( batch.release(), agile );
+	}
+
+	if( tryCatch.HasCaught() )
+		tryCatch.ReThrow();
+}
+
+/**
+ * Executes the calls. Executed in the worker thread.
+ */
+void InvokeBatch::Execute()
+{
+	for( auto&& baton : batons )
+		baton->Execute();
+}
+
+/**
+ * Settles the calls and the batch. Executed back in v8-thread.
+ */
+void InvokeBatch::Complete()
+{
+
+	v8::Local< v8::String > statusKey = Nan::New( "status" ).ToLocalChecked();
+	v8::Local< v8::String > valueKey = Nan::New( "value" ).ToLocalChecked();
+	v8::Local< v8::String > reasonKey = Nan::New( "reason" ).ToLocalChecked();
+	v8::Local< v8::String > fulfilled = Nan::New( "fulfilled" ).ToLocalChecked();
+	v8::Local< v8::String > rejected = Nan::New( "rejected" ).ToLocalChecked();
+
+	v8::Local< v8::Array > results = Nan::New< v8::Array >( static_cast< int >( batons.size() ) );
+	for( size_t i = 0; i < batons.size(); ++i )
+	{
+		v8::Local< v8::Value > value;
+		bool success = batons[ i ]->Settle( OUT value );
+
+		v8::Local< v8::Object > outcome = Nan::New< v8::Object >();
+		Nan::Set( outcome, statusKey, success ? fulfilled : rejected );
+		Nan::Set( outcome, success ? valueKey : reasonKey, value );
+		Nan::Set( results, static_cast< uint32_t >( i ), outcome );
+	}
+
+	Nan::New( resolver )->Resolve( results );
+}
+
+void InvokeBatch::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > run = Nan::New< v8::FunctionTemplate >( Run );
+	exports->Set( Nan::New( "batch" ).ToLocalChecked(), run->GetFunction() );
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "utils.h"
+#include "BatonPool.h"
+#include "WorkerPool.h"
+#include <nan.h>
+
+#include <memory>
+#include <vector>
+
+struct InvokeBaton;
+
+/**
+ * Group of asynchronous invocations executed in one worker thread trip.
+ *
+ * The async calls made while the batch callback runs are collected into the
+ * batch instead of being queued one by one. The calls are executed back to
+ * back in order and settled in a single callback on the v8 thread.
+ */
+class InvokeBatch : public WorkerPool::Task
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+	static NAN_METHOD( Run );
+
+	/**
+	 * Returns the batch collecting the async calls or null outside batch().
+	 */
+	static InvokeBatch* Current() { return current; }
+
+	/**
+	 * Adds the call to the batch. Takes ownership of the pooled baton.
+	 */
+	void Add( InvokeBaton* baton );
+
+	void Execute() override;
+	void Complete() override;
+
+	~InvokeBatch();
+
+private:
+	InvokeBatch();
+
+	std::vector< BatonPool::Ptr > batons;
+	Nan::Persistent< v8::Promise::Resolver > resolver;
+
+	// Batch being collected by the environment on this thread.
+	static thread_local InvokeBatch* current;
+};
@@ -0,0 +1,67 @@
+#include "InvokeBaton.h"
+
+#include "InteropInstance.h"
+#include "MethodInfo.h"
+
+void InvokeBaton::Execute()
+{
+	// A failed Add fails the call.
+	for( auto&& fill : fills )
+	{
+		hr = fill->info->AddItems( fill->collection, fill->items, OUT &exception );
+		if( FAILED( hr ) )
+			return;
+	}
+
+	hr = methodInfo->Invoke( obj->instance, args, OUT &result, OUT &exception );
+	if( SUCCEEDED( hr ) )
+		prepared.Prepare( methodInfo->plan->result, OUT result );
+
+	// Results the worker took out of the VARIANT aren't outstanding.
+	result.Hold();
+}
+
+void InvokeBaton::Complete()
+{
+	v8::Local< v8::Value > value;
+	Settle( OUT value );
+}
+
+bool InvokeBaton::Settle( OUT v8::Local< v8::Value >& value )
+{
+	auto promiseResolver = Nan::New( resolver );
+
+	try
+	{
+		// GetInvokeResult will throw exception if the invoke failed.
+		// Only successful results are prepared.
+		value = prepared.IsPrepared() ? prepared.ToValue() : methodInfo->GetInvokeResult( hr, result, exception );
+		promiseResolver->Resolve( value );
+		return true;
+	}
+	catch( JsException ex )
+	{
+		// Reject the promise on exception.
+		value = ex.GetError();
+		promiseResolver->Reject( value );
+		return false;
+	}
+}
+
+void InvokeBaton::Reset()
+{
+	target.Reset();
+	callee.Reset();
+	resolver.Reset();
+
+	args.clear();
+	fills.clear();
+	obj = nullptr;
+	methodInfo = nullptr;
+
+	result.Reset();
+
+	exception.Clear();
+	prepared.Clear();
+	hr = S_OK;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "utils.h"
+#include "ArgBuffer.h"
+#include "BatonPool.h"
+#include "CollectionInfo.h"
+#include "PreparedResult.h"
+#include "WorkerPool.h"
+#include <nan.h>
+
+#include <memory>
+#include <vector>
+
+class InteropInstance;
+class MethodInfo;
+
+/**
+ * State of an asynchronous invocation passed to the worker thread.
+ *
+ * The batons are recycled through BatonPool.
+ */
+struct InvokeBaton : public WorkerPool::Task
+{
+	InvokeBaton() : obj( nullptr ), methodInfo( nullptr ), hr( S_OK )
+	{
+		args.reserve( ArgBuffer::InlineCount );
+	}
+
+	// Make sure the target and callee don't go out of scope.
+	Nan::Persistent< v8::Object > target;
+	Nan::Persistent< v8::Function > callee;
+
+	// The capacity is kept when the baton is recycled.
+	std::vector< CComVariant > args;
+
+	// Collection arguments to populate before the call.
+	CollectionInfo::FillList fills;
+
+	// Method info reference is held by the callee.
+	// The pointer should stay alive as long as the callee stays alive.
+	InteropInstance* obj;
+	MethodInfo* methodInfo;
+
+	// Cleared when the baton is released.
+	ResultVariant result;
+	ExcepInfo exception;
+	HRESULT hr;
+
+	// Result converted in the worker thread.
+	PreparedResult prepared;
+
+	Nan::Persistent< v8::Promise::Resolver > resolver;
+
+	/**
+	 * Performs the invocation. Executed in the worker thread.
+	 */
+	void Execute() override;
+
+	/**
+	 * Settles the promise of a single call.
+	 */
+	void Complete() override;
+
+	/**
+	 * Resolves or rejects the promise. Executed in the v8 thread.
+	 *
+	 * Returns false if the call failed. The value is the result or the error.
+	 */
+	bool Settle( OUT v8::Local< v8::Value >& value );
+
+	/**
+	 * Returns the baton to the pool.
+	 */
+	void Release() override { BatonPool::Release( this ); }
+
+	/**
+	 * Drops the call state so the baton can be reused.
+	 */
+	void Reset();
+};
@@ -0,0 +1,162 @@
+#include "InvokePipeline.h"
+
+#include "InteropInstance.h"
+#include "InteropType.h"
+#include "InvokePool.h"
+#include "MethodInfo.h"
+
+#include <memory>
+#include <sstream>
+
+/**
+ * Queues the call chain: pipeline( obj, [ 'Vault', [ 'Item', 1 ], 'Name' ] ).
+ *
+ * Steps are member names with optional arguments. Property names resolve to
+ * their getters. Returns a promise of the last result.
+ */
+NAN_METHOD( InvokePipeline::Run )
+{
+	if( info.Length() < 2 || !info[ 0 ]->IsObject() || !info[ 1 ]->IsArray() ) {
+		Nan::ThrowTypeError( "Usage: pipeline( object, steps )" );
+		return;
+	}
+
+	InteropInstance* obj = InteropInstance::FromValue( info[ 0 ] );
+	if( obj == nullptr ) {
+		Nan::ThrowTypeError( "The pipeline target must be a COM object." );
+		return;
+	}
+
+	InteropType* type = obj->type;
+
+	std::unique_ptr< InvokePipeline > pipeline( new InvokePipeline() );
+	v8::Local< v8::Array > stepList = info[ 1 ].As< v8::Array >();
+	pipeline->steps.resize( stepList->Length() );
+	if( pipeline->steps.empty() ) {
+		Nan::ThrowTypeError( "The pipeline has no steps." );
+		return;
+	}
+
+	try
+	{
+		// Resolve the steps against the static types of the previous results.
+		for( uint32_t i = 0; i < stepList->Length(); i++ )
+		{
+			Step& step = pipeline->steps[ i ];
+
+			v8::Local< v8::Value > stepValue = stepList->Get( i );
+			v8::Local< v8::Array > stepArgs = Nan::New< v8::Array >();
+			if( stepValue->IsArray() )
+			{
+				// [ name, args... ]
+				v8::Local< v8::Array > stepArray = stepValue.As< v8::Array >();
+				stepValue = stepArray->Get( 0 );
+				for( uint32_t a = 1; a < stepArray->Length(); a++ )
+					Nan::Set( stepArgs, a - 1, stepArray->Get( a ) );
+			}
+
+			step.name = *v8::String::Utf8Value( stepValue );
+			step.methodInfo = type != nullptr ? type->FindMethod( step.name ) : nullptr;
+			if( step.methodInfo == nullptr )
+			{
+				std::stringstream ss;
+				ss << "Pipeline step " << ( i + 1 ) << ": '" << step.name << "' not found";
+				if( type == nullptr )
+					ss << " on an object of unknown type";
+				ss << ".";
+				JsException::Throw( ss.str().c_str() );
+			}
+
+			step.methodInfo->plan->InitArgs( ArrayArgs( stepArgs ), OUT step.args );
+			type = step.methodInfo->plan->result.refType;
+		}
+	}
+	catch( JsException ex )
+	{
+		Nan::ThrowError( ex.GetError() );
+		return;
+	}
+
+	pipeline->target = obj->instance;
+	pipeline->targetHandle.Reset( info[ 0 ].As< v8::Object >() );
+
+	auto resolver = v8::Promise::Resolver::New( info.GetIsolate() );
+	pipeline->resolver.Reset( resolver );
+	info.GetReturnValue().Set( resolver->GetPromise() );
+
+	InvokePool::Submit( pipeline.release(), obj->IsAgile() );
+}
+
+/**
+ * Runs the steps. Executed in the worker thread.
+ */
+void InvokePipeline::Execute()
+{
+	CComPtr< IDispatch > current = target;
+	for( size_t i = 0; i < steps.size(); i++ )
+	{
+		result.Clear();
+		hr = steps[ i ].methodInfo->Invoke( current, steps[ i ].args, OUT &result, OUT &exception );
+		if( FAILED( hr ) )
+		{
+			failedStep = i;
+			break;
+		}
+
+		if( i + 1 == steps.size() )
+		{
+			prepared.Prepare( steps[ i ].methodInfo->plan->result, OUT result );
+			break;
+		}
+
+		// The intermediate objects stay in the worker.
+		if( result.vt != VT_DISPATCH || result.pdispVal == nullptr )
+		{
+			noObject = true;
+			failedStep = i;
+			break;
+		}
+
+		current = result.pdispVal;
+	}
+
+	// The result waits for the v8 thread.
+	result.Hold();
+}
+
+/**
+ * Settles the promise with the last result. Executed in the v8 thread.
+ */
+void InvokePipeline::Complete()
+{
+	auto promiseResolver = Nan::New( resolver );
+	resolver.Reset();
+	targetHandle.Reset();
+
+	if( noObject )
+	{
+		std::stringstream ss;
+		ss << "Pipeline step " << ( failedStep + 1 ) << ": '" << steps[ failedStep ].name << "' returned no object.";
+		promiseResolver->Reject( Nan::TypeError( ss.str().c_str() ) );
+		return;
+	}
+
+	try
+	{
+		// The failing step reports its own error.
+		const Step& step = FAILED( hr ) ? steps[ failedStep ] : steps.back();
+		promiseResolver->Resolve( prepared.IsPrepared() ? prepared.ToValue() : step.methodInfo->GetInvokeResult( hr, result, exception ) );
+	}
+	catch( JsException ex )
+	{
+		promiseResolver->Reject( ex.GetError() );
+	}
+}
+
+void InvokePipeline::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > run = Nan::New< v8::FunctionTemplate >( Run );
+	exports->Set( Nan::New( "pipeline" ).ToLocalChecked(), run->GetFunction() );
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "utils.h"
+#include "PreparedResult.h"
+#include "WorkerPool.h"
+#include <nan.h>
+
+#include <string>
+#include <vector>
+
+class MethodInfo;
+
+/**
+ * Chain of calls executed in one worker thread trip.
+ *
+ * Each step is called on the object returned by the previous one. The
+ * steps are resolved against the static result types before the chain is
+ * queued so the intermediate objects never need JavaScript wrappers. Only
+ * the result of the last step is marshaled back.
+ */
+class InvokePipeline : public WorkerPool::Task
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+	static NAN_METHOD( Run );
+
+	void Execute() override;
+	void Complete() override;
+
+private:
+	struct Step
+	{
+		std::string name;
+		MethodInfo* methodInfo;
+		std::vector< CComVariant > args;
+	};
+
+	InvokePipeline() : hr( S_OK ), failedStep( 0 ), noObject( false ) {}
+
+	// Keeps the target wrapper alive for the duration of the chain.
+	Nan::Persistent< v8::Object > targetHandle;
+	CComPtr< IDispatch > target;
+	std::vector< Step > steps;
+
+	ResultVariant result;
+	PreparedResult prepared;
+	ExcepInfo exception;
+	HRESULT hr;
+	size_t failedStep;
+
+	// Set when an intermediate step returned no object for the next one.
+	// Failures of the calls themselves stay in hr unchanged.
+	bool noObject;
+
+	Nan::Persistent< v8::Promise::Resolver > resolver;
+};
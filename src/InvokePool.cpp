@@ -0,0 +1,200 @@
+#include "InvokePool.h"
+
+#include "AddonState.h"
+
+InvokePool::State& InvokePool::Get()
+{
+	return AddonState::Get< State >();
+}
+
+WorkerPool& InvokePool::GetPool()
+{
+	State& state = Get();
+	if( state.pool )
+		return *state.pool;
+
+	// The handle only keeps the loop alive while there are calls in flight.
+	uv_async_t* completeAsync = new uv_async_t();
+	uv_async_init( Nan::GetCurrentEventLoop(), completeAsync, OnComplete );
+	uv_unref( reinterpret_cast< uv_handle_t* >( completeAsync ) );
+	state.completeAsync = completeAsync;
+
+	state.asyncResource.reset( new Nan::AsyncResource( "cominterop:InvokePool" ) );
+	state.drain.Reset( Nan::New< v8::FunctionTemplate >( Drain )->GetFunction() );
+
+	state.pool.reset( new WorkerPool(
+			state.threadCount,
+			[]() { CoInitializeEx( nullptr, COINIT_MULTITHREADED ); },
+			[]() { CoUninitialize(); },
+			[ completeAsync ]() { uv_async_send( completeAsync ); } ) );
+
+	// The unfinished tasks refer to the states of the other modules.
+	AddonState::AtExit( Stop );
+
+	return *state.pool;
+}
+
+/**
+ * Stops the pool when the environment exits.
+ *
+ * The queued tasks are executed but their promises are never settled.
+ */
+void InvokePool::Stop()
+{
+	State& state = Get();
+	state.pool.reset();
+	state.outstanding = 0;
+
+	uv_close( reinterpret_cast< uv_handle_t* >( state.completeAsync ), []( uv_handle_t* handle ) {
+		delete reinterpret_cast< uv_async_t* >( handle );
+	} );
+	state.completeAsync = nullptr;
+
+	state.asyncResource.reset();
+	state.drain.Reset();
+}
+
+void InvokePool::Submit( WorkerPool::Task* task, bool agile )
+{
+	WorkerPool& workers = GetPool();
+
+	State& state = Get();
+	if( state.outstanding++ == 0 )
+		uv_ref( reinterpret_cast< uv_handle_t* >( state.completeAsync ) );
+
+	if( agile )
+	{
+		workers.Submit( task );
+		return;
+	}
+
+	// The object can only be called from its apartment.
+	state.inlined++;
+	workers.ExecuteInline( task );
+}
+
+/**
+ * Completes the finished calls. Executed in the v8 thread.
+ *
+ * The workers only signal the first call finished after a drain and
+ * uv_async_send coalesces the signals, so one callback completes a batch.
+ */
+void InvokePool::OnComplete( uv_async_t* handle )
+{
+	Nan::HandleScope scope;
+
+	State& state = Get();
+	state.drains++;
+
+	// Node runs the reactions of all the settled promises and the nextTick
+	// queue once the callback returns. Exceptions go to uncaughtException.
+	state.asyncResource->runInAsyncScope(
+			Nan::GetCurrentContext()->Global(), Nan::New( state.drain ), 0, nullptr );
+
+	// Out of budget. Let the loop poll for I/O and continue on the next iteration.
+	if( state.pool->HasCompleted() )
+		uv_async_send( handle );
+
+	if( state.outstanding == 0 )
+		uv_unref( reinterpret_cast< uv_handle_t* >( handle ) );
+}
+
+/**
+ * Settles the finished calls up to the completion budget.
+ */
+NAN_METHOD( InvokePool::Drain )
+{
+	State& state = Get();
+	state.outstanding -= state.pool->RunCompleted( state.completionBudget );
+}
+
+/**
+ * Sets the pool options: { threads, completionBudget }.
+ *
+ * The thread count must be set before the first async call. The completion
+ * budget is the time in milliseconds a single drain may spend settling
+ * promises; 0 removes the limit.
+ */
+NAN_METHOD( InvokePool::Configure )
+{
+	if( info.Length() < 1 || !info[ 0 ]->IsObject() ) {
+		Nan::ThrowTypeError( "Missing pool options" );
+		return;
+	}
+
+	v8::Local< v8::Object > options = info[ 0 ].As< v8::Object >();
+	v8::Local< v8::Value > threads = options->Get( Nan::New( "threads" ).ToLocalChecked() );
+	v8::Local< v8::Value > budget = options->Get( Nan::New( "completionBudget" ).ToLocalChecked() );
+
+	State& state = Get();
+	double threadValue = 0;
+	if( !threads->IsUndefined() )
+	{
+		if( state.pool ) {
+			Nan::ThrowError( "The invocation pool has already been started." );
+			return;
+		}
+
+		threadValue = threads->NumberValue();
+		if( !( threadValue >= 1 && threadValue <= 256 ) ) {
+			Nan::ThrowRangeError( "The thread count must be between 1 and 256." );
+			return;
+		}
+	}
+
+	double budgetValue = 0;
+	if( !budget->IsUndefined() )
+	{
+		budgetValue = budget->NumberValue();
+		if( !( budgetValue >= 0 && budgetValue <= 1000 ) ) {
+			Nan::ThrowRangeError( "The completion budget must be between 0 and 1000 milliseconds." );
+			return;
+		}
+	}
+
+	if( !threads->IsUndefined() )
+		state.threadCount = static_cast< size_t >( threadValue );
+
+	if( !budget->IsUndefined() )
+		state.completionBudget = std::chrono::nanoseconds( static_cast< int64_t >( budgetValue * 1e6 ) );
+}
+
+/**
+ * Returns the queue depth and utilization of the pool.
+ */
+NAN_METHOD( InvokePool::GetStats )
+{
+	State& state = Get();
+	v8::Local< v8::Object > stats = Nan::New< v8::Object >();
+	Nan::Set( stats, Nan::New( "started" ).ToLocalChecked(), Nan::New( state.pool != nullptr ) );
+	Nan::Set( stats, Nan::New( "outstanding" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.outstanding ) ) );
+	Nan::Set( stats, Nan::New( "drains" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.drains ) ) );
+	Nan::Set( stats, Nan::New( "inline" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.inlined ) ) );
+
+	if( !state.pool ) {
+		Nan::Set( stats, Nan::New( "threads" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.threadCount ) ) );
+		info.GetReturnValue().Set( stats );
+		return;
+	}
+
+	WorkerPool::Stats poolStats = state.pool->GetStats();
+	Nan::Set( stats, Nan::New( "threads" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( poolStats.threads ) ) );
+	Nan::Set( stats, Nan::New( "queued" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( poolStats.queued ) ) );
+	Nan::Set( stats, Nan::New( "active" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( poolStats.active ) ) );
+	Nan::Set( stats, Nan::New( "submitted" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( poolStats.submitted ) ) );
+	Nan::Set( stats, Nan::New( "completed" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( poolStats.completed ) ) );
+	Nan::Set( stats, Nan::New( "stolen" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( poolStats.stolen ) ) );
+	Nan::Set( stats, Nan::New( "utilization" ).ToLocalChecked(), Nan::New< v8::Number >( poolStats.utilization ) );
+	info.GetReturnValue().Set( stats );
+}
+
+void InvokePool::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > configure = Nan::New< v8::FunctionTemplate >( Configure );
+	exports->Set( Nan::New( "configurePool" ).ToLocalChecked(), configure->GetFunction() );
+
+	v8::Local< v8::FunctionTemplate > stats = Nan::New< v8::FunctionTemplate >( GetStats );
+	exports->Set( Nan::New( "poolStats" ).ToLocalChecked(), stats->GetFunction() );
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "utils.h"
+#include "WorkerPool.h"
+#include <nan.h>
+
+#include <memory>
+
+/**
+ * Dedicated thread pool for the asynchronous COM calls.
+ *
+ * Keeps the calls off the libuv thread pool so they don't compete with the
+ * file system and DNS work. The threads join the multithreaded apartment and
+ * the completions are delivered through the pool's own uv_async_t.
+ *
+ * Only agile objects are called from the threads. Calls on objects that
+ * belong to the apartment of the main thread are executed in the main thread
+ * and settled with the other completions.
+ *
+ * The handler completes all the finished calls in one callback of the pool's
+ * async resource, so node runs the promise reactions and the nextTick queue
+ * once per drain in the async context of the pool. A drain stops when the completion budget
+ * is used up and continues on the next loop iteration, so a burst of
+ * completions doesn't starve the other I/O.
+ *
+ * Each environment has a pool of its own that completes on the event loop
+ * of the environment. The pool is stopped when the environment exits.
+ */
+class InvokePool
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+
+	/**
+	 * Queues the task. The pool is started on first use.
+	 *
+	 * Tasks that call objects that aren't agile are executed right away.
+	 */
+	static void Submit( WorkerPool::Task* task, bool agile );
+
+	static NAN_METHOD( Configure );
+	static NAN_METHOD( GetStats );
+
+private:
+	struct State
+	{
+		State() : completeAsync( nullptr ), threadCount( 4 ), completionBudget( std::chrono::milliseconds( 5 ) ),
+			drains( 0 ), inlined( 0 ), outstanding( 0 ) {}
+
+		std::unique_ptr< WorkerPool > pool;
+
+		// Closed when the pool is stopped. Freed once the loop is done with it.
+		uv_async_t* completeAsync;
+
+		// The drains are callbacks of the resource.
+		std::unique_ptr< Nan::AsyncResource > asyncResource;
+		Nan::Global< v8::Function > drain;
+
+		size_t threadCount;
+		std::chrono::nanoseconds completionBudget;
+		uint64_t drains;
+
+		// Tasks executed in the main thread.
+		uint64_t inlined;
+
+		// Tasks submitted but not completed. The loop is kept alive while there are any.
+		size_t outstanding;
+	};
+
+	static State& Get();
+	static WorkerPool& GetPool();
+	static void Stop();
+	static void OnComplete( uv_async_t* handle );
+	static NAN_METHOD( Drain );
+};
@@ -20,8 +20,18 @@ void JsException::Throw( HRESULT hr )
 	throw JsException( Nan::TypeError( ss.str().c_str() ) );
 }
 
-void JsException::Throw( EXCEPINFO ex )
+void JsException::Throw( EXCEPINFO& ex )
 {
+	// The strings are filled into the caller's EXCEPINFO which owns them.
+	if( ex.pfnDeferredFillIn != nullptr )
+	{
+		ex.pfnDeferredFillIn( &ex );
+		ex.pfnDeferredFillIn = nullptr;
+	}
+
+	if( ex.bstrDescription == nullptr && FAILED( ex.scode ) )
+		Throw( ex.scode );
+
 	std::stringstream ss;
 	ss << ToUTF8( ex.bstrDescription );
 
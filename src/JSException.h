@@ -14,7 +14,7 @@ public:
 	~JsException();
 
 	static void Throw( HRESULT hr );
-	static void Throw( EXCEPINFO hr );
+	static void Throw( EXCEPINFO& ex );
 	static void Throw( const char* msg ) { throw JsException( Nan::TypeError( msg ) ); }
 	static void ThrowParameter( int i, JsException& ex );
 	static void ThrowMismatch( const CComPtr< ITypeInfo >& expected, v8::Local< v8::Value > actual );
@@ -0,0 +1,126 @@
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+	: data( nullptr ), size( 0 ), file( INVALID_HANDLE_VALUE ), mapping( nullptr )
+{
+}
+
+bool MappedFile::Open( const std::string& path )
+{
+	Close();
+
+	// Paths are UTF-8 everywhere else in the addon.
+	int length = MultiByteToWideChar( CP_UTF8, 0, path.c_str(), -1, nullptr, 0 );
+	std::wstring widePath( length, L'\0' );
+	MultiByteToWideChar( CP_UTF8, 0, path.c_str(), -1, &widePath[ 0 ], length );
+
+	file = CreateFileW( widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 )
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( mapping == nullptr )
+	{
+		Close();
+		return false;
+	}
+
+	data = static_cast< const uint8_t* >( MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+	if( data == nullptr )
+	{
+		Close();
+		return false;
+	}
+
+	size = static_cast< size_t >( fileSize.QuadPart );
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if( data != nullptr )
+		UnmapViewOfFile( data );
+	if( mapping != nullptr )
+		CloseHandle( mapping );
+	if( file != INVALID_HANDLE_VALUE )
+		CloseHandle( file );
+
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile()
+	: data( nullptr ), size( 0 ), fd( -1 )
+{
+}
+
+bool MappedFile::Open( const std::string& path )
+{
+	Close();
+
+	fd = open( path.c_str(), O_RDONLY );
+	if( fd < 0 )
+		return false;
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+	{
+		Close();
+		return false;
+	}
+
+	void* ptr = mmap( nullptr, static_cast< size_t >( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+	if( ptr == MAP_FAILED )
+	{
+		Close();
+		return false;
+	}
+
+	data = static_cast< const uint8_t* >( ptr );
+	size = static_cast< size_t >( st.st_size );
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if( data != nullptr )
+		munmap( const_cast< uint8_t* >( data ), size );
+	if( fd >= 0 )
+		close( fd );
+
+	data = nullptr;
+	size = 0;
+	fd = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
@@ -0,0 +1,483 @@
+
+#include "MarshalPlan.h"
+
+#include "common.h"
+#include "InteropInstance.h"
+#include "InteropType.h"
+#include "SafeArray.h"
+#include "TypeLib.h"
+
+namespace
+{
+	/**
+	 * Argument converters.
+	 *
+	 * Selected once per parameter when the plan is built.
+	 */
+	void I1ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_I1;
+		variant.cVal = static_cast< char >( value->Int32Value() );
+	}
+
+	void UI1ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_UI1;
+		variant.bVal = static_cast< unsigned char >( value->Int32Value() );
+	}
+
+	void I2ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_I2;
+		variant.iVal = static_cast< SHORT >( value->Int32Value() );
+	}
+
+	void UI2ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_UI2;
+		variant.uiVal = static_cast< USHORT >( value->Int32Value() );
+	}
+
+	void I4ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_I4;
+		variant.lVal = static_cast< LONG >( value->Int32Value() );
+	}
+
+	void UI4ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_UI4;
+		variant.ulVal = static_cast< ULONG >( value->Int32Value() );
+	}
+
+	void I8ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_I8;
+		variant.llVal = static_cast< LONGLONG >( value->IntegerValue() );
+	}
+
+	void UI8ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_UI8;
+		variant.ullVal = static_cast< ULONGLONG >( value->IntegerValue() );
+	}
+
+	void IntToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_INT;
+		variant.intVal = static_cast< INT >( value->Int32Value() );
+	}
+
+	void UIntToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_UINT;
+		variant.uintVal = static_cast< UINT >( value->Int32Value() );
+	}
+
+	void R4ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_R4;
+		variant.fltVal = static_cast< float >( value->NumberValue() );
+	}
+
+	void R8ToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_R8;
+		variant.dblVal = static_cast< double >( value->NumberValue() );
+	}
+
+	void DateToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_DATE;
+		variant.date = ValueToDate( value );
+	}
+
+	void BstrToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_BSTR;
+		variant.bstrVal = ValueToBstr( value );
+	}
+
+	void DispatchToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_DISPATCH;
+		Unwrap( value, OUT &variant.pdispVal );
+	}
+
+	void UnknownToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_UNKNOWN;
+		Unwrap( value, OUT &variant.punkVal );
+	}
+
+	void BoolToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.vt = VT_BOOL;
+		variant.boolVal = value->ToBoolean()->BooleanValue() ? VARIANT_TRUE : VARIANT_FALSE;
+	}
+
+	void EnumToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		InitVariantEnum( plan.refTypeInfo, value, OUT variant );
+	}
+
+	void UserDispatchToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		InitVariantDispatch( plan.refTypeInfo, value, OUT variant );
+	}
+
+	void ArrayToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		variant.parray = ValueToSafeArray( plan.elementVt, value );
+		variant.vt = VT_ARRAY | plan.elementVt;
+	}
+
+	void AnyToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		DynamicValueToVariant( value, OUT variant );
+	}
+
+	/**
+	 * Fails the call instead of passing an empty argument.
+	 */
+	void UnsupportedToVariant( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant )
+	{
+		if( plan.byRef )
+			JsException::Throw( "Arguments passed by reference, such as [in, out] arrays, are not supported." );
+
+		JsException::Throw( "The argument type is not supported." );
+	}
+
+	/**
+	 * Result converters for values stored directly in the VARIANT.
+	 */
+	v8::Local< v8::Value > I1ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.cVal ); }
+	v8::Local< v8::Value > UI1ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.bVal ); }
+	v8::Local< v8::Value > I2ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.iVal ); }
+	v8::Local< v8::Value > UI2ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.uiVal ); }
+	v8::Local< v8::Value > I4ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.lVal ); }
+	v8::Local< v8::Value > UI4ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.ulVal ); }
+	v8::Local< v8::Value > I8ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( static_cast< double >( variant.llVal ) ); }
+	v8::Local< v8::Value > UI8ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( static_cast< double >( variant.ullVal ) ); }
+	v8::Local< v8::Value > IntToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.intVal ); }
+	v8::Local< v8::Value > UIntToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.uintVal ); }
+	v8::Local< v8::Value > R4ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.fltVal ); }
+	v8::Local< v8::Value > R8ToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( variant.dblVal ); }
+	v8::Local< v8::Value > DateToValue( const TypePlan& plan, VARIANT& variant ) { return ::DateToValue( variant.date ); }
+	v8::Local< v8::Value > BstrToValue( const TypePlan& plan, VARIANT& variant ) { return TakeBstr( variant ); }
+	v8::Local< v8::Value > BoolToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New( variant.boolVal != VARIANT_FALSE ); }
+	v8::Local< v8::Value > DispatchToValue( const TypePlan& plan, VARIANT& variant ) { return InteropInstance::GetWrapper( variant.pdispVal, nullptr ); }
+
+	v8::Local< v8::Value > UnknownToValue( const TypePlan& plan, VARIANT& variant )
+	{
+		CComPtr< IDispatch > idisp;
+		if( variant.punkVal != nullptr )
+			variant.punkVal->QueryInterface< IDispatch >( &idisp );
+		return InteropInstance::GetWrapper( idisp, nullptr );
+	}
+
+	/**
+	 * Result converters for values behind a VT_PTR.
+	 */
+	v8::Local< v8::Value > I1RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.pcVal ); }
+	v8::Local< v8::Value > UI1RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.pbVal ); }
+	v8::Local< v8::Value > I2RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.piVal ); }
+	v8::Local< v8::Value > UI2RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.puiVal ); }
+	v8::Local< v8::Value > I4RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.plVal ); }
+	v8::Local< v8::Value > UI4RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.pulVal ); }
+	v8::Local< v8::Value > I8RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( static_cast< double >( *variant.pllVal ) ); }
+	v8::Local< v8::Value > UI8RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( static_cast< double >( *variant.pullVal ) ); }
+	v8::Local< v8::Value > IntRefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.pintVal ); }
+	v8::Local< v8::Value > UIntRefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.puintVal ); }
+	v8::Local< v8::Value > R4RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.pfltVal ); }
+	v8::Local< v8::Value > R8RefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New< v8::Number >( *variant.pdblVal ); }
+	v8::Local< v8::Value > DateRefToValue( const TypePlan& plan, VARIANT& variant ) { return ::DateToValue( *variant.pdate ); }
+	v8::Local< v8::Value > BstrRefToValue( const TypePlan& plan, VARIANT& variant ) { return BstrToString( *variant.pbstrVal ); }
+	v8::Local< v8::Value > BoolRefToValue( const TypePlan& plan, VARIANT& variant ) { return Nan::New( *variant.pboolVal != VARIANT_FALSE ); }
+	v8::Local< v8::Value > DispatchRefToValue( const TypePlan& plan, VARIANT& variant ) { return InteropInstance::GetWrapper( *variant.ppdispVal, nullptr ); }
+
+	v8::Local< v8::Value > UnknownRefToValue( const TypePlan& plan, VARIANT& variant )
+	{
+		CComPtr< IDispatch > idisp;
+		if( *variant.ppunkVal != nullptr )
+			( *variant.ppunkVal )->QueryInterface< IDispatch >( &idisp );
+		return InteropInstance::GetWrapper( idisp, nullptr );
+	}
+
+	/**
+	 * Result converters for VT_USERDEFINED types.
+	 */
+	v8::Local< v8::Value > EnumToValue( const TypePlan& plan, VARIANT& variant )
+	{
+		// TODO: Add enum types.
+		return Nan::New< v8::Number >( variant.lVal );
+	}
+
+	v8::Local< v8::Value > UserDispatchToValue( const TypePlan& plan, VARIANT& variant )
+	{
+		// Types from other type libraries have no constructor and are wrapped untyped.
+		return InteropInstance::GetWrapper( variant.pdispVal, plan.refType );
+	}
+
+	/**
+	 * Result converters for arrays and VARIANTs. The results own their data
+	 * so the arrays are taken without copying.
+	 */
+	v8::Local< v8::Value > ArrayToValue( const TypePlan& plan, VARIANT& variant ) { return TakeVariant( variant ); }
+	v8::Local< v8::Value > ArrayRefToValue( const TypePlan& plan, VARIANT& variant ) { return SafeArrayToValue( *variant.pparray, false ); }
+	v8::Local< v8::Value > AnyToValue( const TypePlan& plan, VARIANT& variant ) { return TakeVariant( variant ); }
+	v8::Local< v8::Value > AnyRefToValue( const TypePlan& plan, VARIANT& variant ) { return DynamicVariantToValue( *variant.pvarVal ); }
+
+	v8::Local< v8::Value > VoidToValue( const TypePlan& plan, VARIANT& variant )
+	{
+		return Nan::Undefined();
+	}
+
+	v8::Local< v8::Value > UnsupportedToValue( const TypePlan& plan, VARIANT& variant )
+	{
+		_ASSERTE( false );
+		return Nan::Undefined();
+	}
+
+	/**
+	 * Resolves the VT_USERDEFINED target of the type.
+	 */
+	void BuildUserDefined( ITypeInfo* typeInfo, const TYPEDESC& typedesc, OUT TypePlan& plan )
+	{
+		_ASSERTE( typedesc.hreftype != 0 );
+
+		plan.toVariant = UnsupportedToVariant;
+		plan.toValue = UnsupportedToValue;
+
+		const TypeRef& ref = TypeLib::ResolveRef( typeInfo, typedesc.hreftype );
+		plan.refTypeInfo = ref.typeInfo;
+		plan.refTypeKind = ref.typekind;
+		plan.refType = ref.type;
+
+		switch( plan.refTypeKind )
+		{
+		case TKIND_ENUM:
+			plan.toVariant = EnumToVariant;
+			plan.toValue = EnumToValue;
+			break;
+
+		case TKIND_DISPATCH:
+			plan.toVariant = UserDispatchToVariant;
+			plan.toValue = UserDispatchToValue;
+			break;
+
+		case TKIND_COCLASS:
+		case TKIND_INTERFACE:
+			// Arguments can still be passed as dispatch pointers.
+			plan.toVariant = UserDispatchToVariant;
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+MarshalPlan::MarshalPlan( ITypeInfo* typeInfo, const FUNCDESC* funcdesc )
+{
+	params.resize( funcdesc->cParams );
+	for( int i = 0; i < funcdesc->cParams; ++i )
+	{
+		const ELEMDESC& elem = funcdesc->lprgelemdescParam[ i ];
+		ParamPlan& param = params[ i ];
+
+		Build( typeInfo, elem.tdesc, OUT param.type );
+
+		if( elem.paramdesc.pparamdescex )
+		{
+			param.hasDefault = true;
+			param.defaultValue = elem.paramdesc.pparamdescex->varDefaultValue;
+		}
+
+		if( elem.paramdesc.wParamFlags & PARAMFLAG_FOPT )
+		{
+			param.isOptional = true;
+			param.optionalVt = elem.tdesc.vt;
+		}
+	}
+
+	Build( typeInfo, funcdesc->elemdescFunc.tdesc, OUT result );
+}
+
+/**
+ * Resolves the converters for the TYPEDESC.
+ */
+void MarshalPlan::Build( ITypeInfo* typeInfo, const TYPEDESC& typedesc, OUT TypePlan& plan )
+{
+	const TYPEDESC* desc = &typedesc;
+	if( desc->vt == VT_PTR )
+	{
+		plan.byRef = true;
+		desc = desc->lptdesc;
+	}
+
+	plan.vt = desc->vt;
+
+	// Only user defined types are supported behind pointers when converting arguments.
+	plan.toVariant = UnsupportedToVariant;
+	plan.toValue = UnsupportedToValue;
+
+	switch( plan.vt )
+	{
+	case VT_I1:  //signed char
+		plan.toVariant = I1ToVariant;
+		plan.toValue = plan.byRef ? I1RefToValue : I1ToValue;
+		break;
+	case VT_UI1:  //unsigned char
+		plan.toVariant = UI1ToVariant;
+		plan.toValue = plan.byRef ? UI1RefToValue : UI1ToValue;
+		break;
+	case VT_I2:  //2 byte signed int
+		plan.toVariant = I2ToVariant;
+		plan.toValue = plan.byRef ? I2RefToValue : I2ToValue;
+		break;
+	case VT_UI2:  //unsigned short
+		plan.toVariant = UI2ToVariant;
+		plan.toValue = plan.byRef ? UI2RefToValue : UI2ToValue;
+		break;
+	case VT_I4:  //4 byte signed int
+		plan.toVariant = I4ToVariant;
+		plan.toValue = plan.byRef ? I4RefToValue : I4ToValue;
+		break;
+	case VT_UI4:  //ULONG
+		plan.toVariant = UI4ToVariant;
+		plan.toValue = plan.byRef ? UI4RefToValue : UI4ToValue;
+		break;
+	case VT_I8:  //signed 64-bit int
+		plan.toVariant = I8ToVariant;
+		plan.toValue = plan.byRef ? I8RefToValue : I8ToValue;
+		break;
+	case VT_UI8:  //unsigned 64-bit int
+		plan.toVariant = UI8ToVariant;
+		plan.toValue = plan.byRef ? UI8RefToValue : UI8ToValue;
+		break;
+	case VT_INT:  //signed machine int
+		plan.toVariant = IntToVariant;
+		plan.toValue = plan.byRef ? IntRefToValue : IntToValue;
+		break;
+	case VT_UINT:  //unsigned machine int
+		plan.toVariant = UIntToVariant;
+		plan.toValue = plan.byRef ? UIntRefToValue : UIntToValue;
+		break;
+	case VT_R4:  //4 byte real
+		plan.toVariant = R4ToVariant;
+		plan.toValue = plan.byRef ? R4RefToValue : R4ToValue;
+		break;
+	case VT_R8:  //8 byte real
+		plan.toVariant = R8ToVariant;
+		plan.toValue = plan.byRef ? R8RefToValue : R8ToValue;
+		break;
+	case VT_DATE:  //date
+		plan.toVariant = DateToVariant;
+		plan.toValue = plan.byRef ? DateRefToValue : DateToValue;
+		break;
+	case VT_BSTR:  //OLE Automation string
+		plan.toVariant = BstrToVariant;
+		plan.toValue = plan.byRef ? BstrRefToValue : BstrToValue;
+		break;
+	case VT_BOOL:  //True=-1, False=0
+		plan.toVariant = BoolToVariant;
+		plan.toValue = plan.byRef ? BoolRefToValue : BoolToValue;
+		break;
+	case VT_DISPATCH:  //IDispatch *
+		plan.toVariant = DispatchToVariant;
+		plan.toValue = plan.byRef ? DispatchRefToValue : DispatchToValue;
+		break;
+	case VT_UNKNOWN:  //IUnknown *
+		plan.toVariant = UnknownToVariant;
+		plan.toValue = plan.byRef ? UnknownRefToValue : UnknownToValue;
+		break;
+
+	case VT_VOID:  //C style void
+		if( !plan.byRef )
+			plan.toValue = VoidToValue;
+		break;
+
+	case VT_SAFEARRAY:  //(use VT_ARRAY in VARIANT)
+		plan.elementVt = SafeArrayElementVt( typeInfo, *desc->lptdesc );
+		plan.toVariant = ArrayToVariant;
+		plan.toValue = plan.byRef ? ArrayRefToValue : ArrayToValue;
+		break;
+	case VT_VARIANT:  //VARIANT *
+		plan.toVariant = AnyToVariant;
+		plan.toValue = plan.byRef ? AnyRefToValue : AnyToValue;
+		break;
+
+	case VT_USERDEFINED:  //user defined type
+		BuildUserDefined( typeInfo, *desc, OUT plan );
+		return;
+
+	default:
+		// VT_CY, VT_DECIMAL, etc. aren't supported yet.
+		break;
+	}
+
+	// Pointers to non-user defined types can't be passed as arguments. The
+	// argument would need storage of its own for the callee to write to.
+	if( plan.byRef )
+		plan.toVariant = UnsupportedToVariant;
+}
+
+/**
+ * Converts the JavaScript arguments into the DISPPARAMS order.
+ */
+template< typename Args >
+void MarshalPlan::InitArgsFrom( const Args& values, OUT CComVariant* args ) const
+{
+	const int cParams = static_cast< int >( params.size() );
+	for( int i = 0; i < cParams; ++i )
+	{
+		try
+		{
+			const ParamPlan& param = params[ i ];
+
+			// Parameters are stored in reverse order.
+			CComVariant& arg = args[ cParams - i - 1 ];
+
+			// Check whether there exists a JS parameter for the current COM parameter.
+			if( values.Length() <= i )
+			{
+				// No parameter exists. Try to use a default.
+				if( param.hasDefault )
+				{
+					// Default value.
+					arg = param.defaultValue;
+				}
+				else if( param.isOptional )
+				{
+					// Optional value. Leave empty.
+					arg.ChangeType( param.optionalVt );
+				}
+				else
+				{
+					// Try to init from as the last resort.
+					param.type.toVariant( param.type, Nan::Undefined(), OUT arg );
+				}
+			}
+			else
+			{
+				// We have JS parameter. Convert it.
+				param.type.toVariant( param.type, values[ i ], OUT arg );
+			}
+		}
+		catch( JsException ex )
+		{
+			JsException::ThrowParameter( i, ex );
+		}
+	}
+}
+
+void MarshalPlan::InitArgs( Nan::NAN_METHOD_ARGS_TYPE info, OUT CComVariant* args ) const
+{
+	InitArgsFrom( info, OUT args );
+}
+
+void MarshalPlan::InitArgs( const ArrayArgs& values, OUT CComVariant* args ) const
+{
+	InitArgsFrom( values, OUT args );
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "utils.h"
+
+#include <nan.h>
+#include <vector>
+
+class InteropType;
+struct TypePlan;
+
+typedef void ( *ToVariantFn )( const TypePlan& plan, v8::Local< v8::Value > value, OUT CComVariant& variant );
+typedef v8::Local< v8::Value > ( *ToValueFn )( const TypePlan& plan, VARIANT& variant );
+
+/**
+ * Resolved conversion for a single TYPEDESC.
+ *
+ * Everything that depends only on the type library is figured out when the
+ * plan is built so the invocation path only needs to call the converters.
+ */
+struct TypePlan
+{
+	TypePlan() : vt( VT_EMPTY ), byRef( false ), elementVt( VT_EMPTY ), toVariant( nullptr ), toValue( nullptr ),
+		refTypeKind( TKIND_MAX ), refType( nullptr ) {}
+
+	// The VARTYPE after the VT_PTR indirection has been removed.
+	VARTYPE vt;
+	bool byRef;
+
+	// VT_SAFEARRAY element type.
+	VARTYPE elementVt;
+
+	ToVariantFn toVariant;
+	ToValueFn toValue;
+
+	// Resolved VT_USERDEFINED target.
+	CComPtr< ITypeInfo > refTypeInfo;
+	TYPEKIND refTypeKind;
+	InteropType* refType;
+};
+
+/**
+ * Array elements passed as call arguments.
+ */
+struct ArrayArgs
+{
+	ArrayArgs( v8::Local< v8::Array > array ) : array( array ) {}
+
+	int Length() const { return static_cast< int >( array->Length() ); }
+	v8::Local< v8::Value > operator[]( int i ) const { return array->Get( i ); }
+
+	v8::Local< v8::Array > array;
+};
+
+/**
+ * Resolved conversion for a single method parameter.
+ */
+struct ParamPlan
+{
+	ParamPlan() : hasDefault( false ), isOptional( false ), optionalVt( VT_EMPTY ) {}
+
+	TypePlan type;
+
+	bool hasDefault;
+	CComVariant defaultValue;
+
+	bool isOptional;
+	VARTYPE optionalVt;
+};
+
+/**
+ * Immutable marshaling plan for a method.
+ *
+ * Built once from the FUNCDESC when the type is initialized. Used for
+ * converting the JavaScript arguments into DISPPARAMS variants and the
+ * result variant back into a JavaScript value.
+ */
+class MarshalPlan
+{
+public:
+	MarshalPlan( ITypeInfo* typeInfo, const FUNCDESC* funcdesc );
+	~MarshalPlan() {}
+
+	static void Build( ITypeInfo* typeInfo, const TYPEDESC& typedesc, OUT TypePlan& plan );
+
+	// The array holds one variant per parameter.
+	void InitArgs( Nan::NAN_METHOD_ARGS_TYPE info, OUT CComVariant* args ) const;
+	void InitArgs( const ArrayArgs& values, OUT CComVariant* args ) const;
+	template< typename Args >
+	void InitArgs( const Args& values, OUT std::vector< CComVariant >& args ) const {
+		args.resize( params.size() );
+		InitArgs( values, OUT args.data() );
+	}
+	// Strings are moved out of the result instead of being copied.
+	v8::Local< v8::Value > ToValue( VARIANT& result ) const { return this->result.toValue( this->result, result ); }
+
+	std::vector< ParamPlan > params;
+	TypePlan result;
+
+private:
+	template< typename Args >
+	void InitArgsFrom( const Args& values, OUT CComVariant* args ) const;
+
+	MarshalPlan( const MarshalPlan& );
+	MarshalPlan& operator=( const MarshalPlan& );
+};
@@ -1,10 +1,16 @@
 #include "MethodInfo.h"
 #include "utils.h"
 
-MethodInfo::MethodInfo( const CComPtr< ITypeInfo >& typeInfo, IID interfaceID, UINT index, const TypeLib* typeLib )
-	: typeInfo( typeInfo ), iid( interfaceID ), typeLib( typeLib )
+MethodInfo::MethodInfo( const CComPtr< ITypeInfo >& typeInfo, IID interfaceID, UINT index )
+	: typeInfo( typeInfo ), iid( interfaceID )
 {
 	VERIFY( typeInfo->GetFuncDesc( index, &funcdesc ) );
+
+	// Resolve the parameter conversions once instead of on every call.
+	plan.reset( new MarshalPlan( typeInfo, funcdesc ) );
+	binding = StaticBinding::Find( iid, funcdesc->memid, funcdesc->invkind );
+	if( binding == nullptr )
+		direct.reset( DirectCall::Create( typeInfo, funcdesc ) );
 }
 
 
@@ -16,15 +22,25 @@ MethodInfo::~MethodInfo()
 	}
 }
 
-HRESULT MethodInfo::Invoke( IDispatch* obj, std::vector< CComVariant >& args, OUT VARIANT* presult, OUT EXCEPINFO* pexcepInfo )
+HRESULT MethodInfo::Invoke( IDispatch* obj, CComVariant* args, size_t argCount, OUT VARIANT* presult, OUT EXCEPINFO* pexcepInfo )
 {
+	// Dual interfaces are called through the vtable when the arguments fit.
+	HRESULT hr;
+	if( binding != nullptr && DirectCall::enabled &&
+		binding( obj, args, argCount, OUT presult, OUT pexcepInfo, OUT hr ) )
+		return hr;
+
+	if( direct != nullptr && direct->Accepts( argCount ) &&
+		direct->Invoke( obj, args, argCount, OUT presult, OUT pexcepInfo, OUT hr ) )
+		return hr;
+
 	unsigned int argErr;
 	DISPPARAMS params;
 
 	params.cNamedArgs = 0;
 	params.rgdispidNamedArgs = nullptr;
-	params.cArgs = static_cast< int >( args.size() );
-	params.rgvarg = args.data();
+	params.cArgs = static_cast< int >( argCount );
+	params.rgvarg = args;
 
 	WORD wFlags = 0;
 	DISPID dispidNamed = DISPID_PROPERTYPUT;
@@ -59,7 +75,5 @@ v8::Local< v8::Value > MethodInfo::GetInvokeResult( HRESULT hr, VARIANT& result,
 	
 	VERIFY( hr );
 
-	return VariantToValue(
-		typeInfo, funcdesc->elemdescFunc.tdesc,
-		result, nullptr );
+	return plan->ToValue( result );
 }
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "utils.h"
+#include "MarshalPlan.h"
+#include "DirectCall.h"
+#include "StaticBinding.h"
 
-class TypeLib;
+#include <memory>
 
 class MethodInfo
 {
@@ -10,16 +13,23 @@ public:
 	MethodInfo(
 			const CComPtr< ITypeInfo >& typeInfo,
 			IID iid,
-			UINT index,
-			const TypeLib* typeLib );
+			UINT index );
 	~MethodInfo();
 
 	CComPtr< ITypeInfo > typeInfo;
 	IID iid;
 	FUNCDESC* funcdesc;
-	const TypeLib* typeLib;
+	std::unique_ptr< MarshalPlan > plan;
 
-	HRESULT Invoke( IDispatch* obj, std::vector< CComVariant >& args, OUT VARIANT* presult, OUT EXCEPINFO* pexcepInfo );
+	// Vtable calls for members of dual interfaces. The generated binding is
+	// preferred over the one resolved at runtime.
+	StaticBinding::InvokeFn binding;
+	std::unique_ptr< DirectCall > direct;
+
+	HRESULT Invoke( IDispatch* obj, CComVariant* args, size_t argCount, OUT VARIANT* presult, OUT EXCEPINFO* pexcepInfo );
+	HRESULT Invoke( IDispatch* obj, std::vector< CComVariant >& args, OUT VARIANT* presult, OUT EXCEPINFO* pexcepInfo ) {
+		return Invoke( obj, args.data(), args.size(), OUT presult, OUT pexcepInfo );
+	}
 	v8::Local< v8::Value > GetInvokeResult( HRESULT hr, VARIANT& result, EXCEPINFO& exception );
 };
 
@@ -0,0 +1,185 @@
+#include "PreparedResult.h"
+
+#include "InteropInstance.h"
+
+void PreparedResult::Prepare( const TypePlan& plan, IN OUT VARIANT& result )
+{
+	Clear();
+
+	// The plan converters dereference the by-reference results.
+	if( plan.byRef )
+		return;
+
+	switch( plan.vt )
+	{
+	case VT_VOID:
+		kind = Undefined;
+		break;
+
+	case VT_VARIANT:
+		if( !( result.vt & ( VT_BYREF | VT_ARRAY ) ) )
+			PrepareValue( result.vt, OUT result );
+		break;
+
+	case VT_USERDEFINED:
+		if( plan.refTypeKind == TKIND_ENUM )
+		{
+			kind = Number;
+			number = result.lVal;
+		}
+		else if( plan.refTypeKind == TKIND_DISPATCH )
+		{
+			PrepareObject( result.pdispVal, plan.refType );
+		}
+		break;
+
+	default:
+		PrepareValue( plan.vt, OUT result );
+		break;
+	}
+}
+
+/**
+ * Unboxes the value of the given type. Other types are left unprepared.
+ */
+void PreparedResult::PrepareValue( VARTYPE vt, IN OUT VARIANT& result )
+{
+	switch( vt )
+	{
+	case VT_EMPTY: kind = Undefined; break;
+	case VT_NULL: kind = Null; break;
+	case VT_I1: kind = Number; number = result.cVal; break;
+	case VT_UI1: kind = Number; number = result.bVal; break;
+	case VT_I2: kind = Number; number = result.iVal; break;
+	case VT_UI2: kind = Number; number = result.uiVal; break;
+	case VT_I4: kind = Number; number = result.lVal; break;
+	case VT_UI4: kind = Number; number = result.ulVal; break;
+	case VT_INT: kind = Number; number = result.intVal; break;
+	case VT_UINT: kind = Number; number = result.uintVal; break;
+	case VT_I8: kind = Number; number = static_cast< double >( result.llVal ); break;
+	case VT_UI8: kind = Number; number = static_cast< double >( result.ullVal ); break;
+	case VT_R4: kind = Number; number = result.fltVal; break;
+	case VT_R8: kind = Number; number = result.dblVal; break;
+	case VT_BOOL: kind = Boolean; number = result.boolVal != VARIANT_FALSE ? 1 : 0; break;
+
+	case VT_DATE:
+		kind = Date;
+		number = DateToMilliseconds( result.date );
+		break;
+
+	case VT_BSTR:
+		PrepareString( OUT result );
+		break;
+
+	case VT_DISPATCH:
+		PrepareObject( result.pdispVal, nullptr );
+		break;
+
+	case VT_UNKNOWN:
+	{
+		CComPtr< IDispatch > idisp;
+		if( result.punkVal != nullptr )
+			result.punkVal->QueryInterface< IDispatch >( &idisp );
+		PrepareObject( idisp, nullptr );
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+/**
+ * Takes the BSTR out of the result.
+ *
+ * V8 stores Latin-1 strings with one byte per character and would scan and
+ * narrow the UTF-16 characters itself. Doing it here leaves only the copy of
+ * the bytes to the v8 thread.
+ */
+void PreparedResult::PrepareString( IN OUT VARIANT& result )
+{
+	BSTR bstr = result.bstrVal;
+	result.vt = VT_EMPTY;
+	result.bstrVal = nullptr;
+
+	// Large strings are exposed to V8 without copying. See TakeBstr.
+	UINT length = SysStringLen( bstr );
+	bool oneByte = length < ExternalBstrLength;
+	for( UINT i = 0; oneByte && i < length; i++ )
+		oneByte = bstr[ i ] <= 0xFF;
+
+	if( !oneByte )
+	{
+		kind = TwoByte;
+		wide = bstr;
+		return;
+	}
+
+	kind = OneByte;
+	narrow.resize( length );
+	for( UINT i = 0; i < length; i++ )
+		narrow[ i ] = static_cast< char >( bstr[ i ] );
+	SysFreeString( bstr );
+}
+
+/**
+ * Resolves the COM identity so the v8 thread can look up the wrapper
+ * without calling into the object.
+ */
+void PreparedResult::PrepareObject( IDispatch* pdisp, InteropType* staticType )
+{
+	kind = Object;
+	type = staticType;
+	dispatch = pdisp;
+	if( dispatch )
+		dispatch->QueryInterface< IUnknown >( OUT &identity );
+}
+
+v8::Local< v8::Value > PreparedResult::ToValue()
+{
+	switch( kind )
+	{
+	case Undefined: return Nan::Undefined();
+	case Null: return Nan::Null();
+	case Number: return Nan::New< v8::Number >( number );
+	case Boolean: return Nan::New( number != 0 );
+	case Date: return Nan::New< v8::Date >( number ).ToLocalChecked();
+
+	case OneByte:
+		if( narrow.empty() )
+			return Nan::EmptyString();
+		return Nan::NewOneByteString(
+				reinterpret_cast< const uint8_t* >( narrow.data() ),
+				static_cast< int >( narrow.size() ) ).ToLocalChecked();
+
+	case TwoByte:
+	{
+		VARIANT variant;
+		variant.vt = VT_BSTR;
+		variant.bstrVal = wide;
+		wide = nullptr;
+		return TakeBstr( variant );
+	}
+
+	case Object:
+		return InteropInstance::GetWrapper( dispatch, identity, type );
+
+	default:
+		_ASSERTE( false );
+		return Nan::Undefined();
+	}
+}
+
+void PreparedResult::Clear()
+{
+	kind = Unprepared;
+	number = 0;
+	narrow.clear();
+
+	SysFreeString( wide );
+	wide = nullptr;
+
+	dispatch.Release();
+	identity.Release();
+	type = nullptr;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "utils.h"
+#include "MarshalPlan.h"
+#include <nan.h>
+
+#include <string>
+
+class InteropType;
+
+/**
+ * Result of an asynchronous call converted in the worker thread.
+ *
+ * Holds the result in a form that doesn't need V8: numbers, booleans and
+ * dates are unboxed, short strings that fit in Latin-1 are narrowed into a
+ * buffer of the exact size and interface pointers carry their COM identity
+ * and static type. The v8 thread only creates the handles.
+ *
+ * Arrays, by-reference results and the types without a plain JavaScript
+ * counterpart are left in the VARIANT for the marshaling plan.
+ */
+class PreparedResult
+{
+public:
+	PreparedResult() : kind( Unprepared ), number( 0 ), wide( nullptr ), type( nullptr ) {}
+	~PreparedResult() { Clear(); }
+
+	/**
+	 * Takes the result out of the VARIANT when possible. Executed in the worker thread.
+	 */
+	void Prepare( const TypePlan& plan, IN OUT VARIANT& result );
+
+	/**
+	 * Returns false if the result was left in the VARIANT.
+	 */
+	bool IsPrepared() const { return kind != Unprepared; }
+
+	/**
+	 * Creates the JavaScript value. Executed in the v8 thread.
+	 */
+	v8::Local< v8::Value > ToValue();
+
+	/**
+	 * Releases the result. The string buffer keeps its capacity.
+	 */
+	void Clear();
+
+private:
+	enum Kind { Unprepared, Undefined, Null, Number, Boolean, Date, OneByte, TwoByte, Object };
+
+	PreparedResult( const PreparedResult& );
+	PreparedResult& operator=( const PreparedResult& );
+
+	void PrepareValue( VARTYPE vt, IN OUT VARIANT& result );
+	void PrepareString( IN OUT VARIANT& result );
+	void PrepareObject( IDispatch* pdisp, InteropType* staticType );
+
+	Kind kind;
+
+	// Number, Boolean and Date values. Dates are in JavaScript time.
+	double number;
+
+	// Characters of the Latin-1 strings.
+	std::string narrow;
+
+	// Other strings. Owned.
+	BSTR wide;
+
+	// Object results. The identity is the key of the wrapper map.
+	CComPtr< IDispatch > dispatch;
+	CComPtr< IUnknown > identity;
+	InteropType* type;
+};
@@ -0,0 +1,30 @@
+#include "ResourceStats.h"
+
+#include "InteropInstance.h"
+
+std::atomic< int64_t > ResourceStats::bstrs( 0 );
+std::atomic< int64_t > ResourceStats::variants( 0 );
+std::atomic< int64_t > ResourceStats::arrays( 0 );
+std::atomic< int64_t > ResourceStats::interfaces( 0 );
+
+/**
+ * Returns the live resource counts.
+ */
+NAN_METHOD( ResourceStats::GetStats )
+{
+	v8::Local< v8::Object > stats = Nan::New< v8::Object >();
+	Nan::Set( stats, Nan::New( "bstrs" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( bstrs.load() ) ) );
+	Nan::Set( stats, Nan::New( "variants" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( variants.load() ) ) );
+	Nan::Set( stats, Nan::New( "arrays" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( arrays.load() ) ) );
+	Nan::Set( stats, Nan::New( "interfaces" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( interfaces.load() ) ) );
+	Nan::Set( stats, Nan::New( "tracked" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( InteropInstance::TrackedCount() ) ) );
+	info.GetReturnValue().Set( stats );
+}
+
+void ResourceStats::Init( v8::Local< v8::Object > exports )
+{
+	Nan::HandleScope scope;
+
+	v8::Local< v8::FunctionTemplate > stats = Nan::New< v8::FunctionTemplate >( GetStats );
+	exports->Set( Nan::New( "resourceStats" ).ToLocalChecked(), stats->GetFunction() );
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <nan.h>
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Live counts of the COM resources held by the addon.
+ *
+ * The counts return to their baseline once the JavaScript objects holding
+ * the resources have been collected. Steady growth points to a leak.
+ */
+class ResourceStats
+{
+public:
+	static void Init( v8::Local< v8::Object > exports );
+	static NAN_METHOD( GetStats );
+
+	// BSTRs owned by external JavaScript strings.
+	static std::atomic< int64_t > bstrs;
+
+	// Results of the async calls and pipelines waiting to be settled.
+	static std::atomic< int64_t > variants;
+
+	// SAFEARRAYs owned by JavaScript buffers.
+	static std::atomic< int64_t > arrays;
+
+	// Interface references held by the JavaScript wrappers.
+	static std::atomic< int64_t > interfaces;
+};
@@ -0,0 +1,395 @@
+#include "SafeArray.h"
+
+#include "InteropInstance.h"
+#include "TypeLib.h"
+
+#include <memory>
+
+namespace
+{
+	v8::Local< v8::Value > ElementToValue( VARTYPE vt, const void* element );
+	void ValueToElement( VARTYPE vt, v8::Local< v8::Value > value, OUT void* element );
+
+	/**
+	 * Element size of the numeric types that map to TypedArrays or zero for others.
+	 */
+	size_t NumericSize( VARTYPE vt )
+	{
+		switch( vt )
+		{
+		case VT_I1:
+		case VT_UI1:
+			return 1;
+		case VT_I2:
+		case VT_UI2:
+			return 2;
+		case VT_I4:
+		case VT_UI4:
+		case VT_INT:
+		case VT_UINT:
+		case VT_R4:
+			return 4;
+		case VT_R8:
+			return 8;
+		default:
+			return 0;
+		}
+	}
+
+	/**
+	 * VARTYPE matching the TypedArray or VT_EMPTY for other values.
+	 */
+	VARTYPE TypedArrayVt( v8::Local< v8::Value > value )
+	{
+		if( value->IsUint8Array() ) return VT_UI1;
+		if( value->IsFloat64Array() ) return VT_R8;
+		if( value->IsInt32Array() ) return VT_I4;
+		if( value->IsFloat32Array() ) return VT_R4;
+		if( value->IsUint32Array() ) return VT_UI4;
+		if( value->IsInt16Array() ) return VT_I2;
+		if( value->IsUint16Array() ) return VT_UI2;
+		if( value->IsInt8Array() ) return VT_I1;
+		return VT_EMPTY;
+	}
+
+	bool SameLayout( VARTYPE a, VARTYPE b )
+	{
+		if( a == VT_INT ) a = VT_I4;
+		if( a == VT_UINT ) a = VT_UI4;
+		if( b == VT_INT ) b = VT_I4;
+		if( b == VT_UINT ) b = VT_UI4;
+		return a == b;
+	}
+
+	/**
+	 * Creates the TypedArray for the elements in the buffer.
+	 */
+	v8::Local< v8::Value > NewView( VARTYPE vt, v8::Local< v8::ArrayBuffer > buffer, size_t offset, size_t count )
+	{
+		switch( vt )
+		{
+		case VT_I1: return v8::Int8Array::New( buffer, offset, count );
+		case VT_UI1: return v8::Uint8Array::New( buffer, offset, count );
+		case VT_I2: return v8::Int16Array::New( buffer, offset, count );
+		case VT_UI2: return v8::Uint16Array::New( buffer, offset, count );
+		case VT_I4:
+		case VT_INT: return v8::Int32Array::New( buffer, offset, count );
+		case VT_UI4:
+		case VT_UINT: return v8::Uint32Array::New( buffer, offset, count );
+		case VT_R4: return v8::Float32Array::New( buffer, offset, count );
+		case VT_R8: return v8::Float64Array::New( buffer, offset, count );
+		default:
+			_ASSERTE( false );
+			return Nan::Undefined();
+		}
+	}
+
+	/**
+	 * Releases the array once the Buffer referencing its data is collected.
+	 */
+	void FreeSafeArray( char* data, void* hint )
+	{
+		SAFEARRAY* psa = static_cast< SAFEARRAY* >( hint );
+		SafeArrayUnaccessData( psa );
+		SafeArrayDestroy( psa );
+		ResourceStats::arrays--;
+	}
+
+	v8::Local< v8::Value > ElementToValue( VARTYPE vt, const void* element )
+	{
+		if( vt & VT_ARRAY )
+			return SafeArrayToValue( *static_cast< SAFEARRAY* const* >( element ), false );
+
+		switch( vt )
+		{
+		case VT_EMPTY: return Nan::Undefined();
+		case VT_NULL: return Nan::Null();
+		case VT_I1: return Nan::New< v8::Number >( *static_cast< const CHAR* >( element ) );
+		case VT_UI1: return Nan::New< v8::Number >( *static_cast< const BYTE* >( element ) );
+		case VT_I2: return Nan::New< v8::Number >( *static_cast< const SHORT* >( element ) );
+		case VT_UI2: return Nan::New< v8::Number >( *static_cast< const USHORT* >( element ) );
+		case VT_I4: return Nan::New< v8::Number >( *static_cast< const LONG* >( element ) );
+		case VT_UI4: return Nan::New< v8::Number >( *static_cast< const ULONG* >( element ) );
+		case VT_INT: return Nan::New< v8::Number >( *static_cast< const INT* >( element ) );
+		case VT_UINT: return Nan::New< v8::Number >( *static_cast< const UINT* >( element ) );
+		case VT_I8: return Nan::New< v8::Number >( static_cast< double >( *static_cast< const LONGLONG* >( element ) ) );
+		case VT_UI8: return Nan::New< v8::Number >( static_cast< double >( *static_cast< const ULONGLONG* >( element ) ) );
+		case VT_R4: return Nan::New< v8::Number >( *static_cast< const FLOAT* >( element ) );
+		case VT_R8: return Nan::New< v8::Number >( *static_cast< const DOUBLE* >( element ) );
+		case VT_BOOL: return Nan::New( *static_cast< const VARIANT_BOOL* >( element ) != VARIANT_FALSE );
+		case VT_DATE: return DateToValue( *static_cast< const DATE* >( element ) );
+		case VT_BSTR: return BstrToString( *static_cast< const BSTR* >( element ) );
+		case VT_VARIANT: return DynamicVariantToValue( *static_cast< const VARIANT* >( element ) );
+		case VT_DISPATCH: return InteropInstance::GetWrapper( *static_cast< IDispatch* const* >( element ), nullptr );
+		case VT_UNKNOWN:
+		{
+			IUnknown* punk = *static_cast< IUnknown* const* >( element );
+			CComPtr< IDispatch > idisp;
+			if( punk != nullptr )
+				punk->QueryInterface< IDispatch >( &idisp );
+			return InteropInstance::GetWrapper( idisp, nullptr );
+		}
+		default:
+			// VT_CY, VT_DECIMAL, VT_RECORD, etc. aren't supported yet.
+			_ASSERTE( false );
+			return Nan::Undefined();
+		}
+	}
+
+	/**
+	 * Writes the value into an element slot of the given type.
+	 */
+	void ValueToElement( VARTYPE vt, v8::Local< v8::Value > value, OUT void* element )
+	{
+		switch( vt )
+		{
+		case VT_I1: *static_cast< CHAR* >( element ) = static_cast< CHAR >( value->Int32Value() ); break;
+		case VT_UI1: *static_cast< BYTE* >( element ) = static_cast< BYTE >( value->Int32Value() ); break;
+		case VT_I2: *static_cast< SHORT* >( element ) = static_cast< SHORT >( value->Int32Value() ); break;
+		case VT_UI2: *static_cast< USHORT* >( element ) = static_cast< USHORT >( value->Int32Value() ); break;
+		case VT_I4: *static_cast< LONG* >( element ) = static_cast< LONG >( value->Int32Value() ); break;
+		case VT_UI4: *static_cast< ULONG* >( element ) = static_cast< ULONG >( value->Uint32Value() ); break;
+		case VT_INT: *static_cast< INT* >( element ) = static_cast< INT >( value->Int32Value() ); break;
+		case VT_UINT: *static_cast< UINT* >( element ) = static_cast< UINT >( value->Uint32Value() ); break;
+		case VT_I8: *static_cast< LONGLONG* >( element ) = static_cast< LONGLONG >( value->IntegerValue() ); break;
+		case VT_UI8: *static_cast< ULONGLONG* >( element ) = static_cast< ULONGLONG >( value->IntegerValue() ); break;
+		case VT_R4: *static_cast< FLOAT* >( element ) = static_cast< FLOAT >( value->NumberValue() ); break;
+		case VT_R8: *static_cast< DOUBLE* >( element ) = value->NumberValue(); break;
+		case VT_BOOL: *static_cast< VARIANT_BOOL* >( element ) = value->BooleanValue() ? VARIANT_TRUE : VARIANT_FALSE; break;
+		case VT_DATE: *static_cast< DATE* >( element ) = ValueToDate( value ); break;
+		case VT_BSTR: *static_cast< BSTR* >( element ) = ValueToBstr( value ); break;
+		case VT_VARIANT: DynamicValueToVariant( value, OUT *static_cast< VARIANT* >( element ) ); break;
+		case VT_DISPATCH:
+			if( value->IsObject() )
+				Unwrap( value, OUT static_cast< IDispatch** >( element ) );
+			break;
+		case VT_UNKNOWN:
+			if( value->IsObject() )
+				Unwrap( value, OUT static_cast< IUnknown** >( element ) );
+			break;
+		default:
+			JsException::Throw( "Unsupported array element type" );
+		}
+	}
+}
+
+v8::Local< v8::Value > SafeArrayToValue( SAFEARRAY* psa, bool owned )
+{
+	if( psa == nullptr )
+		return Nan::Null();
+
+	// Destroys the owned array unless it is handed over to a Buffer.
+	std::unique_ptr< SAFEARRAY, HRESULT ( __stdcall* )( SAFEARRAY* ) > ownedArray(
+			owned ? psa : nullptr, SafeArrayDestroy );
+
+	VARTYPE vt;
+	VERIFY( SafeArrayGetVartype( psa, OUT &vt ) );
+
+	UINT dims = SafeArrayGetDim( psa );
+	size_t count = dims > 0 ? 1 : 0;
+	v8::Local< v8::Array > dimensions = Nan::New< v8::Array >( dims );
+	for( UINT d = 1; d <= dims; ++d )
+	{
+		LONG lower, upper;
+		SafeArrayGetLBound( psa, d, OUT &lower );
+		SafeArrayGetUBound( psa, d, OUT &upper );
+		size_t length = upper >= lower ? static_cast< size_t >( upper - lower + 1 ) : 0;
+		count *= length;
+		Nan::Set( dimensions, d - 1, Nan::New< v8::Number >( static_cast< double >( length ) ) );
+	}
+
+	v8::Local< v8::Value > result;
+	size_t elementSize = NumericSize( vt );
+	if( elementSize != 0 )
+	{
+		size_t byteLength = count * elementSize;
+		if( owned && byteLength > 0 )
+		{
+			// Hand the locked data over to a Buffer. The array is released with it.
+			void* data;
+			VERIFY( SafeArrayAccessData( psa, OUT &data ) );
+			v8::Local< v8::Object > buffer = Nan::NewBuffer(
+					static_cast< char* >( data ), byteLength, FreeSafeArray, ownedArray.release() ).ToLocalChecked();
+			ResourceStats::arrays++;
+
+			v8::Local< v8::Uint8Array > bytes = buffer.As< v8::Uint8Array >();
+			result = vt == VT_UI1 ? buffer.As< v8::Value >() : NewView( vt, bytes->Buffer(), bytes->ByteOffset(), count );
+		}
+		else
+		{
+			void* data;
+			VERIFY( SafeArrayAccessData( psa, OUT &data ) );
+			v8::Local< v8::Object > buffer = Nan::CopyBuffer( static_cast< const char* >( data ), byteLength ).ToLocalChecked();
+			SafeArrayUnaccessData( psa );
+
+			v8::Local< v8::Uint8Array > bytes = buffer.As< v8::Uint8Array >();
+			result = vt == VT_UI1 ? buffer.As< v8::Value >() : NewView( vt, bytes->Buffer(), bytes->ByteOffset(), count );
+		}
+	}
+	else
+	{
+		UINT size = SafeArrayGetElemsize( psa );
+		void* data;
+		VERIFY( SafeArrayAccessData( psa, OUT &data ) );
+
+		v8::Local< v8::Array > array = Nan::New< v8::Array >( static_cast< int >( count ) );
+		for( size_t i = 0; i < count; ++i )
+		{
+			const void* element = static_cast< const BYTE* >( data ) + i * size;
+			Nan::Set( array, static_cast< uint32_t >( i ), ElementToValue( vt, element ) );
+		}
+
+		SafeArrayUnaccessData( psa );
+		result = array;
+	}
+
+	if( dims > 1 )
+		Nan::Set( result.As< v8::Object >(), Nan::New( "dimensions" ).ToLocalChecked(), dimensions );
+
+	return result;
+}
+
+SAFEARRAY* ValueToSafeArray( VARTYPE elementVt, v8::Local< v8::Value > value )
+{
+	if( value->IsNull() || value->IsUndefined() )
+		return nullptr;
+
+	if( !value->IsObject() )
+		JsException::Throw( "Expected an array" );
+
+	v8::Local< v8::Object > object = value.As< v8::Object >();
+
+	// Matching TypedArrays are copied in one go.
+	size_t elementSize = NumericSize( elementVt );
+	if( value->IsArrayBufferView() && elementSize != 0 && SameLayout( TypedArrayVt( value ), elementVt ) )
+	{
+		v8::Local< v8::ArrayBufferView > view = value.As< v8::ArrayBufferView >();
+		size_t count = view->ByteLength() / elementSize;
+
+		SAFEARRAY* psa = SafeArrayCreateVector( elementVt, 0, static_cast< ULONG >( count ) );
+		if( psa == nullptr )
+			JsException::Throw( E_OUTOFMEMORY );
+
+		void* data;
+		SafeArrayAccessData( psa, OUT &data );
+		view->CopyContents( data, count * elementSize );
+		SafeArrayUnaccessData( psa );
+		return psa;
+	}
+
+	// Other arrays are converted element by element.
+	uint32_t count = Nan::Get( object, Nan::New( "length" ).ToLocalChecked() ).ToLocalChecked()->Uint32Value();
+	SAFEARRAY* psa = SafeArrayCreateVector( elementVt, 0, count );
+	if( psa == nullptr )
+		JsException::Throw( E_OUTOFMEMORY );
+
+	// The array owns the elements written so far if a conversion throws.
+	std::unique_ptr< SAFEARRAY, HRESULT ( __stdcall* )( SAFEARRAY* ) > guard( psa, SafeArrayDestroy );
+
+	UINT size = SafeArrayGetElemsize( psa );
+	void* data;
+	SafeArrayAccessData( psa, OUT &data );
+	try
+	{
+		for( uint32_t i = 0; i < count; ++i )
+			ValueToElement( elementVt, Nan::Get( object, i ).ToLocalChecked(), OUT static_cast< BYTE* >( data ) + i * size );
+	}
+	catch( JsException )
+	{
+		SafeArrayUnaccessData( psa );
+		throw;
+	}
+	SafeArrayUnaccessData( psa );
+
+	return guard.release();
+}
+
+VARTYPE SafeArrayElementVt( ITypeInfo* typeInfo, const TYPEDESC& elementDesc )
+{
+	if( elementDesc.vt != VT_USERDEFINED )
+		return elementDesc.vt;
+
+	const TypeRef& ref = TypeLib::ResolveRef( typeInfo, elementDesc.hreftype );
+	return ref.typekind == TKIND_ENUM ? VT_I4 : VT_DISPATCH;
+}
+
+v8::Local< v8::Value > DynamicVariantToValue( const VARIANT& variant )
+{
+	if( variant.vt & VT_BYREF )
+		return ElementToValue( variant.vt & ~VT_BYREF, variant.byref );
+
+	// All the members of the VARIANT union share the same address.
+	return ElementToValue( variant.vt, &variant.llVal );
+}
+
+void DynamicValueToVariant( v8::Local< v8::Value > value, OUT VARIANT& variant )
+{
+	if( value->IsUndefined() )
+	{
+		variant.vt = VT_EMPTY;
+	}
+	else if( value->IsNull() )
+	{
+		variant.vt = VT_NULL;
+	}
+	else if( value->IsBoolean() )
+	{
+		variant.vt = VT_BOOL;
+		variant.boolVal = value->BooleanValue() ? VARIANT_TRUE : VARIANT_FALSE;
+	}
+	else if( value->IsInt32() )
+	{
+		variant.vt = VT_I4;
+		variant.lVal = value->Int32Value();
+	}
+	else if( value->IsNumber() )
+	{
+		variant.vt = VT_R8;
+		variant.dblVal = value->NumberValue();
+	}
+	else if( value->IsString() )
+	{
+		variant.vt = VT_BSTR;
+		variant.bstrVal = ValueToBstr( value );
+	}
+	else if( value->IsDate() )
+	{
+		variant.vt = VT_DATE;
+		variant.date = ValueToDate( value );
+	}
+	else if( value->IsArrayBufferView() || value->IsArray() )
+	{
+		// TypedArrays keep their element type, others become VARIANT arrays.
+		VARTYPE elementVt = TypedArrayVt( value );
+		if( elementVt == VT_EMPTY )
+			elementVt = VT_VARIANT;
+
+		variant.parray = ValueToSafeArray( elementVt, value );
+		variant.vt = VT_ARRAY | elementVt;
+	}
+	else if( InteropInstance::FromValue( value ) != nullptr )
+	{
+		variant.vt = VT_DISPATCH;
+		Unwrap( value, OUT &variant.pdispVal );
+	}
+	else
+	{
+		JsException::Throw( "Value can't be converted to VARIANT" );
+	}
+}
+
+v8::Local< v8::Value > TakeVariant( IN OUT VARIANT& variant )
+{
+	if( variant.vt == VT_BSTR )
+		return TakeBstr( variant );
+
+	if( ( variant.vt & VT_ARRAY ) && !( variant.vt & VT_BYREF ) )
+	{
+		SAFEARRAY* psa = variant.parray;
+		variant.vt = VT_EMPTY;
+		variant.parray = nullptr;
+		return SafeArrayToValue( psa, true );
+	}
+
+	return DynamicVariantToValue( variant );
+}
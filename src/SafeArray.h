@@ -0,0 +1,43 @@
+#pragma once
+
+#include "utils.h"
+#include <nan.h>
+
+/**
+ * SAFEARRAY and VARIANT marshaling.
+ *
+ * Arrays of numeric elements become TypedArrays over the array data, VT_UI1
+ * arrays become Buffers. Other element types are converted into JavaScript
+ * arrays. Multidimensional arrays are flattened in SAFEARRAY memory order
+ * with the lengths in a 'dimensions' property.
+ */
+
+/**
+ * Converts the array into a JavaScript value.
+ *
+ * When owned, the conversion takes the array and numeric views reference the
+ * locked array data until they are garbage collected. Otherwise the data is
+ * copied once.
+ */
+v8::Local< v8::Value > SafeArrayToValue( SAFEARRAY* psa, bool owned );
+
+/**
+ * Creates a one-dimensional array from a TypedArray, Buffer or array-like value.
+ */
+SAFEARRAY* ValueToSafeArray( VARTYPE elementVt, v8::Local< v8::Value > value );
+
+/**
+ * Resolves the VARTYPE of the SAFEARRAY( type ) elements.
+ */
+VARTYPE SafeArrayElementVt( ITypeInfo* typeInfo, const TYPEDESC& elementDesc );
+
+/**
+ * Converts VARIANTs whose type is only known at run time.
+ */
+v8::Local< v8::Value > DynamicVariantToValue( const VARIANT& variant );
+void DynamicValueToVariant( v8::Local< v8::Value > value, OUT VARIANT& variant );
+
+/**
+ * Converts the VARIANT moving the strings and arrays out of it.
+ */
+v8::Local< v8::Value > TakeVariant( IN OUT VARIANT& variant );
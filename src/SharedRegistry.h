@@ -0,0 +1,53 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+/**
+ * Immutable values shared by the environments of the process.
+ *
+ * The first Open of a key creates the value; the opens in the other
+ * environments get the same one for as long as any of them holds it. The
+ * registry only keeps weak references, so a value is released with its
+ * last holder and created again on the next Open.
+ *
+ * Does not depend on COM. TypeLibCore keeps its open libraries in one.
+ */
+template< typename Key, typename Value >
+class SharedRegistry
+{
+public:
+	SharedRegistry() {}
+
+	/**
+	 * Returns the value of the key, calling create for it if no environment
+	 * holds one. Concurrent opens wait for the one creating the value. A null
+	 * value from create is returned but not registered.
+	 */
+	template< typename Create >
+	std::shared_ptr< const Value > Open( const Key& key, Create create, bool& shared )
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+
+		auto it = values.find( key );
+		std::shared_ptr< const Value > value = it != values.end() ? it->second.lock() : nullptr;
+		shared = value != nullptr;
+		if( value )
+			return value;
+
+		value = create();
+		if( value )
+			values[ key ] = value;
+		else if( it != values.end() )
+			values.erase( it );
+		return value;
+	}
+
+private:
+	SharedRegistry( const SharedRegistry& );
+	SharedRegistry& operator=( const SharedRegistry& );
+
+	std::mutex mutex;
+	std::map< Key, std::weak_ptr< const Value > > values;
+};
@@ -0,0 +1,85 @@
+
+#include "Snapshot.h"
+
+#include <cstring>
+
+const char Snapshot::Magic[ 8 ] = { 'C', 'I', 'S', 'N', 'A', 'P', 0, 0 };
+
+namespace
+{
+	bool InRange( uint32_t offset, uint64_t count, size_t recordSize, size_t size )
+	{
+		return offset <= size && count * recordSize <= size - offset && offset % 8 == 0;
+	}
+}
+
+bool Snapshot::Open( const std::string& path )
+{
+	if( !file.Open( path ) )
+		return false;
+
+	if( !Attach( file.Data(), file.Size() ) )
+	{
+		file.Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool Snapshot::Attach( const uint8_t* snapshotData, size_t snapshotSize )
+{
+	data = nullptr;
+	size = 0;
+
+	if( snapshotSize < sizeof( SnapshotHeader ) )
+		return false;
+
+	const SnapshotHeader* header = reinterpret_cast< const SnapshotHeader* >( snapshotData );
+	if( memcmp( header->magic, Magic, sizeof( Magic ) ) != 0 ||
+		header->formatVersion != FormatVersion ||
+		header->size != snapshotSize )
+		return false;
+
+	if( !InRange( header->typesOffset, header->typeCount, sizeof( SnapshotType ), snapshotSize ) ||
+		!InRange( header->funcsOffset, header->funcCount, sizeof( SnapshotFunc ), snapshotSize ) ||
+		!InRange( header->stringsOffset, header->stringsSize, 1, snapshotSize ) )
+		return false;
+
+	// The string pool is terminated so a corrupt name offset can't run off the mapping.
+	if( header->stringsSize == 0 || snapshotData[ header->stringsOffset + header->stringsSize - 1 ] != 0 )
+		return false;
+
+	// The records are used in place, so every index and string offset is checked once here.
+	const SnapshotType* types = reinterpret_cast< const SnapshotType* >( snapshotData + header->typesOffset );
+	for( uint32_t i = 0; i < header->typeCount; i++ )
+	{
+		if( types[ i ].name >= header->stringsSize ||
+			types[ i ].firstFunc > header->funcCount ||
+			types[ i ].funcCount > header->funcCount - types[ i ].firstFunc )
+			return false;
+	}
+
+	const SnapshotFunc* funcs = reinterpret_cast< const SnapshotFunc* >( snapshotData + header->funcsOffset );
+	for( uint32_t i = 0; i < header->funcCount; i++ )
+	{
+		if( funcs[ i ].name >= header->stringsSize )
+			return false;
+	}
+
+	data = snapshotData;
+	size = snapshotSize;
+	return true;
+}
+
+const SnapshotType* Snapshot::FindType( const SnapshotGuid& guid ) const
+{
+	const SnapshotType* types = Types();
+	for( uint32_t i = 0; i < Header().typeCount; i++ )
+	{
+		if( memcmp( &types[ i ].guid, &guid, sizeof( guid ) ) == 0 )
+			return &types[ i ];
+	}
+
+	return nullptr;
+}
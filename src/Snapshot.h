@@ -0,0 +1,112 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Precompiled type library metadata.
+ *
+ * The snapshot is a flat little endian image of fixed size records that is
+ * used directly from a read-only memory mapping. Opening it validates the
+ * section ranges, record indices and string offsets without copying or
+ * parsing anything, so the accessors below need no further checks.
+ *
+ * Layout: header, types, functions and a string pool. All references
+ * between the sections are indices or string pool offsets. The snapshot
+ * holds the names and the shape of the functions only; the FUNCDESCs are
+ * still loaded from the type library to marshal the calls.
+ */
+struct SnapshotGuid
+{
+	uint32_t data1;
+	uint16_t data2;
+	uint16_t data3;
+	uint8_t data4[ 8 ];
+};
+
+struct SnapshotHeader
+{
+	char magic[ 8 ];
+	uint32_t formatVersion;
+	uint32_t size;
+
+	// Stamp of the type library the snapshot was produced from.
+	SnapshotGuid libGuid;
+	uint16_t majorVersion;
+	uint16_t minorVersion;
+	uint32_t lcid;
+
+	uint32_t typeCount;
+	uint32_t typesOffset;
+	uint32_t funcCount;
+	uint32_t funcsOffset;
+	uint32_t stringsSize;
+	uint32_t stringsOffset;
+};
+
+struct SnapshotType
+{
+	SnapshotGuid guid;
+	uint32_t name;
+	uint16_t typekind;
+	uint16_t flags;
+
+	// Functions in the order ITypeInfo::GetFuncDesc returns them.
+	uint32_t firstFunc;
+	uint32_t funcCount;
+
+	uint32_t reserved[ 2 ];
+};
+
+struct SnapshotFunc
+{
+	uint32_t name;
+	int32_t memid;
+	uint16_t invkind;
+	uint16_t flags;
+	uint16_t paramCount;
+	uint16_t reserved;
+};
+
+static_assert( sizeof( SnapshotGuid ) == 16, "SnapshotGuid layout" );
+static_assert( sizeof( SnapshotHeader ) == 64, "SnapshotHeader layout" );
+static_assert( sizeof( SnapshotType ) == 40, "SnapshotType layout" );
+static_assert( sizeof( SnapshotFunc ) == 16, "SnapshotFunc layout" );
+
+/**
+ * Read-only view of a snapshot file.
+ */
+class Snapshot
+{
+public:
+	static const char Magic[ 8 ];
+	static const uint32_t FormatVersion = 2;
+
+	Snapshot() : data( nullptr ), size( 0 ) {}
+
+	bool Open( const std::string& path );
+	bool Attach( const uint8_t* data, size_t size );
+
+	const SnapshotHeader& Header() const { return *reinterpret_cast< const SnapshotHeader* >( data ); }
+
+	uint32_t TypeCount() const { return Header().typeCount; }
+	const SnapshotType& Type( uint32_t index ) const { return Types()[ index ]; }
+	const SnapshotType* FindType( const SnapshotGuid& guid ) const;
+
+	const SnapshotFunc* Funcs( const SnapshotType& type ) const { return FuncTable() + type.firstFunc; }
+	const char* String( uint32_t offset ) const { return reinterpret_cast< const char* >( data + Header().stringsOffset + offset ); }
+
+private:
+	Snapshot( const Snapshot& );
+	Snapshot& operator=( const Snapshot& );
+
+	const SnapshotType* Types() const { return reinterpret_cast< const SnapshotType* >( data + Header().typesOffset ); }
+	const SnapshotFunc* FuncTable() const { return reinterpret_cast< const SnapshotFunc* >( data + Header().funcsOffset ); }
+
+	MappedFile file;
+	const uint8_t* data;
+	size_t size;
+};
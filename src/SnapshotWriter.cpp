@@ -0,0 +1,196 @@
+
+#include "SnapshotWriter.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// FUNCFLAG_FRESTRICTED and INVOKE_FUNC.
+	const uint16_t FuncFlagRestricted = 0x1;
+	const uint16_t InvokeFunc = 1;
+	const uint16_t VtVoid = 24;
+
+	// Dual and dispinterface type infos list the IUnknown and IDispatch members first.
+	const struct
+	{
+		const char* name;
+		size_t paramCount;
+	}
+	DispatchMembers[] = {
+		{ "QueryInterface", 2 }, { "AddRef", 0 }, { "Release", 0 },
+		{ "GetTypeInfoCount", 1 }, { "GetTypeInfo", 3 }, { "GetIDsOfNames", 5 }, { "Invoke", 8 }
+	};
+	const int32_t DispatchMemberId = 0x60000000;
+
+	// Bases are followed only this deep to survive cyclic references in corrupt files.
+	const int MaxInheritanceDepth = 32;
+
+	SnapshotGuid ToSnapshotGuid( const TypeLibReader::Guid& guid )
+	{
+		SnapshotGuid out;
+		out.data1 = guid.data1;
+		out.data2 = guid.data2;
+		out.data3 = guid.data3;
+		memcpy( out.data4, guid.data4, sizeof( out.data4 ) );
+		return out;
+	}
+
+	size_t Align( size_t offset )
+	{
+		return ( offset + 7 ) & ~static_cast< size_t >( 7 );
+	}
+
+	template< typename T >
+	void Append( std::vector< uint8_t >& out, size_t offset, const std::vector< T >& records )
+	{
+		if( !records.empty() )
+			memcpy( &out[ offset ], records.data(), records.size() * sizeof( T ) );
+	}
+}
+
+void SnapshotWriter::Write( const TypeLibReader& reader, std::vector< uint8_t >& out )
+{
+	SnapshotWriter writer( reader );
+
+	// Offset zero is reserved for the empty string.
+	writer.strings.push_back( '\0' );
+
+	for( size_t i = 0; i < reader.types.size(); ++i )
+		writer.AddType( reader.types[ i ] );
+
+	SnapshotHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, Snapshot::Magic, sizeof( header.magic ) );
+	header.formatVersion = Snapshot::FormatVersion;
+	header.libGuid = ToSnapshotGuid( reader.guid );
+	header.majorVersion = reader.majorVersion;
+	header.minorVersion = reader.minorVersion;
+	header.lcid = reader.lcid;
+
+	size_t offset = Align( sizeof( header ) );
+	header.typeCount = static_cast< uint32_t >( writer.types.size() );
+	header.typesOffset = static_cast< uint32_t >( offset );
+	offset = Align( offset + writer.types.size() * sizeof( SnapshotType ) );
+
+	header.funcCount = static_cast< uint32_t >( writer.funcs.size() );
+	header.funcsOffset = static_cast< uint32_t >( offset );
+	offset = Align( offset + writer.funcs.size() * sizeof( SnapshotFunc ) );
+
+	header.stringsSize = static_cast< uint32_t >( writer.strings.size() );
+	header.stringsOffset = static_cast< uint32_t >( offset );
+	offset += writer.strings.size();
+
+	header.size = static_cast< uint32_t >( offset );
+
+	out.assign( offset, 0 );
+	memcpy( &out[ 0 ], &header, sizeof( header ) );
+	Append( out, header.typesOffset, writer.types );
+	Append( out, header.funcsOffset, writer.funcs );
+	memcpy( &out[ header.stringsOffset ], writer.strings.data(), writer.strings.size() );
+}
+
+bool SnapshotWriter::WriteFile( const TypeLibReader& reader, const std::string& path )
+{
+	std::vector< uint8_t > data;
+	Write( reader, data );
+
+	FILE* file = fopen( path.c_str(), "wb" );
+	if( file == nullptr )
+		return false;
+
+	bool success = fwrite( data.data(), 1, data.size(), file ) == data.size();
+	return fclose( file ) == 0 && success;
+}
+
+void SnapshotWriter::AddType( const TypeLibReader::TypeInfo& type )
+{
+	SnapshotType record;
+	memset( &record, 0, sizeof( record ) );
+	record.guid = ToSnapshotGuid( type.guid );
+	record.name = AddString( type.name );
+	record.typekind = static_cast< uint16_t >( type.typekind );
+	record.flags = type.flags;
+
+	std::vector< TypeLibReader::FuncInfo > typeFuncs;
+	CollectFuncs( type, typeFuncs, 0 );
+
+	record.firstFunc = static_cast< uint32_t >( funcs.size() );
+	record.funcCount = static_cast< uint32_t >( typeFuncs.size() );
+	types.push_back( record );
+
+	for( size_t i = 0; i < typeFuncs.size(); ++i )
+	{
+		const TypeLibReader::FuncInfo& func = typeFuncs[ i ];
+
+		SnapshotFunc funcRecord;
+		memset( &funcRecord, 0, sizeof( funcRecord ) );
+		funcRecord.name = AddString( func.name );
+		funcRecord.memid = func.memid;
+		funcRecord.invkind = func.invkind;
+		funcRecord.flags = func.flags;
+		funcRecord.paramCount = static_cast< uint16_t >( func.params.size() );
+		funcs.push_back( funcRecord );
+	}
+}
+
+/**
+ * Lists the functions of the type in ITypeInfo::GetFuncDesc order.
+ */
+void SnapshotWriter::CollectFuncs(
+		const TypeLibReader::TypeInfo& type,
+		std::vector< TypeLibReader::FuncInfo >& out,
+		int depth ) const
+{
+	if( type.typekind != TypeLibReader::TkDispatch && type.typekind != TypeLibReader::TkInterface )
+		return;
+
+	bool dual = ( type.flags & TypeLibReader::TypeFlagDual ) != 0;
+	bool dispatchView = type.typekind == TypeLibReader::TkDispatch;
+
+	// Only the dispatch view includes the inherited members.
+	if( dispatchView && !type.implTypes.empty() && depth < MaxInheritanceDepth )
+	{
+		const TypeLibReader::TypeInfo* base = reader.GetRefType( type.implTypes[ 0 ].hreftype );
+		if( base != nullptr )
+		{
+			std::vector< TypeLibReader::FuncInfo > baseFuncs;
+			CollectFuncs( *base, baseFuncs, depth + 1 );
+
+			// Local bases of a dual interface are plain interfaces that need the same conversion.
+			for( size_t i = 0; i < baseFuncs.size(); ++i )
+				out.push_back( dual && base->typekind == TypeLibReader::TkInterface
+						? TypeLibReader::ToDispatch( baseFuncs[ i ] )
+						: baseFuncs[ i ] );
+		}
+		else
+		{
+			// External base is IDispatch from stdole.
+			for( size_t i = 0; i < sizeof( DispatchMembers ) / sizeof( DispatchMembers[ 0 ] ); ++i )
+			{
+				TypeLibReader::FuncInfo func;
+				func.name = DispatchMembers[ i ].name;
+				func.memid = DispatchMemberId + static_cast< int32_t >( i );
+				func.invkind = InvokeFunc;
+				func.flags = FuncFlagRestricted;
+				func.returnType.vt = VtVoid;
+				func.params.resize( DispatchMembers[ i ].paramCount );
+				out.push_back( func );
+			}
+		}
+	}
+
+	for( size_t i = 0; i < type.funcs.size(); ++i )
+		out.push_back( dual ? TypeLibReader::ToDispatch( type.funcs[ i ] ) : type.funcs[ i ] );
+}
+
+uint32_t SnapshotWriter::AddString( const std::string& str )
+{
+	if( str.empty() )
+		return 0;
+
+	uint32_t offset = static_cast< uint32_t >( strings.size() );
+	strings.append( str );
+	strings.push_back( '\0' );
+	return offset;
+}
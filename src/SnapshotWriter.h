@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Snapshot.h"
+#include "TypeLibReader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Produces the metadata snapshot of a type library.
+ *
+ * The function lists are written in the order ITypeInfo presents them: the
+ * dispinterfaces include the inherited IDispatch members and the dual
+ * interface functions are in their dispatch form.
+ */
+class SnapshotWriter
+{
+public:
+	static void Write( const TypeLibReader& reader, std::vector< uint8_t >& out );
+	static bool WriteFile( const TypeLibReader& reader, const std::string& path );
+
+private:
+	SnapshotWriter( const TypeLibReader& reader ) : reader( reader ) {}
+
+	void AddType( const TypeLibReader::TypeInfo& type );
+	void CollectFuncs( const TypeLibReader::TypeInfo& type, std::vector< TypeLibReader::FuncInfo >& funcs, int depth ) const;
+	uint32_t AddString( const std::string& str );
+
+	const TypeLibReader& reader;
+	std::vector< SnapshotType > types;
+	std::vector< SnapshotFunc > funcs;
+	std::string strings;
+};
@@ -0,0 +1,45 @@
+#include "StaticBinding.h"
+
+std::vector< StaticBinding::Interface >& StaticBinding::Interfaces()
+{
+	static std::vector< Interface > interfaces;
+	return interfaces;
+}
+
+StaticBinding::Registration::Registration( const Interface* interfaces, size_t count )
+{
+	Interfaces().insert( Interfaces().end(), interfaces, interfaces + count );
+}
+
+/**
+ * Returns the generated thunk of the member or null.
+ */
+StaticBinding::InvokeFn StaticBinding::Find( const IID& iid, MEMBERID memid, INVOKEKIND invkind )
+{
+	for( auto&& registered : Interfaces() )
+	{
+		if( !InlineIsEqualGUID( *registered.iid, iid ) )
+			continue;
+
+		for( size_t i = 0; i < registered.memberCount; i++ )
+		{
+			const Member& member = registered.members[ i ];
+			if( member.memid == memid && member.invkind == invkind )
+				return member.invoke;
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * Number of the registered members.
+ */
+size_t StaticBinding::Count()
+{
+	size_t count = 0;
+	for( auto&& registered : Interfaces() )
+		count += registered.memberCount;
+
+	return count;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "utils.h"
+
+#include <vector>
+
+/**
+ * Registry of the bindings generated with writeBindings().
+ *
+ * The generated sources register statically typed vtable thunks for the
+ * members of dual interfaces when the addon is loaded. MethodInfo prefers
+ * a registered thunk over the runtime resolved call paths.
+ */
+class StaticBinding
+{
+public:
+	/**
+	 * Calls the member. Returns false without calling it if the object or the
+	 * arguments don't fit the native signature.
+	 */
+	typedef bool ( *InvokeFn )(
+			IDispatch* obj,
+			CComVariant* args,
+			size_t argCount,
+			OUT VARIANT* presult,
+			OUT EXCEPINFO* pexcepInfo,
+			OUT HRESULT& hr );
+
+	struct Member
+	{
+		MEMBERID memid;
+		INVOKEKIND invkind;
+		InvokeFn invoke;
+	};
+
+	struct Interface
+	{
+		const IID* iid;
+		const Member* members;
+		size_t memberCount;
+	};
+
+	/**
+	 * Registers the interfaces of a generated source during static initialization.
+	 */
+	class Registration
+	{
+	public:
+		Registration( const Interface* interfaces, size_t count );
+	};
+
+	static InvokeFn Find( const IID& iid, MEMBERID memid, INVOKEKIND invkind );
+	static size_t Count();
+
+private:
+	// Function local so the generated registrations can run in any order.
+	static std::vector< Interface >& Interfaces();
+};
@@ -1,17 +1,16 @@
 #include "TypeLib.h"
 
 #include "common.h"
+#include "AddonState.h"
 #include "InteropType.h"
 
 #include <memory>
+#include <cstring>
 
 #include <iostream>
 
-Nan::Persistent< v8::Function > TypeLib::constructor;
-std::map< GUID, std::shared_ptr< InteropType > > TypeLib::types;
-
-TypeLib::TypeLib( const CComPtr< ITypeLib >& typeLib )
-	: typeLib( typeLib )
+TypeLib::TypeLib( const std::shared_ptr< const TypeLibCore >& core, bool lazy )
+	: core( core ), typeLib( core->typeLib ), lazy( lazy ), shared( false ), loadTime( 0 ), stats( std::make_shared< TypeLibStats >() )
 {
 }
 
@@ -23,50 +22,208 @@ TypeLib::~TypeLib()
 
 NAN_METHOD( TypeLib::New )
 {
-	if( info.Length() != 1 || !info[ 0 ]->IsExternal() ) {
+	if( info.Length() < 1 || !info[ 0 ]->IsExternal() ) {
 		Nan::ThrowTypeError( "Use Interop.load() to create the TypeLib." );
 		return;
 	}
 
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// The loader passes the core and whether it was already open.
 	v8::Local< v8::External > external = v8::Local< v8::External >::Cast( info[ 0 ] );
-	CComPtr< ITypeLib > typeLib = reinterpret_cast< ITypeLib* >( external->Value() );
+	std::shared_ptr< const TypeLibCore > core = *reinterpret_cast< std::shared_ptr< const TypeLibCore >* >( external->Value() );
+
+	// Read the load options.
+	bool lazy = false;
+	if( info.Length() > 1 && info[ 1 ]->IsObject() )
+	{
+		v8::Local< v8::Object > options = info[ 1 ].As< v8::Object >();
+		lazy = options->Get( Nan::New( "lazy" ).ToLocalChecked() )->BooleanValue();
+	}
 
-	TypeLib* obj = new TypeLib( typeLib );
+	TypeLib* obj = new TypeLib( core, lazy );
+	obj->shared = info.Length() > 2 && info[ 2 ]->BooleanValue();
 	obj->Wrap( info.This() );
 
-	for( ULONG ul = 0; ul < typeLib->GetTypeInfoCount(); ul++ )
+	// Snapshot types get their type info when they are materialized.
+	if( core->GetSnapshot() != nullptr )
 	{
-		CComPtr< ITypeInfo > typeInfo;
-		typeLib->GetTypeInfo( ul, OUT &typeInfo );
+		for( auto&& type : core->types )
+			obj->AddLazyType( info.This(), type );
 
-		CComBSTR bstrName;
-		if( !SUCCEEDED( typeInfo->GetDocumentation( MEMBERID_NIL, OUT &bstrName, nullptr, nullptr, nullptr ) ) )
+		// Without lazy loading the types are initialized up front. The
+		// accessors return the initialized constructors.
+		for( size_t i = 0; i < core->types.size() && !lazy; i++ )
 		{
-			Nan::ThrowTypeError( "Could not load type information" );
-			return;
+			std::shared_ptr< InteropType > type = GetInteropType( TypeKey( core->typeLib, core->types[ i ].index ) );
+			if( type == nullptr )
+				return Nan::ThrowTypeError( "Could not load type attributes" );
+			type->EnsureInit();
+		}
+
+		std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now() - start;
+		obj->loadTime = elapsed.count();
+
+		info.GetReturnValue().Set( info.This() );
+		return;
+	}
+
+	State& state = Get();
+	std::vector< std::shared_ptr< InteropType > > created;
+	for( auto&& coreType : core->types )
+	{
+		if( lazy )
+		{
+			// Only record the type. The InteropType is created on first use.
+			obj->AddLazyType( info.This(), coreType );
+			continue;
 		}
 
 		TYPEATTR* typeattr;
-		if( !SUCCEEDED( typeInfo->GetTypeAttr( &typeattr ) ) )
+		if( !SUCCEEDED( coreType.typeInfo->GetTypeAttr( &typeattr ) ) )
 		{
 			Nan::ThrowTypeError( "Could not load type attributes" );
 			return;
 		}
 
-		std::shared_ptr< InteropType > ptr( new InteropType( typeInfo, typeattr, obj ) );
-		obj->types[ typeattr->guid ] = ptr;
+		std::shared_ptr< InteropType > ptr( new InteropType( coreType.typeInfo, typeattr, obj->GetSource() ) );
+		TypeKey key( core->typeLib, coreType.index );
+		state.types[ key ] = ptr;
+		AddGuid( typeattr->guid, key );
+		created.push_back( ptr );
 	}
 
-	for( auto it = obj->types.begin(); it != obj->types.end(); ++it ) {
-		it->second->Init( obj );
-		info.This()->Set( it->second->name, it->second->constructor.Get( info.GetIsolate() ) );
+	for( auto it = created.begin(); it != created.end(); ++it ) {
+		( *it )->Init();
+		info.This()->Set( Nan::New( ( *it )->name ), ( *it )->constructor.Get( info.GetIsolate() ) );
 	}
 
+	std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now() - start;
+	obj->loadTime = elapsed.count();
+
 	info.GetReturnValue().Set( info.This() );
 }
 
+/**
+ * Records the type and exposes it through an accessor on the library.
+ */
+void TypeLib::AddLazyType( v8::Local< v8::Object > target, const TypeLibCore::Type& type )
+{
+	TypeKey key( core->typeLib, type.index );
+	LazyType& lazyType = Get().lazyTypes[ key ];
+	lazyType.guid = type.guid;
+	lazyType.typekind = type.typekind;
+	lazyType.index = type.index;
+	lazyType.typeInfo = type.typeInfo;
+	lazyType.source = GetSource();
+	lazyType.snapshotType = type.snapshotType;
+	AddGuid( type.guid, key );
+
+	Nan::SetAccessor(
+			target,
+			Nan::New( type.name.c_str() ).ToLocalChecked(),
+			GetLazyType, nullptr,
+			Nan::New< v8::External >( &lazyType ) );
+}
+
+/**
+ * Records the position of the type for resolving references by GUID.
+ */
+void TypeLib::AddGuid( const GUID& guid, const TypeKey& key )
+{
+	if( !InlineIsEqualGUID( guid, GUID_NULL ) )
+		Get().guids[ guid ] = key;
+}
+
+/**
+ * Materializes the lazy type on first access.
+ */
+NAN_GETTER( TypeLib::GetLazyType )
+{
+	LazyType* lazyType = reinterpret_cast< LazyType* >( info.Data().As< v8::External >()->Value() );
+
+	std::shared_ptr< InteropType > type = GetInteropType( TypeKey( lazyType->source.core->typeLib, lazyType->index ) );
+	if( type == nullptr )
+		return Nan::ThrowTypeError( "Could not load type attributes" );
+
+	info.GetReturnValue().Set( type->GetConstructor() );
+}
+
+/**
+ * Initializes all coclasses that have been loaded lazily.
+ *
+ * Interfaces only know their coclasses once the coclass has been initialized.
+ */
+void TypeLib::InitCoclasses()
+{
+	std::map< TypeKey, LazyType >& lazyTypes = Get().lazyTypes;
+	for( auto it = lazyTypes.begin(); it != lazyTypes.end(); ++it )
+	{
+		if( it->second.typekind != TKIND_COCLASS )
+			continue;
+
+		std::shared_ptr< InteropType > type = GetInteropType( it->first );
+		if( type )
+			type->EnsureInit();
+	}
+}
+
+TypeLib::InitTimer::InitTimer( TypeLibStats& stats )
+	: stats( stats ), outermost( Get().initDepth++ == 0 ), start( std::chrono::high_resolution_clock::now() )
+{
+	stats.initCount++;
+}
+
+TypeLib::InitTimer::~InitTimer()
+{
+	Get().initDepth--;
+	if( !outermost )
+		return;
+
+	std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now() - start;
+	stats.initTime += elapsed.count();
+}
+
+/**
+ * Returns the load statistics of the type library.
+ */
+NAN_METHOD( TypeLib::GetStats )
+{
+	if( info.Length() < 1 || !info[ 0 ]->IsObject() ) {
+		Nan::ThrowTypeError( "Missing type library" );
+		return;
+	}
+
+	TypeLib* lib = Nan::ObjectWrap::Unwrap< TypeLib >( info[ 0 ].As< v8::Object >() );
+
+	v8::Local< v8::Object > stats = Nan::New< v8::Object >();
+	Nan::Set( stats, Nan::New( "lazy" ).ToLocalChecked(), Nan::New( lib->lazy ) );
+	Nan::Set( stats, Nan::New( "snapshot" ).ToLocalChecked(), Nan::New( lib->GetSnapshot() != nullptr ) );
+	Nan::Set( stats, Nan::New( "shared" ).ToLocalChecked(), Nan::New( lib->shared ) );
+	Nan::Set( stats, Nan::New( "types" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( lib->core->types.size() ) ) );
+	Nan::Set( stats, Nan::New( "initialized" ).ToLocalChecked(), Nan::New< v8::Number >( lib->stats->initCount ) );
+	Nan::Set( stats, Nan::New( "readTime" ).ToLocalChecked(), Nan::New< v8::Number >( lib->core->readTime ) );
+	Nan::Set( stats, Nan::New( "loadTime" ).ToLocalChecked(), Nan::New< v8::Number >( lib->loadTime ) );
+	Nan::Set( stats, Nan::New( "initTime" ).ToLocalChecked(), Nan::New< v8::Number >( lib->stats->initTime ) );
+	info.GetReturnValue().Set( stats );
+}
+
+/**
+ * Returns the type by its position in the library it comes from.
+ *
+ * Types of other libraries are only found by their GUID.
+ */
 std::shared_ptr< InteropType > TypeLib::GetInteropType( ITypeInfo* typeInfo )
 {
+	CComPtr< ITypeLib > library;
+	UINT index;
+	if( SUCCEEDED( typeInfo->GetContainingTypeLib( OUT &library, OUT &index ) ) )
+	{
+		std::shared_ptr< InteropType > type = GetInteropType( TypeKey( library.p, index ) );
+		if( type != nullptr )
+			return type;
+	}
+
 	TypeInfoPtr< TYPEATTR > typeattr( typeInfo );
 	typeInfo->GetTypeAttr( typeattr.Out() );
 
@@ -75,18 +232,111 @@ std::shared_ptr< InteropType > TypeLib::GetInteropType( ITypeInfo* typeInfo )
 
 std::shared_ptr< InteropType > TypeLib::GetInteropType( TYPEATTR* typeattr )
 {
-	auto it = types.find( typeattr->guid );
-	if( it == types.end() )
-		return nullptr;
-	return it->second;
+	return GetInteropType( typeattr->guid );
 }
 
+/**
+ * Returns the type for the GUID.
+ */
 std::shared_ptr< InteropType > TypeLib::GetInteropType( GUID guid )
 {
-	auto it = types.find( guid );
-	if( it == types.end() )
+	State& state = Get();
+	auto it = state.guids.find( guid );
+	if( it == state.guids.end() )
 		return nullptr;
-	return it->second;
+
+	return GetInteropType( it->second );
+}
+
+/**
+ * Returns the type at the position in the library.
+ *
+ * Lazily loaded types are created here but initialized only once their
+ * constructor is needed.
+ */
+std::shared_ptr< InteropType > TypeLib::GetInteropType( const TypeKey& key )
+{
+	State& state = Get();
+	auto it = state.types.find( key );
+	if( it != state.types.end() )
+		return it->second;
+
+	auto lazyIt = state.lazyTypes.find( key );
+	if( lazyIt == state.lazyTypes.end() )
+		return nullptr;
+
+	// Types read from a snapshot get their type info from their position.
+	LazyType& lazyType = lazyIt->second;
+	if( lazyType.typeInfo == nullptr &&
+		!SUCCEEDED( key.first->GetTypeInfo( key.second, OUT &lazyType.typeInfo ) ) )
+		return nullptr;
+
+	TYPEATTR* typeattr;
+	if( !SUCCEEDED( lazyType.typeInfo->GetTypeAttr( &typeattr ) ) )
+		return nullptr;
+
+	// The snapshot record is only used while it still describes the type.
+	std::shared_ptr< InteropType > ptr( new InteropType( lazyType.typeInfo, typeattr, lazyType.source ) );
+	const SnapshotType* snapshotType = lazyType.snapshotType;
+	if( snapshotType != nullptr &&
+		memcmp( &snapshotType->guid, &typeattr->guid, sizeof( GUID ) ) == 0 &&
+		snapshotType->typekind == typeattr->typekind )
+		ptr->snapshotType = snapshotType;
+	state.types[ key ] = ptr;
+	return ptr;
+}
+
+/**
+ * Resolves the HREFTYPE into the referenced type.
+ *
+ * The references never change so the result is cached by ( typeInfo, hreftype ).
+ */
+const TypeRef& TypeLib::ResolveRef( ITypeInfo* typeInfo, HREFTYPE hreftype )
+{
+	State& state = Get();
+	auto key = std::make_pair( typeInfo, hreftype );
+	auto it = state.refCache.find( key );
+	if( it != state.refCache.end() )
+	{
+		state.refCacheHits++;
+		return it->second.ref;
+	}
+
+	state.refCacheMisses++;
+
+	RefCacheEntry& entry = state.refCache[ key ];
+	entry.owner = typeInfo;
+	if( SUCCEEDED( typeInfo->GetRefTypeInfo( hreftype, OUT &entry.ref.typeInfo ) ) )
+	{
+		TypeInfoPtr< TYPEATTR > typeattr( entry.ref.typeInfo );
+		entry.ref.typekind = typeattr->typekind;
+		entry.ref.type = GetInteropType( entry.ref.typeInfo ).get();
+	}
+
+	return entry.ref;
+}
+
+/**
+ * Returns the reference cache counters.
+ */
+NAN_METHOD( TypeLib::GetRefCacheStats )
+{
+	State& state = Get();
+	v8::Local< v8::Object > stats = Nan::New< v8::Object >();
+	Nan::Set( stats, Nan::New( "hits" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.refCacheHits ) ) );
+	Nan::Set( stats, Nan::New( "misses" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.refCacheMisses ) ) );
+	Nan::Set( stats, Nan::New( "size" ).ToLocalChecked(), Nan::New< v8::Number >( static_cast< double >( state.refCache.size() ) ) );
+	info.GetReturnValue().Set( stats );
+}
+
+TypeLib::State& TypeLib::Get()
+{
+	return AddonState::Get< State >();
+}
+
+v8::Local< v8::Function > TypeLib::GetConstructor()
+{
+	return Nan::New( Get().constructor );
 }
 
 void TypeLib::Init( v8::Local< v8::Object > exports )
@@ -98,7 +348,13 @@ void TypeLib::Init( v8::Local< v8::Object > exports )
 	ctorTemplate->InstanceTemplate()->SetInternalFieldCount( 1 );
 
 	v8::Local< v8::Function > ctor = ctorTemplate->GetFunction();
-	constructor.Reset( ctor );
+	Get().constructor.Reset( ctor );
 	exports->Set( Nan::New( "TypeLib" ).ToLocalChecked(), ctor );
 
+	v8::Local< v8::FunctionTemplate > refCacheStats = Nan::New< v8::FunctionTemplate >( GetRefCacheStats );
+	exports->Set( Nan::New( "refCacheStats" ).ToLocalChecked(), refCacheStats->GetFunction() );
+
+	v8::Local< v8::FunctionTemplate > stats = Nan::New< v8::FunctionTemplate >( GetStats );
+	exports->Set( Nan::New( "stats" ).ToLocalChecked(), stats->GetFunction() );
+
 }
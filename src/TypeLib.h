@@ -6,27 +6,137 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <chrono>
+#include <utility>
 
 #include "InteropType.h"
+#include "Snapshot.h"
+#include "TypeLibCore.h"
 
+/**
+ * Resolved VT_USERDEFINED reference.
+ */
+struct TypeRef
+{
+	TypeRef() : typekind( TKIND_MAX ), type( nullptr ) {}
+
+	CComPtr< ITypeInfo > typeInfo;
+	TYPEKIND typekind;
+	InteropType* type;
+};
+
+/**
+ * Type that has been discovered but not materialized yet.
+ */
+struct LazyType
+{
+	LazyType() : typekind( TKIND_MAX ), index( 0 ), snapshotType( nullptr ) {}
+
+	GUID guid;
+	TYPEKIND typekind;
+
+	// Position of the type in the library.
+	UINT index;
+
+	// Types read from a snapshot get their type info on materialization.
+	CComPtr< ITypeInfo > typeInfo;
+	TypeLibSource source;
+	const SnapshotType* snapshotType;
+};
+
+/**
+ * Type library loaded into an environment.
+ *
+ * The metadata is shared with the other environments through the
+ * TypeLibCore. The types and their JavaScript classes belong to the
+ * environment.
+ */
 class TypeLib : public Nan::ObjectWrap
 {
 public:
-	TypeLib( const CComPtr< ITypeLib >& typeLib );
+	TypeLib( const std::shared_ptr< const TypeLibCore >& core, bool lazy );
 	~TypeLib();
 
 	static NAN_METHOD( New );
 	static void Init( v8::Local< v8::Object > exports );
 
-	static Nan::Persistent< v8::Function > constructor;
+	static v8::Local< v8::Function > GetConstructor();
+
+	std::shared_ptr< const TypeLibCore > core;
 	CComPtr< ITypeLib > typeLib;
 
+	/**
+	 * Measures the time spent in the outermost InteropType::Init.
+	 */
+	class InitTimer
+	{
+	public:
+		InitTimer( TypeLibStats& stats );
+		~InitTimer();
+
+	private:
+		TypeLibStats& stats;
+		bool outermost;
+		std::chrono::high_resolution_clock::time_point start;
+	};
+
+	const Snapshot* GetSnapshot() const { return core->GetSnapshot(); }
+	TypeLibSource GetSource() const { return { core, stats }; }
+
+	static void InitCoclasses();
+	static NAN_GETTER( GetLazyType );
+	static NAN_METHOD( GetStats );
+
+	// Types are identified by their library and position. Records, enums
+	// and modules often have no GUID.
+	typedef std::pair< ITypeLib*, UINT > TypeKey;
+
 	static std::shared_ptr< InteropType > GetInteropType( ITypeInfo* typeInfo );
 	static std::shared_ptr< InteropType > GetInteropType( TYPEATTR* typeattr );
 	static std::shared_ptr< InteropType > GetInteropType( GUID guid );
+	static std::shared_ptr< InteropType > GetInteropType( const TypeKey& key );
+
+	static const TypeRef& ResolveRef( ITypeInfo* typeInfo, HREFTYPE hreftype );
+	static NAN_METHOD( GetRefCacheStats );
 
 private:
 
-	static std::map< GUID, std::shared_ptr< InteropType > > types;
-};
+	bool lazy;
+
+	// The metadata was opened by another environment or load.
+	bool shared;
+
+	void AddLazyType( v8::Local< v8::Object > target, const TypeLibCore::Type& type );
+	static void AddGuid( const GUID& guid, const TypeKey& key );
+
+	// Load statistics.
+	double loadTime;
+	std::shared_ptr< TypeLibStats > stats;
 
+	// The owner reference keeps the ITypeInfo key alive.
+	struct RefCacheEntry
+	{
+		CComPtr< ITypeInfo > owner;
+		TypeRef ref;
+	};
+
+	struct State
+	{
+		State() : initDepth( 0 ), refCacheHits( 0 ), refCacheMisses( 0 ) {}
+
+		Nan::Global< v8::Function > constructor;
+
+		std::map< TypeKey, std::shared_ptr< InteropType > > types;
+		std::map< TypeKey, LazyType > lazyTypes;
+
+		// Types by GUID for resolving references.
+		std::map< GUID, TypeKey > guids;
+		int initDepth;
+
+		std::map< std::pair< ITypeInfo*, HREFTYPE >, RefCacheEntry > refCache;
+		uint64_t refCacheHits;
+		uint64_t refCacheMisses;
+	};
+
+	static State& Get();
+};
@@ -0,0 +1,100 @@
+#include "TypeLibCore.h"
+
+#include <chrono>
+#include <cstring>
+
+SharedRegistry< std::pair< std::string, std::string >, TypeLibCore > TypeLibCore::cores;
+
+std::shared_ptr< const TypeLibCore > TypeLibCore::Open(
+		const std::string& path, const std::string& snapshotPath, OUT bool& shared )
+{
+	// Concurrent loads of the same library wait for the first one.
+	return cores.Open( std::make_pair( path, snapshotPath ), [ & ]() {
+		std::shared_ptr< TypeLibCore > created( new TypeLibCore() );
+		if( !created->Read( path, snapshotPath ) )
+			created.reset();
+		return created;
+	}, OUT shared );
+}
+
+/**
+ * Loads the library and reads the type directory from the snapshot or the library.
+ */
+bool TypeLibCore::Read( const std::string& path, const std::string& snapshotPath )
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::wstring widePath = FromUTF8( path.c_str() );
+	CoLoadLibrary( const_cast< wchar_t* >( widePath.c_str() ), false );
+	if( !SUCCEEDED( LoadTypeLib( widePath.c_str(), OUT &typeLib ) ) )
+		return false;
+
+	// The snapshot replaces the type enumeration.
+	if( !snapshotPath.empty() && OpenSnapshot( snapshotPath ) )
+	{
+		types.resize( snapshot->TypeCount() );
+		for( uint32_t i = 0; i < snapshot->TypeCount(); i++ )
+		{
+			const SnapshotType& snapshotType = snapshot->Type( i );
+			Type& type = types[ i ];
+			memcpy( &type.guid, &snapshotType.guid, sizeof( type.guid ) );
+			type.typekind = static_cast< TYPEKIND >( snapshotType.typekind );
+			type.name = snapshot->String( snapshotType.name );
+			type.index = i;
+			type.snapshotType = &snapshotType;
+		}
+	}
+	else
+	{
+		types.resize( typeLib->GetTypeInfoCount() );
+		for( UINT i = 0; i < types.size(); i++ )
+		{
+			Type& type = types[ i ];
+			typeLib->GetTypeInfo( i, OUT &type.typeInfo );
+
+			CComBSTR bstrName;
+			if( !SUCCEEDED( type.typeInfo->GetDocumentation( MEMBERID_NIL, OUT &bstrName, nullptr, nullptr, nullptr ) ) )
+				return false;
+
+			TYPEATTR* typeattr;
+			if( !SUCCEEDED( type.typeInfo->GetTypeAttr( &typeattr ) ) )
+				return false;
+
+			type.guid = typeattr->guid;
+			type.typekind = typeattr->typekind;
+			type.name = ToUTF8( bstrName );
+			type.index = i;
+			type.typeInfo->ReleaseTypeAttr( typeattr );
+		}
+	}
+
+	std::chrono::duration< double, std::milli > elapsed = std::chrono::high_resolution_clock::now() - start;
+	readTime = elapsed.count();
+	return true;
+}
+
+/**
+ * Opens the snapshot if it was produced from this library.
+ */
+bool TypeLibCore::OpenSnapshot( const std::string& path )
+{
+	std::unique_ptr< Snapshot > candidate( new Snapshot() );
+	if( !candidate->Open( path ) )
+		return false;
+
+	TLIBATTR* libattr;
+	if( !SUCCEEDED( typeLib->GetLibAttr( &libattr ) ) )
+		return false;
+
+	const SnapshotHeader& header = candidate->Header();
+	bool match = memcmp( &header.libGuid, &libattr->guid, sizeof( GUID ) ) == 0 &&
+			header.majorVersion == libattr->wMajorVerNum &&
+			header.minorVersion == libattr->wMinorVerNum &&
+			header.lcid == libattr->lcid &&
+			header.typeCount == typeLib->GetTypeInfoCount();
+	typeLib->ReleaseTLibAttr( libattr );
+
+	if( match )
+		snapshot = std::move( candidate );
+	return match;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "utils.h"
+#include "SharedRegistry.h"
+#include "Snapshot.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Metadata of a type library shared by the environments of the process.
+ *
+ * The first load() of a library reads its type directory and opens the
+ * snapshot. The loads in the other worker_threads reuse the same core and
+ * only build their own JavaScript classes on top of it. The core is
+ * immutable once opened; ITypeLib and ITypeInfo are free threaded.
+ */
+class TypeLibCore
+{
+public:
+	struct Type
+	{
+		Type() : typekind( TKIND_MAX ), index( 0 ), snapshotType( nullptr ) {}
+
+		GUID guid;
+		TYPEKIND typekind;
+		std::string name;
+		UINT index;
+
+		// Types read from the snapshot are resolved on materialization.
+		CComPtr< ITypeInfo > typeInfo;
+		const SnapshotType* snapshotType;
+	};
+
+	/**
+	 * Returns the core of the library, reading it if no environment has it open.
+	 *
+	 * Snapshots that don't match the library are ignored.
+	 */
+	static std::shared_ptr< const TypeLibCore > Open(
+			const std::string& path, const std::string& snapshotPath, OUT bool& shared );
+
+	const Snapshot* GetSnapshot() const { return snapshot.get(); }
+
+	CComPtr< ITypeLib > typeLib;
+	std::vector< Type > types;
+
+	// Time spent reading the metadata.
+	double readTime;
+
+private:
+	TypeLibCore() : readTime( 0 ) {}
+
+	bool Read( const std::string& path, const std::string& snapshotPath );
+	bool OpenSnapshot( const std::string& path );
+
+	std::unique_ptr< Snapshot > snapshot;
+
+	// Open cores by library and snapshot path.
+	static SharedRegistry< std::pair< std::string, std::string >, TypeLibCore > cores;
+};
+
+/**
+ * Statistics of the types initialized through one load().
+ */
+struct TypeLibStats
+{
+	TypeLibStats() : initCount( 0 ), initTime( 0 ) {}
+
+	ULONG initCount;
+	double initTime;
+};
+
+/**
+ * Library the types were loaded from.
+ *
+ * The environment keeps the types after the TypeLib object has been
+ * collected, so they hold the core and the statistics themselves.
+ */
+struct TypeLibSource
+{
+	std::shared_ptr< const TypeLibCore > core;
+	std::shared_ptr< TypeLibStats > stats;
+};
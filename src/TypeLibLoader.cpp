@@ -3,7 +3,11 @@
 #include <atlbase.h>
 #include "utils.h"
 
+#include "BindingWriter.h"
+#include "MappedFile.h"
+#include "SnapshotWriter.h"
 #include "TypeLib.h"
+#include "TypeLibReader.h"
 
 void TypeLibLoader::Load( const Nan::FunctionCallbackInfo< v8::Value >& info )
 {
@@ -12,22 +16,107 @@ void TypeLibLoader::Load( const Nan::FunctionCallbackInfo< v8::Value >& info )
 		return;
 	}
 
-	// Convert the path argument to a native string.
-	v8::String::Utf8Value utf8( info[ 0 ]->ToString() );
-	std::wstring str = FromUTF8( *utf8 );
+	v8::String::Utf8Value path( info[ 0 ]->ToString() );
 
-	HINSTANCE module = CoLoadLibrary( const_cast< wchar_t* >( str.c_str() ), false );
+	// Pass the load options through to the TypeLib.
+	v8::Local< v8::Value > options = info.Length() > 1 ? info[ 1 ] : Nan::Undefined().As< v8::Value >();
 
-	// Try to load the type library.
-	CComPtr< ITypeLib > typeLib;
-	if( !SUCCEEDED( LoadTypeLib( str.c_str(), OUT &typeLib ) ) ) {
+	std::string snapshotPath;
+	if( options->IsObject() )
+	{
+		v8::Local< v8::Value > snapshotOption = options.As< v8::Object >()->Get( Nan::New( "snapshot" ).ToLocalChecked() );
+		if( snapshotOption->IsString() )
+			snapshotPath = *v8::String::Utf8Value( snapshotOption );
+	}
+
+	// The metadata is shared with the other environments that load the library.
+	bool shared = false;
+	std::shared_ptr< const TypeLibCore > core = TypeLibCore::Open( *path, snapshotPath, OUT shared );
+	if( core == nullptr ) {
 		Nan::ThrowTypeError( "Could not load type library." );
 		return;
 	}
 
-	v8::Local< v8::Value > argv[ 1 ] = { Nan::New< v8::External >( typeLib.p ) };
-	v8::Local< v8::Function > cons = Nan::New< v8::Function >( TypeLib::constructor );
-	info.GetReturnValue().Set( cons->NewInstance( Nan::GetCurrentContext(), 1, argv ).ToLocalChecked() );
+	v8::Local< v8::Value > argv[ 3 ] = { Nan::New< v8::External >( &core ), options, Nan::New( shared ) };
+	v8::Local< v8::Function > cons = TypeLib::GetConstructor();
+	info.GetReturnValue().Set( cons->NewInstance( Nan::GetCurrentContext(), 3, argv ).ToLocalChecked() );
+}
+
+/**
+ * Writes the metadata snapshot of the type library for load( path, { snapshot } ).
+ */
+void TypeLibLoader::WriteSnapshot( const Nan::FunctionCallbackInfo< v8::Value >& info )
+{
+	if( info.Length() < 2 ) {
+		Nan::ThrowTypeError( "Missing library or snapshot path" );
+		return;
+	}
+
+	// The reader works on the file directly so both paths stay in UTF-8.
+	v8::String::Utf8Value libraryPath( info[ 0 ]->ToString() );
+	v8::String::Utf8Value snapshotPath( info[ 1 ]->ToString() );
+
+	MappedFile file;
+	if( !file.Open( *libraryPath ) ) {
+		Nan::ThrowTypeError( "Could not open type library." );
+		return;
+	}
+
+	try
+	{
+		TypeLibReader reader( file.Data(), file.Size() );
+		if( !SnapshotWriter::WriteFile( reader, *snapshotPath ) ) {
+			Nan::ThrowError( "Could not write snapshot." );
+			return;
+		}
+	}
+	catch( const TypeLibReader::FormatError& e )
+	{
+		Nan::ThrowTypeError( e.what() );
+	}
+}
+
+/**
+ * Generates the static bindings and TypeScript declarations of the type library:
+ * writeBindings( library, { source, declarations } ).
+ */
+void TypeLibLoader::WriteBindings( const Nan::FunctionCallbackInfo< v8::Value >& info )
+{
+	if( info.Length() < 2 || !info[ 1 ]->IsObject() ) {
+		Nan::ThrowTypeError( "Missing library path or output paths" );
+		return;
+	}
+
+	v8::String::Utf8Value libraryPath( info[ 0 ]->ToString() );
+	v8::Local< v8::Object > options = info[ 1 ].As< v8::Object >();
+	v8::Local< v8::Value > source = options->Get( Nan::New( "source" ).ToLocalChecked() );
+	v8::Local< v8::Value > declarations = options->Get( Nan::New( "declarations" ).ToLocalChecked() );
+
+	MappedFile file;
+	if( !file.Open( *libraryPath ) ) {
+		Nan::ThrowTypeError( "Could not open type library." );
+		return;
+	}
+
+	try
+	{
+		TypeLibReader reader( file.Data(), file.Size() );
+		if( !source->IsUndefined() &&
+			!BindingWriter::WriteFile( BindingWriter::WriteSource( reader ), *v8::String::Utf8Value( source ) ) ) {
+			Nan::ThrowError( "Could not write the binding source." );
+			return;
+		}
+
+		if( !declarations->IsUndefined() &&
+			!BindingWriter::WriteFile( BindingWriter::WriteDeclarations( reader ), *v8::String::Utf8Value( declarations ) ) ) {
+			Nan::ThrowError( "Could not write the declarations." );
+			return;
+		}
+	}
+	catch( const TypeLibReader::FormatError& e )
+	{
+		Nan::ThrowTypeError( e.what() );
+	}
 }
 
 void TypeLibLoader::Init( v8::Local< v8::Object > exports )
@@ -36,4 +125,10 @@ void TypeLibLoader::Init( v8::Local< v8::Object > exports )
 
 	v8::Local< v8::FunctionTemplate > load = Nan::New< v8::FunctionTemplate >( Load );
 	exports->Set( Nan::New( "load" ).ToLocalChecked(), load->GetFunction() );
+
+	v8::Local< v8::FunctionTemplate > writeSnapshot = Nan::New< v8::FunctionTemplate >( WriteSnapshot );
+	exports->Set( Nan::New( "writeSnapshot" ).ToLocalChecked(), writeSnapshot->GetFunction() );
+
+	v8::Local< v8::FunctionTemplate > writeBindings = Nan::New< v8::FunctionTemplate >( WriteBindings );
+	exports->Set( Nan::New( "writeBindings" ).ToLocalChecked(), writeBindings->GetFunction() );
 }
@@ -9,10 +9,10 @@ class TypeLibLoader
 public:
 	static void Init( v8::Local< v8::Object > exports );
 	static void Load( const Nan::FunctionCallbackInfo< v8::Value >& info );
+	static void WriteSnapshot( const Nan::FunctionCallbackInfo< v8::Value >& info );
+	static void WriteBindings( const Nan::FunctionCallbackInfo< v8::Value >& info );
 
 private:
-	static Nan::Persistent< v8::FunctionTemplate > constructorTemplate;
-
 	TypeLibLoader() {};
 	~TypeLibLoader() {};
 };
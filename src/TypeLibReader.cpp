@@ -0,0 +1,716 @@
+
+#include "TypeLibReader.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// "MSFT" and "SLTG" in little endian.
+	const uint32_t MsftMagic = 0x5446534d;
+	const uint32_t SltgMagic = 0x47544c53;
+
+	// Header layout.
+	const size_t HeaderSize = 0x54;
+	const size_t HeaderPosGuid = 0x08;
+	const size_t HeaderLcid = 0x0c;
+	const size_t HeaderVarFlags = 0x14;
+	const size_t HeaderVersion = 0x18;
+	const size_t HeaderTypeInfoCount = 0x20;
+	const size_t HeaderHelpString = 0x24;
+	const size_t HeaderNameOffset = 0x38;
+	const size_t HeaderDispatchPos = 0x4c;
+	const int32_t HelpDllFlag = 0x100;
+
+	// Each segment directory entry has offset, length and two reserved values.
+	const size_t SegmentEntrySize = 16;
+
+	// MSFT_TypeInfoBase layout.
+	const size_t TypeInfoSize = 0x64;
+	const size_t TypeInfoKind = 0x00;
+	const size_t TypeInfoMemOffset = 0x04;
+	const size_t TypeInfoElements = 0x18;
+	const size_t TypeInfoPosGuid = 0x2c;
+	const size_t TypeInfoFlags = 0x30;
+	const size_t TypeInfoName = 0x34;
+	const size_t TypeInfoVersion = 0x38;
+	const size_t TypeInfoDocString = 0x3c;
+	const size_t TypeInfoImplTypes = 0x4c;
+	const size_t TypeInfoSizeVft = 0x4e;
+	const size_t TypeInfoInstanceSize = 0x50;
+	const size_t TypeInfoDataType1 = 0x54;
+
+	// MSFT_FuncRecord layout. The optional fields follow the fixed part.
+	const size_t FuncDataType = 0x04;
+	const size_t FuncFlags = 0x08;
+	const size_t FuncVtableOffset = 0x0c;
+	const size_t FuncKind = 0x10;
+	const size_t FuncArgCount = 0x14;
+	const size_t FuncOptArgCount = 0x16;
+	const int32_t FuncHasDefaults = 0x1000;
+
+	// MSFT_ParameterInfo: DataType, oName, Flags.
+	const size_t ParamInfoSize = 12;
+
+	// MSFT_VarRecord layout. The VARKIND is followed by the VARDESC size.
+	const size_t VarDataType = 0x04;
+	const size_t VarFlags = 0x08;
+	const size_t VarKind = 0x0c;
+	const size_t VarOffsValue = 0x10;
+	const uint16_t VarConst = 2;
+
+	// MSFT_RefRecord: reftype, flags, oCustData, onext.
+	const size_t RefRecordSize = 16;
+
+	// MSFT_ImpInfo: flags, oImpFile, oGuid.
+	const int32_t ImpInfoOffsetIsGuid = 0x00010000;
+
+	// FUNCKIND, CALLCONV and VARTYPE values used by the dispatch conversion.
+	const uint8_t FuncDispatch = 4;
+	const uint8_t CallConvStdcall = 4;
+	const uint16_t VtVoid = 24;
+	const uint16_t VtBstr = 8;
+
+	/**
+	 * The names are stored in the ANSI code page which for all practical
+	 * purposes is ASCII. Convert anything above that as Latin-1 so the
+	 * result is always valid UTF-8.
+	 */
+	std::string Latin1ToUTF8( const uint8_t* str, size_t length )
+	{
+		std::string out;
+		out.reserve( length );
+		for( size_t i = 0; i < length; ++i )
+		{
+			uint8_t c = str[ i ];
+			if( c < 0x80 )
+			{
+				out.push_back( static_cast< char >( c ) );
+			}
+			else
+			{
+				out.push_back( static_cast< char >( 0xc0 | ( c >> 6 ) ) );
+				out.push_back( static_cast< char >( 0x80 | ( c & 0x3f ) ) );
+			}
+		}
+		return out;
+	}
+}
+
+const uint16_t TypeLibReader::VtPtr;
+const uint16_t TypeLibReader::VtSafeArray;
+const uint16_t TypeLibReader::VtCArray;
+const uint16_t TypeLibReader::VtUserDefined;
+const uint16_t TypeLibReader::VtTypeMask;
+const uint16_t TypeLibReader::ParamFlagRetval;
+const uint16_t TypeLibReader::ParamFlagHasDefault;
+const uint16_t TypeLibReader::TypeFlagDual;
+
+bool TypeLibReader::Guid::operator==( const Guid& other ) const
+{
+	return data1 == other.data1 && data2 == other.data2 && data3 == other.data3 &&
+		memcmp( data4, other.data4, sizeof( data4 ) ) == 0;
+}
+
+std::string TypeLibReader::Guid::ToString() const
+{
+	char buffer[ 40 ];
+	snprintf( buffer, sizeof( buffer ),
+			"{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+			data1, data2, data3,
+			data4[ 0 ], data4[ 1 ], data4[ 2 ], data4[ 3 ],
+			data4[ 4 ], data4[ 5 ], data4[ 6 ], data4[ 7 ] );
+	return buffer;
+}
+
+TypeLibReader::TypeLibReader( const uint8_t* fileData, size_t fileSize )
+	: lcid( 0 ), majorVersion( 0 ), minorVersion( 0 ), syskind( 0 ), data( nullptr ), size( 0 ), dispatchHref( 0xffffffff )
+{
+	memset( &guid, 0, sizeof( guid ) );
+
+	// Locate the type library. DLLs embed it as a resource.
+	size_t start = FindTypeLib( fileData, fileSize );
+	data = fileData + start;
+	size = fileSize - start;
+
+	if( ReadUInt32( 0 ) == SltgMagic )
+		throw FormatError( "SLTG type libraries are not supported" );
+	if( ReadUInt32( 0 ) != MsftMagic )
+		throw FormatError( "Not a type library" );
+
+	Check( 0, HeaderSize );
+	int32_t varflags = ReadInt32( HeaderVarFlags );
+	int32_t typeInfoCount = ReadInt32( HeaderTypeInfoCount );
+	if( typeInfoCount < 0 )
+		throw FormatError( "Invalid type info count" );
+
+	syskind = static_cast< uint8_t >( varflags & 0x0f );
+	lcid = ReadUInt32( HeaderLcid );
+	uint32_t version = ReadUInt32( HeaderVersion );
+	majorVersion = static_cast< uint16_t >( version & 0xffff );
+	minorVersion = static_cast< uint16_t >( version >> 16 );
+	dispatchHref = ReadUInt32( HeaderDispatchPos );
+
+	// The segment directory follows the header and the type info offsets.
+	size_t segDir = HeaderSize + typeInfoCount * 4 + ( ( varflags & HelpDllFlag ) ? 4 : 0 );
+	Check( segDir, SegCount * SegmentEntrySize );
+	for( int i = 0; i < SegCount; ++i )
+	{
+		segments[ i ].offset = ReadInt32( segDir + i * SegmentEntrySize );
+		segments[ i ].length = ReadInt32( segDir + i * SegmentEntrySize + 4 );
+		if( segments[ i ].length > 0 )
+			Check( segments[ i ].offset, segments[ i ].length );
+	}
+
+	if( segments[ SegTypeInfo ].length < typeInfoCount * static_cast< int32_t >( TypeInfoSize ) )
+		throw FormatError( "Type info segment is truncated" );
+
+	name = ReadName( ReadInt32( HeaderNameOffset ) );
+	docString = ReadString( ReadInt32( HeaderHelpString ) );
+	guid = ReadGuid( ReadInt32( HeaderPosGuid ) );
+
+	ReadTypeDescs();
+
+	types.resize( typeInfoCount );
+	for( int32_t i = 0; i < typeInfoCount; ++i )
+		ReadTypeInfo( segments[ SegTypeInfo ].offset + i * TypeInfoSize, types[ i ] );
+}
+
+/**
+ * Finds the start of the type library data.
+ */
+size_t TypeLibReader::FindTypeLib( const uint8_t* data, size_t size )
+{
+	if( size < 4 )
+		throw FormatError( "Not a type library" );
+
+	// Bare type library.
+	if( data[ 0 ] != 'M' || data[ 1 ] != 'Z' )
+		return 0;
+
+	// PE image. The TYPELIB resource is raw MSFT data so look for the magic
+	// instead of walking the resource directory.
+	for( size_t offset = 0; offset + HeaderSize <= size; offset += 4 )
+	{
+		if( memcmp( data + offset, "MSFT", 4 ) == 0 && data[ offset + 4 ] == 0x02 && data[ offset + 6 ] == 0x01 )
+			return offset;
+	}
+
+	throw FormatError( "No type library found in the image" );
+}
+
+void TypeLibReader::Check( size_t offset, size_t length ) const
+{
+	if( offset > size || length > size - offset )
+		throw FormatError( "Unexpected end of type library" );
+}
+
+int16_t TypeLibReader::ReadInt16( size_t offset ) const
+{
+	Check( offset, 2 );
+	return static_cast< int16_t >( data[ offset ] | ( data[ offset + 1 ] << 8 ) );
+}
+
+int32_t TypeLibReader::ReadInt32( size_t offset ) const
+{
+	Check( offset, 4 );
+	return static_cast< int32_t >(
+			static_cast< uint32_t >( data[ offset ] ) |
+			( static_cast< uint32_t >( data[ offset + 1 ] ) << 8 ) |
+			( static_cast< uint32_t >( data[ offset + 2 ] ) << 16 ) |
+			( static_cast< uint32_t >( data[ offset + 3 ] ) << 24 ) );
+}
+
+/**
+ * Converts a segment relative offset into a data offset.
+ */
+size_t TypeLibReader::SegmentOffset( SegmentIndex segment, int32_t offset, size_t length ) const
+{
+	const Segment& seg = segments[ segment ];
+	if( offset < 0 || seg.length < 0 || static_cast< size_t >( offset ) + length > static_cast< size_t >( seg.length ) )
+		throw FormatError( "Offset outside of the segment" );
+
+	return seg.offset + offset;
+}
+
+std::string TypeLibReader::ReadName( int32_t offset ) const
+{
+	if( offset < 0 )
+		return std::string();
+
+	// MSFT_NameIntro: hreftype, next_hash, namelen. The low byte of namelen is the length.
+	size_t pos = SegmentOffset( SegName, offset, 12 );
+	size_t length = ReadInt32( pos + 8 ) & 0xff;
+	Check( pos + 12, length );
+	return Latin1ToUTF8( data + pos + 12, length );
+}
+
+std::string TypeLibReader::ReadString( int32_t offset ) const
+{
+	if( offset < 0 )
+		return std::string();
+
+	size_t pos = SegmentOffset( SegString, offset, 2 );
+	size_t length = ReadUInt16( pos );
+	Check( pos + 2, length );
+	return Latin1ToUTF8( data + pos + 2, length );
+}
+
+TypeLibReader::Guid TypeLibReader::ReadGuid( int32_t offset ) const
+{
+	Guid out;
+	memset( &out, 0, sizeof( out ) );
+	if( offset < 0 )
+		return out;
+
+	size_t pos = SegmentOffset( SegGuid, offset, 16 );
+	out.data1 = ReadUInt32( pos );
+	out.data2 = ReadUInt16( pos + 4 );
+	out.data3 = ReadUInt16( pos + 6 );
+	memcpy( out.data4, data + pos + 8, 8 );
+	return out;
+}
+
+/**
+ * Reads a constant value.
+ *
+ * Small values are packed into the offset itself. Others are stored in the
+ * custom data segment prefixed with their VARTYPE.
+ */
+TypeLibReader::Value TypeLibReader::ReadValue( int32_t offset ) const
+{
+	Value value;
+	if( offset < 0 )
+	{
+		value.vt = static_cast< uint16_t >( ( offset & 0x7c000000 ) >> 26 );
+		value.intValue = offset & 0x3ffffff;
+		value.realValue = static_cast< double >( value.intValue );
+		return value;
+	}
+
+	size_t pos = SegmentOffset( SegCustData, offset, 2 );
+	value.vt = ReadUInt16( pos );
+	pos += 2;
+
+	switch( value.vt )
+	{
+	case 2:  // VT_I2
+		value.intValue = ReadInt16( pos );
+		break;
+	case 16:  // VT_I1
+		Check( pos, 1 );
+		value.intValue = static_cast< int8_t >( data[ pos ] );
+		break;
+	case 17:  // VT_UI1
+		Check( pos, 1 );
+		value.intValue = data[ pos ];
+		break;
+	case 18:  // VT_UI2
+		value.intValue = ReadUInt16( pos );
+		break;
+	case 3:  // VT_I4
+	case 10:  // VT_ERROR
+	case 22:  // VT_INT
+	case 25:  // VT_HRESULT
+		value.intValue = ReadInt32( pos );
+		break;
+	case 11:  // VT_BOOL
+		value.intValue = ReadInt16( pos ) != 0 ? 1 : 0;
+		break;
+	case 19:  // VT_UI4
+	case 23:  // VT_UINT
+		value.intValue = ReadUInt32( pos );
+		break;
+	case 20:  // VT_I8
+	case 21:  // VT_UI8
+	case 6:  // VT_CY
+		value.intValue = static_cast< int64_t >(
+				static_cast< uint64_t >( ReadUInt32( pos ) ) |
+				( static_cast< uint64_t >( ReadUInt32( pos + 4 ) ) << 32 ) );
+		break;
+	case 4:  // VT_R4
+	{
+		uint32_t bits = ReadUInt32( pos );
+		float f;
+		memcpy( &f, &bits, sizeof( f ) );
+		value.realValue = f;
+		break;
+	}
+	case 5:  // VT_R8
+	case 7:  // VT_DATE
+	{
+		uint64_t bits = static_cast< uint64_t >( ReadUInt32( pos ) ) |
+			( static_cast< uint64_t >( ReadUInt32( pos + 4 ) ) << 32 );
+		double d;
+		memcpy( &d, &bits, sizeof( d ) );
+		value.realValue = d;
+		break;
+	}
+	case VtBstr:
+	{
+		int32_t length = ReadInt32( pos );
+		if( length > 0 )
+		{
+			Check( pos + 4, length );
+			value.stringValue = Latin1ToUTF8( data + pos + 4, length );
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	if( value.realValue == 0 && value.intValue != 0 )
+		value.realValue = static_cast< double >( value.intValue );
+
+	return value;
+}
+
+/**
+ * Decodes a type description.
+ *
+ * Negative values encode a simple VARTYPE directly. Others are offsets into
+ * the type description segment.
+ */
+TypeLibReader::TypeDesc TypeLibReader::GetTypeDesc( int32_t encoded ) const
+{
+	if( encoded < 0 )
+	{
+		TypeDesc desc;
+		desc.vt = static_cast< uint16_t >( encoded & VtTypeMask );
+		return desc;
+	}
+
+	size_t index = encoded / 8;
+	if( index >= typeDescs.size() )
+		throw FormatError( "Invalid type description" );
+
+	return typeDescs[ index ];
+}
+
+/**
+ * Reads the type description segment.
+ *
+ * Entries are four 16-bit words: vt, flags and two words of data. Pointer
+ * entries refer either to a simple VARTYPE or to another entry.
+ */
+void TypeLibReader::ReadTypeDescs()
+{
+	const Segment& seg = segments[ SegTypeDesc ];
+	if( seg.length <= 0 )
+		return;
+
+	size_t count = seg.length / 8;
+	std::vector< int16_t > raw( count * 4 );
+	for( size_t i = 0; i < raw.size(); ++i )
+		raw[ i ] = ReadInt16( seg.offset + i * 2 );
+
+	// Pointers may refer to entries later in the table so allocate all of them first.
+	std::vector< std::shared_ptr< TypeDesc > > descs( count );
+	for( size_t i = 0; i < count; ++i )
+		descs[ i ] = std::make_shared< TypeDesc >();
+
+	for( size_t i = 0; i < count; ++i )
+	{
+		const int16_t* td = &raw[ i * 4 ];
+		TypeDesc& desc = *descs[ i ];
+		desc.vt = static_cast< uint16_t >( td[ 0 ] & VtTypeMask );
+
+		if( desc.vt == VtPtr || desc.vt == VtSafeArray )
+		{
+			if( td[ 3 ] < 0 )
+			{
+				auto simple = std::make_shared< TypeDesc >();
+				simple->vt = static_cast< uint16_t >( td[ 2 ] & VtTypeMask );
+				desc.pointee = simple;
+			}
+			else
+			{
+				size_t target = static_cast< uint16_t >( td[ 2 ] ) / 8;
+				if( target >= count )
+					throw FormatError( "Invalid pointer type description" );
+				desc.pointee = descs[ target ];
+			}
+		}
+		else if( desc.vt == VtUserDefined )
+		{
+			desc.hreftype = static_cast< uint32_t >( static_cast< uint16_t >( td[ 2 ] ) ) |
+				( static_cast< uint32_t >( static_cast< uint16_t >( td[ 3 ] ) ) << 16 );
+		}
+		else if( desc.vt == VtCArray )
+		{
+			// MSFT_ArrayDesc starts with the element type.
+			int32_t arrayOffset = static_cast< uint16_t >( td[ 2 ] );
+			size_t pos = SegmentOffset( SegArrayDesc, arrayOffset, 4 );
+			int32_t elementType = ReadInt32( pos );
+			if( elementType < 0 )
+			{
+				auto simple = std::make_shared< TypeDesc >();
+				simple->vt = static_cast< uint16_t >( elementType & VtTypeMask );
+				desc.pointee = simple;
+			}
+			else if( static_cast< size_t >( elementType / 8 ) < count )
+			{
+				desc.pointee = descs[ elementType / 8 ];
+			}
+		}
+	}
+
+	// The pointees share the entries so the copies see the whole chain.
+	typeDescs.resize( count );
+	for( size_t i = 0; i < count; ++i )
+		typeDescs[ i ] = *descs[ i ];
+}
+
+void TypeLibReader::ReadTypeInfo( size_t offset, TypeInfo& type )
+{
+	Check( offset, TypeInfoSize );
+
+	int32_t kind = ReadInt32( offset + TypeInfoKind );
+	type.typekind = static_cast< TypeKind >( kind & 0x0f );
+	type.alignment = static_cast< uint16_t >( ( kind >> 11 ) & 0x1f );
+
+	uint32_t version = ReadUInt32( offset + TypeInfoVersion );
+	type.majorVersion = static_cast< uint16_t >( version & 0xffff );
+	type.minorVersion = static_cast< uint16_t >( version >> 16 );
+
+	type.name = ReadName( ReadInt32( offset + TypeInfoName ) );
+	type.docString = ReadString( ReadInt32( offset + TypeInfoDocString ) );
+	type.guid = ReadGuid( ReadInt32( offset + TypeInfoPosGuid ) );
+	type.flags = static_cast< uint16_t >( ReadInt32( offset + TypeInfoFlags ) );
+	type.cbSizeVft = ReadUInt16( offset + TypeInfoSizeVft );
+	type.cbSizeInstance = ReadUInt32( offset + TypeInfoInstanceSize );
+
+	int32_t elements = ReadInt32( offset + TypeInfoElements );
+	int cFuncs = elements & 0xffff;
+	int cVars = ( elements >> 16 ) & 0xffff;
+	if( cFuncs > 0 || cVars > 0 )
+		ReadMembers( ReadInt32( offset + TypeInfoMemOffset ), cFuncs, cVars, type );
+
+	int16_t cImplTypes = ReadInt16( offset + TypeInfoImplTypes );
+	int32_t dataType1 = ReadInt32( offset + TypeInfoDataType1 );
+	switch( type.typekind )
+	{
+	case TkCoclass:
+	{
+		// Implemented interfaces are a linked list in the reference table.
+		int32_t refOffset = dataType1;
+		for( int16_t i = 0; i < cImplTypes && refOffset >= 0; ++i )
+		{
+			size_t pos = SegmentOffset( SegRefTab, refOffset, RefRecordSize );
+			ImplType impl;
+			impl.hreftype = ReadUInt32( pos );
+			impl.flags = ReadInt32( pos + 4 );
+			type.implTypes.push_back( impl );
+			refOffset = ReadInt32( pos + 12 );
+		}
+		break;
+	}
+
+	case TkDispatch:
+	{
+		// Pure dispinterfaces implement IDispatch.
+		ImplType impl;
+		impl.hreftype = dataType1 != -1 ? static_cast< uint32_t >( dataType1 ) : dispatchHref;
+		if( impl.hreftype != 0xffffffff )
+			type.implTypes.push_back( impl );
+		break;
+	}
+
+	case TkAlias:
+		type.aliasType = GetTypeDesc( dataType1 );
+		break;
+
+	default:
+		if( dataType1 != -1 )
+		{
+			ImplType impl;
+			impl.hreftype = static_cast< uint32_t >( dataType1 );
+			type.implTypes.push_back( impl );
+		}
+		break;
+	}
+}
+
+/**
+ * Reads the functions and variables of a type.
+ *
+ * The member block starts with its length followed by the records. After the
+ * records are three arrays indexed by member: memids, name offsets and record
+ * offsets.
+ */
+void TypeLibReader::ReadMembers( size_t offset, int cFuncs, int cVars, TypeInfo& type )
+{
+	int32_t infoLength = ReadInt32( offset );
+	if( infoLength < 0 )
+		throw FormatError( "Invalid member block" );
+
+	size_t arrays = offset + infoLength + 4;
+	int cMembers = cFuncs + cVars;
+	Check( arrays, cMembers * 3 * 4 );
+
+	size_t recordOffset = offset + 4;
+	type.funcs.resize( cFuncs );
+	for( int i = 0; i < cFuncs; ++i )
+	{
+		FuncInfo& func = type.funcs[ i ];
+
+		size_t recordLength = ReadInt32( recordOffset ) & 0xffff;
+		Check( recordOffset, recordLength );
+
+		int16_t cParams = ReadInt16( recordOffset + FuncArgCount );
+		int32_t kindFlags = ReadInt32( recordOffset + FuncKind );
+		if( cParams < 0 )
+			throw FormatError( "Invalid parameter count" );
+
+		func.memid = ReadInt32( arrays + i * 4 );
+		func.funckind = static_cast< uint8_t >( kindFlags & 0x7 );
+		func.invkind = static_cast< uint8_t >( ( kindFlags >> 3 ) & 0xf );
+		func.callconv = static_cast< uint8_t >( ( kindFlags >> 8 ) & 0xf );
+		func.oVft = static_cast< int16_t >( ReadInt16( recordOffset + FuncVtableOffset ) & ~1 );
+		func.flags = static_cast< uint16_t >( ReadInt32( recordOffset + FuncFlags ) & 0xffff );
+		func.cParamsOpt = ReadInt16( recordOffset + FuncOptArgCount );
+		func.returnType = GetTypeDesc( ReadInt32( recordOffset + FuncDataType ) );
+
+		// The second half of a property get/put pair might share the name of the first.
+		int32_t nameOffset = ReadInt32( arrays + ( cMembers + i ) * 4 );
+		if( nameOffset == -1 && i > 0 )
+			func.name = type.funcs[ i - 1 ].name;
+		else
+			func.name = ReadName( nameOffset );
+
+		// Parameter infos are at the end of the record, preceded by the default values.
+		size_t paramOffset = recordOffset + recordLength - cParams * ParamInfoSize;
+		size_t defaultOffset = paramOffset - cParams * 4;
+		Check( paramOffset, cParams * ParamInfoSize );
+
+		func.params.resize( cParams );
+		for( int16_t p = 0; p < cParams; ++p )
+		{
+			ParamInfo& param = func.params[ p ];
+			size_t pos = paramOffset + p * ParamInfoSize;
+
+			param.type = GetTypeDesc( ReadInt32( pos ) );
+			param.name = ReadName( ReadInt32( pos + 4 ) );
+			param.flags = static_cast< uint16_t >( ReadInt32( pos + 8 ) );
+
+			if( ( param.flags & ParamFlagHasDefault ) && ( kindFlags & FuncHasDefaults ) )
+			{
+				param.hasDefault = true;
+				param.defaultValue = ReadValue( ReadInt32( defaultOffset + p * 4 ) );
+			}
+		}
+
+		recordOffset += recordLength;
+	}
+
+	type.vars.resize( cVars );
+	for( int i = 0; i < cVars; ++i )
+	{
+		VarInfo& var = type.vars[ i ];
+		int member = cFuncs + i;
+
+		size_t pos = offset + 4 + ReadInt32( arrays + ( cMembers * 2 + member ) * 4 );
+		Check( pos, VarOffsValue + 4 );
+
+		var.memid = ReadInt32( arrays + member * 4 );
+		var.name = ReadName( ReadInt32( arrays + ( cMembers + member ) * 4 ) );
+		var.type = GetTypeDesc( ReadInt32( pos + VarDataType ) );
+		var.varkind = ReadUInt16( pos + VarKind );
+		var.flags = static_cast< uint16_t >( ReadInt32( pos + VarFlags ) );
+
+		if( var.varkind == VarConst )
+		{
+			var.hasValue = true;
+			var.value = ReadValue( ReadInt32( pos + VarOffsValue ) );
+		}
+	}
+}
+
+/**
+ * Resolves the HREFTYPE.
+ *
+ * References within the library are offsets into the type info table.
+ * References to other libraries have the low bits set and point into the
+ * import info table.
+ */
+TypeLibReader::TypeRef TypeLibReader::ResolveRef( uint32_t hreftype ) const
+{
+	TypeRef ref;
+	if( ( hreftype & 3 ) == 0 )
+	{
+		size_t index = hreftype / TypeInfoSize;
+		if( index >= types.size() )
+			throw FormatError( "Invalid HREFTYPE" );
+
+		ref.local = true;
+		ref.index = static_cast< int32_t >( index );
+		ref.guid = types[ index ].guid;
+		ref.hasGuid = true;
+		return ref;
+	}
+
+	size_t pos = SegmentOffset( SegImpInfo, static_cast< int32_t >( hreftype & ~3u ), 12 );
+	int32_t flags = ReadInt32( pos );
+	int32_t impFile = ReadInt32( pos + 4 );
+	int32_t target = ReadInt32( pos + 8 );
+
+	if( flags & ImpInfoOffsetIsGuid )
+	{
+		ref.hasGuid = true;
+		ref.guid = ReadGuid( target );
+	}
+	else
+	{
+		ref.index = target;
+	}
+
+	// MSFT_ImpFile: guid, lcid, version, length << 2, name.
+	size_t filePos = SegmentOffset( SegImpFiles, impFile, 14 );
+	size_t nameLength = ReadUInt16( filePos + 12 ) >> 2;
+	Check( filePos + 14, nameLength );
+	ref.importFile = Latin1ToUTF8( data + filePos + 14, nameLength );
+
+	return ref;
+}
+
+/**
+ * Returns the local type the HREFTYPE refers to or null for external types.
+ */
+const TypeLibReader::TypeInfo* TypeLibReader::GetRefType( uint32_t hreftype ) const
+{
+	TypeRef ref = ResolveRef( hreftype );
+	if( !ref.local )
+		return nullptr;
+
+	return &types[ ref.index ];
+}
+
+/**
+ * Converts a dual interface function into the form it has on the dispinterface.
+ *
+ * Dual interfaces are stored with their vtable signatures. Through IDispatch
+ * the [retval] parameter becomes the return value and the HRESULT disappears.
+ */
+TypeLibReader::FuncInfo TypeLibReader::ToDispatch( const FuncInfo& func )
+{
+	FuncInfo out = func;
+	out.funckind = FuncDispatch;
+	out.callconv = CallConvStdcall;
+
+	if( !out.params.empty() &&
+		( out.params.back().flags & ParamFlagRetval ) &&
+		out.params.back().type.vt == VtPtr &&
+		out.params.back().type.pointee )
+	{
+		out.returnType = *out.params.back().type.pointee;
+		out.params.pop_back();
+	}
+	else
+	{
+		out.returnType = TypeDesc();
+		out.returnType.vt = VtVoid;
+	}
+
+	return out;
+}
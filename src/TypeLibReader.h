@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Standalone reader for the binary MSFT type library format.
+ *
+ * Extracts the same type, function, parameter and HREFTYPE information that
+ * InteropType::Init reads through ITypeInfo. The reader does not depend on
+ * oleaut32, COM or V8 so the metadata can be processed on any platform.
+ *
+ * All the multi-byte values in the format are little endian.
+ */
+class TypeLibReader
+{
+public:
+
+	// VARTYPE values needed for interpreting the type descriptions.
+	static const uint16_t VtPtr = 26;
+	static const uint16_t VtSafeArray = 27;
+	static const uint16_t VtCArray = 28;
+	static const uint16_t VtUserDefined = 29;
+	static const uint16_t VtTypeMask = 0x0fff;
+
+	// TYPEKIND values.
+	enum TypeKind
+	{
+		TkEnum = 0, TkRecord, TkModule, TkInterface, TkDispatch, TkCoclass, TkAlias, TkUnion
+	};
+
+	// PARAMFLAG_FRETVAL and PARAMFLAG_FHASDEFAULT.
+	static const uint16_t ParamFlagRetval = 0x08;
+	static const uint16_t ParamFlagHasDefault = 0x20;
+
+	// TYPEFLAG_FDUAL
+	static const uint16_t TypeFlagDual = 0x40;
+
+	struct Guid
+	{
+		uint32_t data1;
+		uint16_t data2;
+		uint16_t data3;
+		uint8_t data4[ 8 ];
+
+		bool operator==( const Guid& other ) const;
+		bool operator!=( const Guid& other ) const { return !( *this == other ); }
+		std::string ToString() const;
+	};
+
+	/**
+	 * TYPEDESC equivalent.
+	 */
+	struct TypeDesc
+	{
+		TypeDesc() : vt( 0 ), hreftype( 0 ) {}
+
+		uint16_t vt;
+
+		// VT_USERDEFINED target.
+		uint32_t hreftype;
+
+		// VT_PTR / VT_SAFEARRAY / VT_CARRAY element type.
+		std::shared_ptr< const TypeDesc > pointee;
+	};
+
+	/**
+	 * Constant value such as a parameter default or an enum member.
+	 */
+	struct Value
+	{
+		Value() : vt( 0 ), intValue( 0 ), realValue( 0 ) {}
+
+		uint16_t vt;
+		int64_t intValue;
+		double realValue;
+		std::string stringValue;
+	};
+
+	/**
+	 * ELEMDESC/PARAMDESC equivalent.
+	 */
+	struct ParamInfo
+	{
+		ParamInfo() : flags( 0 ), hasDefault( false ) {}
+
+		std::string name;
+		TypeDesc type;
+		uint16_t flags;
+		bool hasDefault;
+		Value defaultValue;
+	};
+
+	/**
+	 * FUNCDESC equivalent.
+	 */
+	struct FuncInfo
+	{
+		FuncInfo() : memid( 0 ), funckind( 0 ), invkind( 0 ), callconv( 0 ), oVft( 0 ), flags( 0 ), cParamsOpt( 0 ) {}
+
+		std::string name;
+		int32_t memid;
+		uint8_t funckind;
+		uint8_t invkind;
+		uint8_t callconv;
+		int16_t oVft;
+		uint16_t flags;
+		int16_t cParamsOpt;
+
+		TypeDesc returnType;
+		std::vector< ParamInfo > params;
+	};
+
+	/**
+	 * VARDESC equivalent.
+	 */
+	struct VarInfo
+	{
+		VarInfo() : memid( 0 ), varkind( 0 ), flags( 0 ), hasValue( false ) {}
+
+		std::string name;
+		int32_t memid;
+		uint16_t varkind;
+		uint16_t flags;
+		TypeDesc type;
+
+		// Set for VAR_CONST members such as enum values.
+		bool hasValue;
+		Value value;
+	};
+
+	/**
+	 * Implemented interface.
+	 */
+	struct ImplType
+	{
+		ImplType() : hreftype( 0 ), flags( 0 ) {}
+
+		uint32_t hreftype;
+		int32_t flags;
+	};
+
+	/**
+	 * TYPEATTR equivalent with the members.
+	 */
+	struct TypeInfo
+	{
+		TypeInfo() : typekind( TkEnum ), flags( 0 ), majorVersion( 0 ), minorVersion( 0 ),
+			alignment( 0 ), cbSizeVft( 0 ), cbSizeInstance( 0 ) {}
+
+		std::string name;
+		std::string docString;
+		Guid guid;
+		TypeKind typekind;
+		uint16_t flags;
+		uint16_t majorVersion;
+		uint16_t minorVersion;
+		uint16_t alignment;
+		uint16_t cbSizeVft;
+		uint32_t cbSizeInstance;
+
+		std::vector< FuncInfo > funcs;
+		std::vector< VarInfo > vars;
+		std::vector< ImplType > implTypes;
+
+		// TKIND_ALIAS target.
+		TypeDesc aliasType;
+	};
+
+	/**
+	 * HREFTYPE resolved against this library.
+	 */
+	struct TypeRef
+	{
+		TypeRef() : local( false ), index( -1 ), hasGuid( false ), guid() {}
+
+		// Local references point to types in this library.
+		bool local;
+		int32_t index;
+
+		// External references are identified by GUID or by the index in the imported library.
+		bool hasGuid;
+		Guid guid;
+		std::string importFile;
+	};
+
+	/**
+	 * Parse error.
+	 */
+	class FormatError : public std::runtime_error
+	{
+	public:
+		FormatError( const std::string& msg ) : std::runtime_error( msg ) {}
+	};
+
+	/**
+	 * Parses the type library. The data must stay alive while the reader is used.
+	 *
+	 * Accepts both bare .tlb files and PE images with an embedded type library.
+	 * Throws FormatError if the data isn't a supported type library.
+	 */
+	TypeLibReader( const uint8_t* data, size_t size );
+
+	std::string name;
+	std::string docString;
+	Guid guid;
+	uint32_t lcid;
+	uint16_t majorVersion;
+	uint16_t minorVersion;
+
+	// SYSKIND. The vtable offsets are in the pointer size of the platform.
+	uint8_t syskind;
+	size_t PointerSize() const { return syskind == 3 ? 8 : 4; }
+
+	std::vector< TypeInfo > types;
+
+	TypeRef ResolveRef( uint32_t hreftype ) const;
+	const TypeInfo* GetRefType( uint32_t hreftype ) const;
+
+	static FuncInfo ToDispatch( const FuncInfo& func );
+
+private:
+
+	struct Segment
+	{
+		int32_t offset;
+		int32_t length;
+	};
+
+	enum SegmentIndex
+	{
+		SegTypeInfo = 0, SegImpInfo, SegImpFiles, SegRefTab, SegGuidHash, SegGuid,
+		SegNameHash, SegName, SegString, SegTypeDesc, SegArrayDesc, SegCustData,
+		SegCDGuids, SegRes0e, SegRes0f, SegCount
+	};
+
+	const uint8_t* data;
+	size_t size;
+	Segment segments[ SegCount ];
+	std::vector< TypeDesc > typeDescs;
+	uint32_t dispatchHref;
+
+	static size_t FindTypeLib( const uint8_t* data, size_t size );
+
+	void Check( size_t offset, size_t length ) const;
+	int16_t ReadInt16( size_t offset ) const;
+	int32_t ReadInt32( size_t offset ) const;
+	uint16_t ReadUInt16( size_t offset ) const { return static_cast< uint16_t >( ReadInt16( offset ) ); }
+	uint32_t ReadUInt32( size_t offset ) const { return static_cast< uint32_t >( ReadInt32( offset ) ); }
+	size_t SegmentOffset( SegmentIndex segment, int32_t offset, size_t length ) const;
+
+	std::string ReadName( int32_t offset ) const;
+	std::string ReadString( int32_t offset ) const;
+	Guid ReadGuid( int32_t offset ) const;
+	Value ReadValue( int32_t offset ) const;
+	TypeDesc GetTypeDesc( int32_t encoded ) const;
+
+	void ReadTypeDescs();
+	void ReadTypeInfo( size_t offset, TypeInfo& type );
+	void ReadMembers( size_t offset, int cFuncs, int cVars, TypeInfo& type );
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// Calling convention attributes for the conventions that aren't the
+// default of the compiler.
+#if defined( _MSC_VER )
+#define VTABLE_FRAME_WIN64
+#else
+#define VTABLE_FRAME_WIN64 __attribute__(( ms_abi ))
+#define VTABLE_FRAME_SYSV __attribute__(( sysv_abi ))
+#endif
+
+// Defined where VtableFrame::Native matches the vtables of the process.
+// Other targets fall back to IDispatch.
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define VTABLE_FRAME_NATIVE
+#endif
+
+/**
+ * Native arguments of a vtable call, laid out for one calling convention.
+ *
+ * The arguments are added in declaration order after the this pointer and
+ * go to the registers and stack slots the convention assigns to the slot's
+ * prototype. The call then goes through a fixed prototype that loads the
+ * same registers and stack slots. A float is passed in the low half of a
+ * floating point register or stack slot, which is where the callee reads
+ * it. Both conventions have the caller pop the arguments, so the unused
+ * trailing slots of the fixed prototype are harmless.
+ *
+ * Does not depend on COM. DirectCall fills the frame from the VARIANTs.
+ */
+namespace VtableFrame
+{
+	// Arguments after the this pointer.
+	const size_t MaxArgs = 16;
+
+	template< size_t, typename T > using Repeat = T;
+
+	inline uint64_t RealBits( double value )
+	{
+		uint64_t bits;
+		memcpy( &bits, &value, sizeof( bits ) );
+		return bits;
+	}
+
+	inline uint64_t SingleBits( float value )
+	{
+		uint32_t bits;
+		memcpy( &bits, &value, sizeof( bits ) );
+		return bits;
+	}
+
+	inline double BitsAsReal( uint64_t bits )
+	{
+		double value;
+		memcpy( &value, &bits, sizeof( value ) );
+		return value;
+	}
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+
+	/**
+	 * Win64: the first four arguments by position in RCX/RDX/R8/R9 or
+	 * XMM0-3, the rest in 8 byte stack slots.
+	 */
+	class Win64
+	{
+	public:
+		Win64() : count( 0 ), realMask( 0 ), integers(), reals(), stack() {}
+
+		void AddInteger( uint64_t value ) { Add( value, false ); }
+		void AddReal( double value ) { Add( RealBits( value ), true ); }
+		void AddSingle( float value ) { Add( SingleBits( value ), true ); }
+
+		size_t Count() const { return count; }
+
+		template< typename Result >
+		Result Call( void* fn, void* self ) const
+		{
+			switch( realMask )
+			{
+			case 0: return CallWith< Result, uint64_t, uint64_t, uint64_t >( fn, self );
+			case 1: return CallWith< Result, double, uint64_t, uint64_t >( fn, self );
+			case 2: return CallWith< Result, uint64_t, double, uint64_t >( fn, self );
+			case 3: return CallWith< Result, double, double, uint64_t >( fn, self );
+			case 4: return CallWith< Result, uint64_t, uint64_t, double >( fn, self );
+			case 5: return CallWith< Result, double, uint64_t, double >( fn, self );
+			case 6: return CallWith< Result, uint64_t, double, double >( fn, self );
+			default: return CallWith< Result, double, double, double >( fn, self );
+			}
+		}
+
+	private:
+		// The this pointer takes the first register.
+		static const size_t Registers = 3;
+		static const size_t StackSlots = MaxArgs - Registers;
+
+		void Add( uint64_t bits, bool real )
+		{
+			if( count < Registers )
+			{
+				if( real )
+				{
+					reals[ count ] = BitsAsReal( bits );
+					realMask |= 1u << count;
+				}
+				else
+				{
+					integers[ count ] = bits;
+				}
+			}
+			else if( count < MaxArgs )
+			{
+				stack[ count - Registers ] = bits;
+			}
+			count++;
+		}
+
+		template< typename T > T Register( size_t i ) const;
+
+		template< typename Result, typename A1, typename A2, typename A3 >
+		Result CallWith( void* fn, void* self ) const
+		{
+			return CallWith< Result, A1, A2, A3 >( fn, self, std::make_index_sequence< StackSlots >() );
+		}
+
+		template< typename Result, typename A1, typename A2, typename A3, size_t... S >
+		Result CallWith( void* fn, void* self, std::index_sequence< S... > ) const
+		{
+			typedef Result ( VTABLE_FRAME_WIN64 *Fn )( void*, A1, A2, A3, Repeat< S, uint64_t >... );
+			return reinterpret_cast< Fn >( fn )(
+					self, Register< A1 >( 0 ), Register< A2 >( 1 ), Register< A3 >( 2 ), stack[ S ]... );
+		}
+
+		size_t count;
+		unsigned realMask;
+		uint64_t integers[ Registers ];
+		double reals[ Registers ];
+		uint64_t stack[ StackSlots ];
+	};
+
+	template<> inline uint64_t Win64::Register< uint64_t >( size_t i ) const { return integers[ i ]; }
+	template<> inline double Win64::Register< double >( size_t i ) const { return reals[ i ]; }
+
+#endif
+
+#if defined( __x86_64__ )
+
+	/**
+	 * System V: integers in RDI/RSI/RDX/RCX/R8/R9 and floating point values
+	 * in XMM0-7, each class in its own order. The arguments that don't fit
+	 * go to 8 byte stack slots in declaration order.
+	 */
+	class SysV
+	{
+	public:
+		SysV() : count( 0 ), integerCount( 0 ), realCount( 0 ), stackCount( 0 ), integers(), reals(), stack() {}
+
+		void AddInteger( uint64_t value )
+		{
+			if( integerCount < IntegerRegisters )
+				integers[ integerCount++ ] = value;
+			else
+				Spill( value );
+			count++;
+		}
+
+		void AddReal( double value ) { AddFloating( RealBits( value ) ); }
+		void AddSingle( float value ) { AddFloating( SingleBits( value ) ); }
+
+		size_t Count() const { return count; }
+
+		template< typename Result >
+		Result Call( void* fn, void* self ) const
+		{
+			return CallWith< Result >( fn, self,
+					std::make_index_sequence< IntegerRegisters >(),
+					std::make_index_sequence< RealRegisters >(),
+					std::make_index_sequence< StackSlots >() );
+		}
+
+	private:
+		// The this pointer takes the first integer register.
+		static const size_t IntegerRegisters = 5;
+		static const size_t RealRegisters = 8;
+		static const size_t StackSlots = MaxArgs - IntegerRegisters;
+
+		void AddFloating( uint64_t bits )
+		{
+			if( realCount < RealRegisters )
+				reals[ realCount++ ] = BitsAsReal( bits );
+			else
+				Spill( bits );
+			count++;
+		}
+
+		void Spill( uint64_t bits )
+		{
+			if( stackCount < StackSlots )
+				stack[ stackCount++ ] = bits;
+		}
+
+		template< typename Result, size_t... I, size_t... R, size_t... S >
+		Result CallWith( void* fn, void* self, std::index_sequence< I... >, std::index_sequence< R... >, std::index_sequence< S... > ) const
+		{
+			typedef Result ( VTABLE_FRAME_SYSV *Fn )( void*, Repeat< I, uint64_t >..., Repeat< R, double >..., Repeat< S, uint64_t >... );
+			return reinterpret_cast< Fn >( fn )( self, integers[ I ]..., reals[ R ]..., stack[ S ]... );
+		}
+
+		size_t count;
+		size_t integerCount;
+		size_t realCount;
+		size_t stackCount;
+		uint64_t integers[ IntegerRegisters ];
+		double reals[ RealRegisters ];
+		uint64_t stack[ StackSlots ];
+	};
+
+#endif
+
+	// The convention of the vtables in this process.
+#if defined( _WIN64 ) && defined( VTABLE_FRAME_NATIVE )
+	typedef Win64 Native;
+#elif defined( VTABLE_FRAME_NATIVE )
+	typedef SysV Native;
+#endif
+}
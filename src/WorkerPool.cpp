@@ -0,0 +1,214 @@
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool( size_t threadCount, Callback threadInit, Callback threadExit, Callback notify )
+	: threadInit( threadInit ), threadExit( threadExit ), notify( notify ), stopping( false ),
+	pending( 0 ), active( 0 ), next( 0 ), submitted( 0 ), completedCount( 0 ), stolen( 0 ),
+	completed( nullptr ), started( std::chrono::steady_clock::now() )
+{
+	if( threadCount == 0 )
+		threadCount = 1;
+
+	// Create all the queues before the threads start stealing from them.
+	for( size_t i = 0; i < threadCount; ++i )
+		workers.push_back( std::unique_ptr< Worker >( new Worker() ) );
+
+	for( size_t i = 0; i < threadCount; ++i )
+		workers[ i ]->thread = std::thread( &WorkerPool::Run, this, i );
+}
+
+/**
+ * Executes the queued tasks and stops the threads.
+ *
+ * The tasks that haven't been completed are released without Complete.
+ */
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard< std::mutex > lock( wakeMutex );
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for( auto&& worker : workers )
+		worker->thread.join();
+
+	for( Task* task = completed.exchange( nullptr ); task != nullptr; )
+	{
+		Task* next = task->nextCompleted;
+		task->Release();
+		task = next;
+	}
+
+	for( auto&& task : ready )
+		task->Release();
+}
+
+void WorkerPool::Submit( Task* task )
+{
+	submitted++;
+
+	// The task is queued and counted under the same lock. A worker that takes
+	// it right away can't decrement pending before it was incremented.
+	Worker& worker = *workers[ next++ % workers.size() ];
+	{
+		std::lock_guard< std::mutex > wakeLock( wakeMutex );
+		std::lock_guard< std::mutex > lock( worker.mutex );
+		worker.queue.push_back( task );
+		pending++;
+	}
+	wake.notify_one();
+}
+
+void WorkerPool::ExecuteInline( Task* task )
+{
+	submitted++;
+	task->Execute();
+	Finish( task );
+}
+
+size_t WorkerPool::RunCompleted( std::chrono::nanoseconds budget )
+{
+	// Take the whole list. The next task to finish notifies again.
+	Task* taken = completed.exchange( nullptr, std::memory_order_acquire );
+
+	// The list is newest first. Reverse it to complete in the finishing order.
+	Task* oldest = nullptr;
+	while( taken != nullptr )
+	{
+		Task* next = taken->nextCompleted;
+		taken->nextCompleted = oldest;
+		oldest = taken;
+		taken = next;
+	}
+
+	for( ; oldest != nullptr; oldest = oldest->nextCompleted )
+		ready.push_back( oldest );
+
+	auto deadline = std::chrono::steady_clock::now() + budget;
+	size_t count = 0;
+	while( !ready.empty() )
+	{
+		std::unique_ptr< Task, TaskRelease > owned( ready.front() );
+		ready.pop_front();
+		owned->Complete();
+		count++;
+
+		if( budget > std::chrono::nanoseconds::zero() && std::chrono::steady_clock::now() >= deadline )
+			break;
+	}
+
+	return count;
+}
+
+bool WorkerPool::HasCompleted() const
+{
+	return !ready.empty() || completed.load( std::memory_order_relaxed ) != nullptr;
+}
+
+WorkerPool::Stats WorkerPool::GetStats() const
+{
+	Stats stats;
+	stats.threads = workers.size();
+	stats.queued = pending;
+	stats.active = active;
+	stats.submitted = submitted;
+	stats.completed = completedCount;
+	stats.stolen = stolen;
+
+	uint64_t busyTime = 0;
+	for( auto&& worker : workers )
+		busyTime += worker->busyTime;
+
+	uint64_t elapsed = static_cast< uint64_t >( std::chrono::duration_cast< std::chrono::nanoseconds >(
+			std::chrono::steady_clock::now() - started ).count() );
+	stats.utilization = elapsed == 0 ? 0 :
+			static_cast< double >( busyTime ) / ( static_cast< double >( elapsed ) * workers.size() );
+
+	return stats;
+}
+
+void WorkerPool::Run( size_t index )
+{
+	if( threadInit )
+		threadInit();
+
+	Worker& worker = *workers[ index ];
+	for( ;; )
+	{
+		Task* task = Take( index );
+		if( task == nullptr )
+		{
+			// Sleep until there is work. Queued tasks are finished before stopping.
+			std::unique_lock< std::mutex > lock( wakeMutex );
+			wake.wait( lock, [ this ]() { return stopping || pending > 0; } );
+			if( stopping && pending == 0 )
+				break;
+			continue;
+		}
+
+		active++;
+		auto start = std::chrono::steady_clock::now();
+		task->Execute();
+		worker.busyTime += static_cast< uint64_t >( std::chrono::duration_cast< std::chrono::nanoseconds >(
+				std::chrono::steady_clock::now() - start ).count() );
+		active--;
+
+		Finish( task );
+	}
+
+	if( threadExit )
+		threadExit();
+}
+
+/**
+ * Pushes the executed task to the completed list.
+ */
+void WorkerPool::Finish( Task* task )
+{
+	completedCount++;
+
+	Task* head = completed.load( std::memory_order_relaxed );
+	do
+		task->nextCompleted = head;
+	while( !completed.compare_exchange_weak( head, task, std::memory_order_release, std::memory_order_relaxed ) );
+
+	// The owner has taken everything up to the empty list. Only the first
+	// task after that needs to wake it.
+	if( head == nullptr && notify )
+		notify();
+}
+
+/**
+ * Takes a task from the worker's own queue or steals one from the others.
+ */
+WorkerPool::Task* WorkerPool::Take( size_t index )
+{
+	Task* task = nullptr;
+	{
+		Worker& own = *workers[ index ];
+		std::lock_guard< std::mutex > lock( own.mutex );
+		if( !own.queue.empty() )
+		{
+			task = own.queue.front();
+			own.queue.pop_front();
+		}
+	}
+
+	for( size_t i = 1; task == nullptr && i < workers.size(); ++i )
+	{
+		Worker& victim = *workers[ ( index + i ) % workers.size() ];
+		std::lock_guard< std::mutex > lock( victim.mutex );
+		if( !victim.queue.empty() )
+		{
+			task = victim.queue.back();
+			victim.queue.pop_back();
+			stolen++;
+		}
+	}
+
+	if( task != nullptr )
+		pending--;
+
+	return task;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Thread pool with per-thread work stealing queues.
+ *
+ * Tasks are distributed round robin to the worker queues. Idle workers take
+ * work from the front of their own queue and steal from the back of the
+ * others. Finished tasks are pushed to a lock-free list for the owner thread
+ * which is told about them through the notify callback and completes them
+ * with RunCompleted. The callback is only invoked when the list was empty,
+ * so a burst of completions results in a single notification.
+ *
+ * Does not depend on COM or V8. The thread init/exit hooks are used for the
+ * apartment initialization.
+ */
+class WorkerPool
+{
+public:
+	class Task
+	{
+	public:
+		Task() : nextCompleted( nullptr ) {}
+		virtual ~Task() {}
+
+		// Executed in a worker thread.
+		virtual void Execute() = 0;
+
+		// Executed in the owner thread from RunCompleted.
+		virtual void Complete() = 0;
+
+		// Disposes the task once the pool is done with it.
+		virtual void Release() { delete this; }
+
+	private:
+		friend class WorkerPool;
+
+		// Link in the completed list.
+		Task* nextCompleted;
+	};
+
+	struct Stats
+	{
+		size_t threads;
+		size_t queued;
+		size_t active;
+		uint64_t submitted;
+		uint64_t completed;
+		uint64_t stolen;
+
+		// Share of the thread time spent executing tasks since the start.
+		double utilization;
+	};
+
+	typedef std::function< void() > Callback;
+
+	WorkerPool( size_t threadCount, Callback threadInit, Callback threadExit, Callback notify );
+	~WorkerPool();
+
+	/**
+	 * Queues the task. The pool owns the task until it is completed.
+	 */
+	void Submit( Task* task );
+
+	/**
+	 * Executes the task in the calling thread and queues it for completion
+	 * with the tasks the workers finish. For work that can't leave the owner
+	 * thread.
+	 */
+	void ExecuteInline( Task* task );
+
+	/**
+	 * Completes and releases the finished tasks in the order they finished.
+	 * Returns the number of tasks completed.
+	 *
+	 * Stops once the budget is used up if it is non-zero. The rest of the
+	 * tasks are left for the next call; see HasCompleted.
+	 */
+	size_t RunCompleted( std::chrono::nanoseconds budget = std::chrono::nanoseconds::zero() );
+
+	/**
+	 * Returns true if there are finished tasks that haven't been completed.
+	 * Executed in the owner thread.
+	 */
+	bool HasCompleted() const;
+
+	Stats GetStats() const;
+
+private:
+	WorkerPool( const WorkerPool& );
+	WorkerPool& operator=( const WorkerPool& );
+
+	struct Worker
+	{
+		Worker() : busyTime( 0 ) {}
+
+		std::mutex mutex;
+		std::deque< Task* > queue;
+		std::thread thread;
+		std::atomic< uint64_t > busyTime;
+	};
+
+	struct TaskRelease
+	{
+		void operator()( Task* task ) const { task->Release(); }
+	};
+
+	void Run( size_t index );
+	Task* Take( size_t index );
+	void Finish( Task* task );
+
+	std::vector< std::unique_ptr< Worker > > workers;
+	Callback threadInit;
+	Callback threadExit;
+	Callback notify;
+
+	// Guards the sleeping workers against lost wake ups and the pending count
+	// against queue changes in Submit. Taken before a worker mutex.
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	bool stopping;
+
+	std::atomic< size_t > pending;
+	std::atomic< size_t > active;
+	std::atomic< size_t > next;
+	std::atomic< uint64_t > submitted;
+	std::atomic< uint64_t > completedCount;
+	std::atomic< uint64_t > stolen;
+
+	// Finished tasks, newest first. Pushed by the workers, taken by the owner.
+	std::atomic< Task* > completed;
+
+	// Finished tasks left over from a drain that ran out of budget. Owner thread only.
+	std::deque< Task* > ready;
+
+	std::chrono::steady_clock::time_point started;
+};
@@ -1,6 +1,17 @@
 
 #include <nan.h>
 
+#include "AddonState.h"
+#include "AllocationCounter.h"
+#include "BatonPool.h"
+#include "ColumnProjection.h"
+#include "DirectCall.h"
+#include "EnumIterator.h"
+#include "GraphSnapshot.h"
+#include "InvokeBatch.h"
+#include "InvokePipeline.h"
+#include "InvokePool.h"
+#include "ResourceStats.h"
 #include "TypeLibLoader.h"
 #include "TypeLib.h"
 
@@ -9,18 +20,47 @@ NAN_METHOD( Assert )
 	_ASSERTE( false );
 }
 
+/**
+ * Destroys the states when the environment exits, while the isolate is still alive.
+ */
+void CleanupEnvironment( void* state )
+{
+	Nan::HandleScope scope;
+	AddonState::Destroy( state );
+}
+
 void InitAll( v8::Local< v8::Object > exports ) {
 
+	// Called once for each environment, on the thread running it.
 	CoInitialize( nullptr );
 
+#if NODE_MAJOR_VERSION > 10 || ( NODE_MAJOR_VERSION == 10 && NODE_MINOR_VERSION >= 2 )
+	AddonState* state = AddonState::Create();
+	if( state != nullptr )
+		node::AddEnvironmentCleanupHook( v8::Isolate::GetCurrent(), CleanupEnvironment, state );
+#else
+	AddonState::Create();
+#endif
+
 	TypeLibLoader::Init( exports );
 	TypeLib::Init( exports );
+	InvokeBatch::Init( exports );
+	InvokePool::Init( exports );
+	DirectCall::Init( exports );
+	BatonPool::Init( exports );
+	InvokePipeline::Init( exports );
+	EnumIterator::Init( exports );
+	ColumnProjection::Init( exports );
+	GraphSnapshot::Init( exports );
+	ResourceStats::Init( exports );
 
 #ifdef DEBUG
+	AllocationCounter::Init( exports );
+
 	Nan::HandleScope scope;
 	v8::Local< v8::FunctionTemplate > assert = Nan::New< v8::FunctionTemplate >( Assert );
 	exports->Set( Nan::New( "assert" ).ToLocalChecked(), assert->GetFunction() );
 #endif
 }
 
-NODE_MODULE( Interop, InitAll );
\ No newline at end of file
+NAN_MODULE_WORKER_ENABLED( Interop, InitAll )
\ No newline at end of file
@@ -3,6 +3,8 @@
 #define ATLASSERT( expr )
 #include <atlbase.h>
 
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -11,6 +13,7 @@
 
 #include <nan.h>
 #include "JsException.h"
+#include "ResourceStats.h"
 
 #define VERIFY( hr ) { \
 		HRESULT __hr = ( hr ); \
@@ -19,40 +22,157 @@
 			JsException::Throw( __hr ); \
 	}
 
+/**
+ * EXCEPINFO that frees its strings.
+ */
+struct ExcepInfo : public EXCEPINFO
+{
+	ExcepInfo() { memset( static_cast< EXCEPINFO* >( this ), 0, sizeof( EXCEPINFO ) ); }
+	~ExcepInfo() { Clear(); }
+
+	void Clear()
+	{
+		SysFreeString( bstrSource );
+		SysFreeString( bstrDescription );
+		SysFreeString( bstrHelpFile );
+		memset( static_cast< EXCEPINFO* >( this ), 0, sizeof( EXCEPINFO ) );
+	}
+
+private:
+	ExcepInfo( const ExcepInfo& );
+	ExcepInfo& operator=( const ExcepInfo& );
+};
+
+/**
+ * Invocation result. Cleared when it goes out of scope.
+ *
+ * Results that outlive the call, such as those of the async calls waiting
+ * to be settled, are counted in ResourceStats::variants while held.
+ */
+class ResultVariant : public CComVariant
+{
+public:
+	ResultVariant() : held( false ) {}
+	~ResultVariant() { Reset(); }
+
+	/**
+	 * Counts the value until the variant is reset. Empty values aren't counted.
+	 */
+	void Hold()
+	{
+		if( held || vt == VT_EMPTY )
+			return;
+
+		held = true;
+		ResourceStats::variants++;
+	}
+
+	/**
+	 * Clears the value and its count.
+	 */
+	void Reset()
+	{
+		Clear();
+		if( held )
+		{
+			held = false;
+			ResourceStats::variants--;
+		}
+	}
+
+private:
+	bool held;
+
+	ResultVariant( const ResultVariant& );
+	ResultVariant& operator=( const ResultVariant& );
+};
+
 inline std::string ToUTF8( const wchar_t* sz )
 {
-	int requiredLength = WideCharToMultiByte( CP_UTF8, 0, sz, -1, nullptr, 0, nullptr, nullptr );
+	// Convert without the terminator straight into the result.
+	int length = sz != nullptr ? static_cast< int >( wcslen( sz ) ) : 0;
+	if( length == 0 )
+		return std::string();
 
-	std::vector< char > vecData;
-	vecData.reserve( requiredLength );
-	WideCharToMultiByte( CP_UTF8, 0, sz, -1, vecData.data(), requiredLength, nullptr, nullptr );
-	std::string out( vecData.data() );
+	int requiredLength = WideCharToMultiByte( CP_UTF8, 0, sz, length, nullptr, 0, nullptr, nullptr );
+	std::string out( requiredLength, '\0' );
+	WideCharToMultiByte( CP_UTF8, 0, sz, length, &out[ 0 ], requiredLength, nullptr, nullptr );
 
 	return out;
 }
 
 inline std::wstring FromUTF8( const char* sz )
 {
-	int requiredLength = MultiByteToWideChar( CP_UTF8, 0, sz, -1, nullptr, 0 );
+	int length = sz != nullptr ? static_cast< int >( strlen( sz ) ) : 0;
+	if( length == 0 )
+		return std::wstring();
 
-	std::vector< wchar_t > vecData;
-	vecData.reserve( requiredLength );
-	MultiByteToWideChar( CP_UTF8, 0, sz, -1, vecData.data(), requiredLength );
-	std::wstring out( vecData.data() );
+	int requiredLength = MultiByteToWideChar( CP_UTF8, 0, sz, length, nullptr, 0 );
+	std::wstring out( requiredLength, L'\0' );
+	MultiByteToWideChar( CP_UTF8, 0, sz, length, &out[ 0 ], requiredLength );
 
 	return out;
 }
 
-void InitVariant( ITypeInfo* typeInfo, const TYPEDESC& typedesc, v8::Local< v8::Value > value, OUT CComVariant& variant );
-void InitVariantPtr( ITypeInfo* typeInfo, const TYPEDESC& typedesc, v8::Local< v8::Value > value, OUT CComVariant& variant );
+// COM dates count days from Dec 30, 1899. JS dates count milliseconds from Jan 1, 1970.
+const double DateEpochDays = 25569;
+const double MillisecondsPerDay = 1000 * 3600 * 24;
+
+/**
+ * Converts a COM date to JS milliseconds.
+ *
+ * Before Dec 30, 1899 the day counts backwards but the time of day still
+ * counts forward: -1.25 is 6 AM on Dec 29.
+ */
+inline double DateToMilliseconds( DATE date )
+{
+	double days = date;
+	if( days < 0 )
+	{
+		double whole = ceil( days );
+		days = whole + ( whole - days );
+	}
+
+	return ( days - DateEpochDays ) * MillisecondsPerDay;
+}
+
+/**
+ * Converts JS milliseconds to a COM date. Inverse of DateToMilliseconds.
+ */
+inline DATE MillisecondsToDate( double milliseconds )
+{
+	double days = milliseconds / MillisecondsPerDay + DateEpochDays;
+	if( days < 0 )
+	{
+		double whole = floor( days );
+		if( whole != days )
+			days = whole - ( days - whole );
+	}
+
+	return days;
+}
+
+v8::Local< v8::Value > DateToValue( DATE date );
+DATE ValueToDate( v8::Local< v8::Value > value );
+
+// BSTRs at least this long are exposed to V8 as external strings instead of being copied.
+const UINT ExternalBstrLength = 16 * 1024;
+
+BSTR ValueToBstr( v8::Local< v8::Value > value );
+v8::Local< v8::String > BstrToString( BSTR bstr );
+v8::Local< v8::String > TakeBstr( IN OUT VARIANT& variant );
+
 void InitVariantEnum( ITypeInfo* typeInfo, v8::Local< v8::Value > value, OUT CComVariant& variant );
 void InitVariantDispatch( ITypeInfo* typeInfo, v8::Local< v8::Value > value, OUT CComVariant& variant );
 
 CComPtr< IDispatch > GetDispatch( ITypeInfo* typeInfo, v8::Local< v8::Value > value );
 
-v8::Local< v8::Value > VariantToValue( ITypeInfo* typeInfo, const TYPEDESC& typedesc, const CComVariant& variant, v8::Isolate* isolate );
-v8::Local< v8::Value > PtrVariantToValue( ITypeInfo* typeInfo, const TYPEDESC& typedesc, const CComVariant& variant, v8::Isolate* isolate );
-v8::Local< v8::Value > UserVariantToValue( ITypeInfo* typeInfo, const TYPEDESC& typedesc, const CComVariant& variant, v8::Isolate* isolate );
+/**
+ * Returns true if the object can be called from any apartment: it implements
+ * IAgileObject or aggregates the free threaded marshaler.
+ */
+bool IsAgile( IUnknown* object );
+
 
 bool operator < ( const GUID &guid1, const GUID &guid2 );
 
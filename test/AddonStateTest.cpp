@@ -0,0 +1,287 @@
+#include "Test.h"
+
+#include "AddonState.h"
+#include "SharedRegistry.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Threads stand in for the environments: the main thread and the
+ * worker_threads each load the addon on a thread of their own.
+ */
+namespace
+{
+	/**
+	 * Records the order of the exit callbacks and the state destructors.
+	 */
+	struct Events
+	{
+		void Add( const std::string& event )
+		{
+			std::lock_guard< std::mutex > lock( mutex );
+			list.push_back( event );
+		}
+
+		std::vector< std::string > Take()
+		{
+			std::lock_guard< std::mutex > lock( mutex );
+			std::vector< std::string > taken;
+			taken.swap( list );
+			return taken;
+		}
+
+		std::mutex mutex;
+		std::vector< std::string > list;
+	};
+
+	Events events;
+
+	struct Counter
+	{
+		Counter() : value( 0 ) {}
+		~Counter() { events.Add( "Counter" ); }
+
+		int value;
+	};
+
+	struct Registry
+	{
+		~Registry()
+		{
+			// The states destroyed later are still reachable.
+			AddonState::Get< Counter >().value++;
+			events.Add( "Registry" );
+		}
+	};
+
+	void StopPool() { events.Add( "StopPool" ); }
+	void StopIterators() { events.Add( "StopIterators" ); }
+
+	/**
+	 * Runs the body as an environment: creates the state, runs the body and
+	 * destroys the state like the cleanup hook.
+	 */
+	void RunEnvironment( const std::function< void() >& body )
+	{
+		AddonState* state = AddonState::Create();
+		if( state == nullptr )
+			throw Test::Failure( "The thread already has a state" );
+
+		// A second load in the same environment keeps the state.
+		if( AddonState::Create() != nullptr )
+			throw Test::Failure( "Created a second state" );
+
+		body();
+		AddonState::Destroy( state );
+	}
+
+	/**
+	 * Runs an environment in a thread of its own. Join reports its failures.
+	 */
+	class Environment
+	{
+	public:
+		explicit Environment( const std::function< void() >& body )
+			: thread( [ this, body ]() {
+				try
+				{
+					RunEnvironment( body );
+				}
+				catch( ... )
+				{
+					error = std::current_exception();
+				}
+			} ) {}
+
+		void Join()
+		{
+			thread.join();
+			if( error )
+				std::rethrow_exception( error );
+		}
+
+	private:
+		std::exception_ptr error;
+		std::thread thread;
+	};
+
+	/**
+	 * Lets two threads meet before going on.
+	 */
+	class Rendezvous
+	{
+	public:
+		explicit Rendezvous( int count ) : waiting( count ) {}
+
+		void Arrive()
+		{
+			std::unique_lock< std::mutex > lock( mutex );
+			if( --waiting == 0 )
+				arrived.notify_all();
+			else
+				arrived.wait( lock, [ this ]() { return waiting == 0; } );
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable arrived;
+		int waiting;
+	};
+
+	struct Core
+	{
+		explicit Core( const std::string& path ) : path( path ) {}
+
+		std::string path;
+	};
+}
+
+TEST_CASE( KeepsStatePerEnvironment )
+{
+	Rendezvous rendezvous( 2 );
+	Counter* counters[ 2 ] = {};
+	int values[ 2 ] = {};
+
+	auto environment = [ & ]( int index ) {
+		return [ &, index ]() {
+			Counter& counter = AddonState::Get< Counter >();
+			counters[ index ] = &counter;
+			counter.value += index + 1;
+
+			// Both environments are alive at the same time.
+			rendezvous.Arrive();
+			CHECK( &AddonState::Get< Counter >() == &counter );
+			values[ index ] = counter.value;
+		};
+	};
+
+	Environment first( environment( 0 ) );
+	Environment second( environment( 1 ) );
+	first.Join();
+	second.Join();
+	events.Take();
+
+	CHECK( counters[ 0 ] != counters[ 1 ] );
+	CHECK_EQUAL( 1, values[ 0 ] );
+	CHECK_EQUAL( 2, values[ 1 ] );
+}
+
+TEST_CASE( StopsWorkBeforeDestroyingStates )
+{
+	Environment environment( []() {
+		AddonState::Get< Counter >();
+		AddonState::AtExit( StopPool );
+		AddonState::Get< Registry >();
+		AddonState::AtExit( StopIterators );
+	} );
+	environment.Join();
+
+	// Callbacks and states both go in reverse order of registration.
+	std::vector< std::string > expected = { "StopIterators", "StopPool", "Registry", "Counter" };
+	std::vector< std::string > actual = events.Take();
+	CHECK_EQUAL( expected.size(), actual.size() );
+	for( size_t i = 0; i < expected.size() && i < actual.size(); i++ )
+		CHECK_EQUAL( expected[ i ], actual[ i ] );
+}
+
+TEST_CASE( CreatesStateAgainAfterCleanup )
+{
+	// Node runs a new environment on the thread of an exited one.
+	int value = -1;
+	std::thread thread( [ & ]() {
+		RunEnvironment( []() { AddonState::Get< Counter >().value = 5; } );
+		RunEnvironment( [ & ]() { value = AddonState::Get< Counter >().value; } );
+	} );
+	thread.join();
+	events.Take();
+	CHECK_EQUAL( 0, value );
+}
+
+TEST_CASE( SharesCoreBetweenEnvironments )
+{
+	SharedRegistry< std::string, Core > registry;
+	std::atomic< int > created( 0 );
+	auto create = [ & ]() {
+		created++;
+
+		// Gives the other environment time to ask for the same library.
+		std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+		return std::make_shared< Core >( "dia2.tlb" );
+	};
+
+	Rendezvous rendezvous( 2 );
+	std::shared_ptr< const Core > cores[ 2 ];
+	bool shared[ 2 ] = {};
+	auto environment = [ & ]( int index ) {
+		return [ &, index ]() {
+			rendezvous.Arrive();
+			cores[ index ] = registry.Open( "dia2.tlb", create, shared[ index ] );
+		};
+	};
+
+	Environment first( environment( 0 ) );
+	Environment second( environment( 1 ) );
+	first.Join();
+	second.Join();
+
+	// Only one of the concurrent loads read the library.
+	CHECK_EQUAL( 1, created.load() );
+	CHECK( cores[ 0 ] != nullptr );
+	CHECK( cores[ 0 ] == cores[ 1 ] );
+	CHECK( shared[ 0 ] != shared[ 1 ] );
+	CHECK_EQUAL( std::string( "dia2.tlb" ), cores[ 0 ]->path );
+
+	// Other libraries get their own core.
+	bool otherShared = true;
+	std::shared_ptr< const Core > other = registry.Open( "sample.tlb", [ & ]() {
+		created++;
+		return std::make_shared< Core >( "sample.tlb" );
+	}, otherShared );
+	CHECK( !otherShared );
+	CHECK( other != cores[ 0 ] );
+	CHECK_EQUAL( 2, created.load() );
+}
+
+TEST_CASE( ReleasesCoreWithLastEnvironment )
+{
+	SharedRegistry< std::string, Core > registry;
+	int created = 0;
+	auto create = [ & ]() {
+		created++;
+		return std::make_shared< Core >( "dia2.tlb" );
+	};
+
+	bool shared = false;
+	std::weak_ptr< const Core > released;
+	{
+		std::shared_ptr< const Core > core = registry.Open( "dia2.tlb", create, shared );
+		released = core;
+		CHECK( registry.Open( "dia2.tlb", create, shared ) == core );
+		CHECK( shared );
+	}
+
+	// Nothing holds the core, so the next load reads the library again.
+	CHECK( released.expired() );
+	CHECK( registry.Open( "dia2.tlb", create, shared ) != nullptr );
+	CHECK( !shared );
+	CHECK_EQUAL( 2, created );
+
+	// A library that fails to load isn't remembered.
+	int failed = 0;
+	auto fail = [ & ]() {
+		failed++;
+		return std::shared_ptr< Core >();
+	};
+	CHECK( registry.Open( "missing.tlb", fail, shared ) == nullptr );
+	CHECK( registry.Open( "missing.tlb", fail, shared ) == nullptr );
+	CHECK( !shared );
+	CHECK_EQUAL( 2, failed );
+}
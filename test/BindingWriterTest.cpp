@@ -0,0 +1,186 @@
+#include "Test.h"
+
+#include "BindingWriter.h"
+#include "MappedFile.h"
+#include "TypeLibReader.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <sstream>
+
+/**
+ * The generated binding source and TypeScript declarations of the fixtures.
+ *
+ * sample.tlb has the dual interface and the enum. The dia2 interfaces are
+ * vtable only, so they get declarations but no thunks.
+ */
+namespace
+{
+	struct Library
+	{
+		explicit Library( const std::string& name )
+		{
+			if( !file.Open( Test::Fixture( name ) ) )
+				throw Test::Failure( "Could not open " + name );
+			reader.reset( new TypeLibReader( file.Data(), file.Size() ) );
+		}
+
+		MappedFile file;
+		std::unique_ptr< TypeLibReader > reader;
+	};
+
+	void CheckContains( const std::string& text, const std::string& fragment )
+	{
+		if( text.find( fragment ) == std::string::npos )
+			throw Test::Failure( "Missing \"" + fragment + "\"" );
+	}
+
+	size_t Count( const std::string& text, const std::string& fragment )
+	{
+		size_t count = 0;
+		for( size_t at = text.find( fragment ); at != std::string::npos; at = text.find( fragment, at + 1 ) )
+			count++;
+		return count;
+	}
+
+	/**
+	 * Returns the names after the fragment up to the next space, bracket or
+	 * semicolon.
+	 */
+	std::set< std::string > NamesAfter( const std::string& text, const std::string& fragment )
+	{
+		std::set< std::string > names;
+		for( size_t at = text.find( fragment ); at != std::string::npos; at = text.find( fragment, at + 1 ) )
+		{
+			size_t start = at + fragment.size();
+			size_t end = text.find_first_of( " {;:\n", start );
+			names.insert( text.substr( start, end - start ) );
+		}
+		return names;
+	}
+}
+
+TEST_CASE( WritesThunksOfDualMembers )
+{
+	Library sample( "sample.tlb" );
+	std::string source = BindingWriter::WriteSource( *sample.reader );
+
+	CheckContains( source, "from SampleLib 1.2. Do not edit." );
+	CheckContains( source, "#include \"BindingTraits.h\"" );
+	CheckContains( source,
+			"const IID Iid_IThing = { 0x22222222, 0x2222, 0x3333, { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x02 } };" );
+
+	// The dual members follow IUnknown and IDispatch in the vtable.
+	CheckContains( source,
+			"{ static_cast< MEMBERID >( 0x00000001 ), INVOKE_PROPERTYGET,\n"
+			"\t\t\t&BindingCall< &Iid_IThing, 7, BindingTraits< VT_BSTR > >::Invoke }" );
+	CheckContains( source,
+			"{ static_cast< MEMBERID >( 0x00000001 ), INVOKE_PROPERTYPUT,\n"
+			"\t\t\t&BindingCall< &Iid_IThing, 8, BindingNoResult, BindingTraits< VT_BSTR > >::Invoke }" );
+
+	// Enums are passed as VT_I4 and dual interfaces through their IID.
+	CheckContains( source, "&BindingCall< &Iid_IThing, 9, BindingTraits< VT_I4 >, BindingTraits< VT_I4 > >::Invoke" );
+	CheckContains( source,
+			"&BindingCall< &Iid_IThing, 10, BindingNoResult, BindingTraits< VT_I4 >, BindingInterface< &Iid_IThing > >::Invoke" );
+
+	CheckContains( source, "{ &Iid_IThing, Members_IThing, 4 }," );
+	CheckContains( source, "StaticBinding::Registration registration( Interfaces, 1 );" );
+
+	// The IID is defined once however many thunks refer to it.
+	CHECK_EQUAL( 1u, Count( source, "const IID " ) );
+}
+
+TEST_CASE( BindsOnlyDualInterfaces )
+{
+	Library dia2( "dia2.tlb" );
+	std::string source = BindingWriter::WriteSource( *dia2.reader );
+
+	CheckContains( source, "from Dia2Lib 2.0. Do not edit." );
+	CheckContains( source, "namespace\n{\n}\n" );
+	CHECK_EQUAL( 0u, Count( source, "Members_" ) );
+	CHECK_EQUAL( 0u, Count( source, "registration" ) );
+}
+
+TEST_CASE( DeclaresSampleLibrary )
+{
+	Library sample( "sample.tlb" );
+	std::string declarations = BindingWriter::WriteDeclarations( *sample.reader );
+
+	CheckContains( declarations, "export const enum Color {\n    Red = 1,\n    Green = -5,\n}\n" );
+
+	// The getter and setter pair is a writable property. The [retval] is the
+	// result and parameters with defaults are optional.
+	CheckContains( declarations, "export interface IThing {\n    Name: string;\n" );
+	CheckContains( declarations, "    put_Name( newVal: string ): void;\n" );
+	CheckContains( declarations, "    GetColor( c?: Color ): Color;\n" );
+	CheckContains( declarations, "    Add( index: number, item: IThing ): void;\n" );
+	CheckContains( declarations, "    readonly Async: IThingAsync;\n" );
+
+	CheckContains( declarations, "export interface IThingAsync {\n" );
+	CheckContains( declarations, "    GetColor( c?: Color ): Promise< Color >;\n" );
+	CheckContains( declarations, "    Add( index: number, item: IThing ): Promise< void >;\n" );
+
+	// Coclasses expose their default interface.
+	CheckContains( declarations, "export interface Thing extends IThing {}\n" );
+	CheckContains( declarations,
+			"export interface Library {\n"
+			"    Color: Function;\n"
+			"    IThing: { prototype: IThing };\n"
+			"    Thing: { new(): Thing };\n"
+			"}\n" );
+}
+
+TEST_CASE( DeclaresEveryTypeOfDia2 )
+{
+	Library dia2( "dia2.tlb" );
+	std::string declarations = BindingWriter::WriteDeclarations( *dia2.reader );
+
+	CHECK_EQUAL( Count( declarations, "{" ), Count( declarations, "}" ) );
+
+	// Every interface has its .Async facade and every type is in the library.
+	size_t interfaces = 0;
+	for( const auto& type : dia2.reader->types )
+	{
+		if( type.typekind == TypeLibReader::TkInterface )
+		{
+			CheckContains( declarations, "export interface " + type.name + "Async" );
+			CheckContains( declarations, "    readonly Async: " + type.name + "Async;\n" );
+			interfaces++;
+		}
+
+		CheckContains( declarations, "\n    " + type.name + ": " );
+	}
+	CHECK_EQUAL( 38u, interfaces );
+
+	// Bases are declared in the same file.
+	std::set< std::string > declared = NamesAfter( declarations, "export interface " );
+	for( const std::string& base : NamesAfter( declarations, " extends " ) )
+		if( declared.count( base ) == 0 )
+			throw Test::Failure( "Undeclared base " + base );
+
+	CheckContains( declarations, "export interface IDiaSymbol2 extends IDiaSymbol {" );
+	CheckContains( declarations, "export interface IDiaSymbol2Async extends IDiaSymbolAsync {" );
+	CheckContains( declarations, "    loadAddress: number;\n" );
+	CheckContains( declarations, "    put_loadAddress( arg0: number ): Promise< void >;\n" );
+	CheckContains( declarations, "export interface DiaSource extends IDiaDataSource {}\n" );
+}
+
+TEST_CASE( WritesGeneratedFile )
+{
+	Library sample( "sample.tlb" );
+	std::string source = BindingWriter::WriteSource( *sample.reader );
+
+	std::string path = "BindingWriterTest.out";
+	CHECK( BindingWriter::WriteFile( source, path ) );
+
+	std::ifstream file( path, std::ios::binary );
+	std::stringstream written;
+	written << file.rdbuf();
+	file.close();
+	remove( path.c_str() );
+	CHECK( written.str() == source );
+
+	CHECK( !BindingWriter::WriteFile( source, "missing/directory/bindings.cpp" ) );
+}
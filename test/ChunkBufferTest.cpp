@@ -0,0 +1,198 @@
+#include "Test.h"
+
+#include "ChunkBuffer.h"
+
+#include <vector>
+
+/**
+ * The chunk state of EnumIterator driven by a mock enumerator of integers.
+ */
+namespace
+{
+	/**
+	 * Returns the items in chunks like IEnumVARIANT::Next.
+	 */
+	class MockEnumerator
+	{
+	public:
+		MockEnumerator( int count, size_t chunkSize ) : count( count ), next( 0 ), chunkSize( chunkSize ), reads( 0 ) {}
+
+		void Fetch( std::vector< int >& items, bool& end )
+		{
+			reads++;
+			items.clear();
+			while( items.size() < chunkSize && next < count )
+				items.push_back( next++ );
+			end = items.size() < chunkSize;
+		}
+
+		int count;
+		int next;
+		size_t chunkSize;
+		int reads;
+	};
+
+	/**
+	 * Runs the fetch the worker would run. Returns false if nothing was started.
+	 */
+	bool Prefetch( ChunkBuffer< int >& buffer, MockEnumerator& enumerator )
+	{
+		if( !buffer.CanPrefetch() )
+			return false;
+
+		bool end = false;
+		enumerator.Fetch( buffer.BeginPrefetch(), end );
+		buffer.EndPrefetch( true, end );
+		return true;
+	}
+
+	/**
+	 * Takes the items the way EnumIterator::Next does.
+	 */
+	std::vector< int > IterateSync( int count, size_t chunkSize, int& reads )
+	{
+		MockEnumerator enumerator( count, chunkSize );
+		ChunkBuffer< int > buffer;
+		std::vector< int > items;
+		for( ;; )
+		{
+			if( buffer.NeedsRefill() )
+			{
+				bool end = false;
+				enumerator.Fetch( buffer.BeginRefill(), end );
+				buffer.EndRefill( end );
+			}
+
+			if( !buffer.HasItem() )
+				break;
+			items.push_back( buffer.Take() );
+		}
+
+		CHECK( buffer.Close() );
+		reads = enumerator.reads;
+		return items;
+	}
+}
+
+TEST_CASE( IteratesInChunks )
+{
+	int reads = 0;
+	std::vector< int > items = IterateSync( 10, 4, reads );
+	CHECK_EQUAL( 10u, items.size() );
+	for( int i = 0; i < 10; i++ )
+		CHECK_EQUAL( i, items[ i ] );
+	CHECK_EQUAL( 3, reads );
+
+	// A full last chunk needs one more read to find the end.
+	items = IterateSync( 8, 4, reads );
+	CHECK_EQUAL( 8u, items.size() );
+	CHECK_EQUAL( 3, reads );
+
+	items = IterateSync( 0, 4, reads );
+	CHECK_EQUAL( 0u, items.size() );
+	CHECK_EQUAL( 1, reads );
+}
+
+TEST_CASE( PrefetchesOneChunkAhead )
+{
+	MockEnumerator enumerator( 7, 3 );
+	ChunkBuffer< int > buffer;
+
+	// The async iterator fetches on creation.
+	CHECK( Prefetch( buffer, enumerator ) );
+	CHECK( !buffer.HasItem() );
+
+	// Only one chunk is read ahead.
+	CHECK( !Prefetch( buffer, enumerator ) );
+
+	std::vector< int > items;
+	for( ;; )
+	{
+		buffer.Advance();
+		Prefetch( buffer, enumerator );
+		if( !buffer.HasItem() )
+			break;
+
+		items.push_back( buffer.Take() );
+
+		// The next chunk is ready before the current one runs out.
+		CHECK( enumerator.reads * 3 >= static_cast< int >( items.size() ) );
+	}
+
+	CHECK_EQUAL( 7u, items.size() );
+	for( int i = 0; i < 7; i++ )
+		CHECK_EQUAL( i, items[ i ] );
+	CHECK( buffer.IsExhausted() );
+	CHECK_EQUAL( 3, enumerator.reads );
+}
+
+TEST_CASE( WaitsForRunningFetch )
+{
+	MockEnumerator enumerator( 5, 2 );
+	ChunkBuffer< int > buffer;
+
+	// The fetch is still in the worker when the first item is requested.
+	std::vector< int >& target = buffer.BeginPrefetch();
+	buffer.Advance();
+	CHECK( !buffer.HasItem() );
+	CHECK( buffer.IsFetching() );
+	CHECK( !buffer.CanPrefetch() );
+
+	bool end = false;
+	enumerator.Fetch( target, end );
+	buffer.EndPrefetch( true, end );
+	buffer.Advance();
+	CHECK( buffer.HasItem() );
+	CHECK_EQUAL( 0, buffer.Take() );
+	CHECK( buffer.CanPrefetch() );
+}
+
+TEST_CASE( KeepsChunkOnFailedFetch )
+{
+	MockEnumerator enumerator( 5, 2 );
+	ChunkBuffer< int > buffer;
+	CHECK( Prefetch( buffer, enumerator ) );
+	buffer.Advance();
+
+	// A failed fetch leaves the current items and nothing prefetched.
+	buffer.BeginPrefetch();
+	buffer.EndPrefetch( false, false );
+	CHECK_EQUAL( 0, buffer.Take() );
+	CHECK_EQUAL( 1, buffer.Take() );
+	buffer.Advance();
+	CHECK( !buffer.HasItem() );
+	CHECK( !buffer.IsExhausted() );
+}
+
+TEST_CASE( DefersReleaseWhileFetching )
+{
+	MockEnumerator enumerator( 10, 4 );
+	ChunkBuffer< int > buffer;
+	CHECK( Prefetch( buffer, enumerator ) );
+	buffer.Advance();
+	CHECK_EQUAL( 0, buffer.Take() );
+
+	// Closing with a fetch running leaves the release to the fetch completion.
+	std::vector< int >& target = buffer.BeginPrefetch();
+	CHECK( !buffer.Close() );
+	CHECK( !buffer.HasItem() );
+	CHECK( buffer.IsClosed() );
+
+	bool end = false;
+	enumerator.Fetch( target, end );
+	buffer.EndPrefetch( true, end );
+	CHECK( target.empty() );
+
+	// The late chunk is dropped and no more are fetched.
+	buffer.Advance();
+	CHECK( !buffer.HasItem() );
+	CHECK( !buffer.CanPrefetch() );
+	CHECK( !buffer.NeedsRefill() );
+
+	// Without a fetch running the enumerator is released right away.
+	ChunkBuffer< int > idle;
+	CHECK( Prefetch( idle, enumerator ) );
+	CHECK( idle.Close() );
+	idle.Advance();
+	CHECK( !idle.HasItem() );
+}
@@ -0,0 +1,233 @@
+#include "MappedFile.h"
+#include "Snapshot.h"
+#include "SnapshotWriter.h"
+#include "TypeLibReader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <oleauto.h>
+#endif
+
+/**
+ * Compares the load time of a type library with and without a snapshot.
+ *
+ *   SnapshotBenchmark [iterations] [typelib]
+ *
+ * The typelib defaults to fixtures/dia2.tlb. The portable rows map the file
+ * and walk every type and function name with TypeLibReader, which is not
+ * what load() runs. On Windows the oleaut32 rows measure the load() path:
+ * LoadTypeLibEx and the names through ITypeInfo, or LoadTypeLibEx and the
+ * names from the snapshot.
+ */
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	double Milliseconds( Clock::duration duration )
+	{
+		return std::chrono::duration< double, std::milli >( duration ).count();
+	}
+
+	size_t ReadTypeLib( const std::string& path )
+	{
+		MappedFile file;
+		if( !file.Open( path ) )
+			return 0;
+
+		TypeLibReader reader( file.Data(), file.Size() );
+		size_t names = 0;
+		for( const auto& type : reader.types )
+		{
+			names += type.name.size();
+			for( const auto& func : type.funcs )
+				names += func.name.size();
+		}
+		return names;
+	}
+
+	size_t ReadSnapshot( const std::string& path )
+	{
+		Snapshot snapshot;
+		if( !snapshot.Open( path ) )
+			return 0;
+
+		size_t names = 0;
+		for( uint32_t i = 0; i < snapshot.TypeCount(); i++ )
+		{
+			const SnapshotType& type = snapshot.Type( i );
+			names += strlen( snapshot.String( type.name ) );
+
+			const SnapshotFunc* funcs = snapshot.Funcs( type );
+			for( uint32_t f = 0; f < type.funcCount; f++ )
+				names += strlen( snapshot.String( funcs[ f ].name ) );
+		}
+		return names;
+	}
+
+#ifdef _WIN32
+
+	size_t ReadBstr( BSTR str )
+	{
+		size_t length = SysStringLen( str );
+		SysFreeString( str );
+		return length;
+	}
+
+	ITypeLib* LoadWithOleAut( const std::string& path )
+	{
+		std::wstring widePath( path.begin(), path.end() );
+		ITypeLib* typeLib = nullptr;
+		if( !SUCCEEDED( LoadTypeLibEx( widePath.c_str(), REGKIND_NONE, &typeLib ) ) )
+			return nullptr;
+		return typeLib;
+	}
+
+	/**
+	 * The names as load() and the type initialization read them without a snapshot.
+	 */
+	size_t ReadTypeInfo( const std::string& path )
+	{
+		ITypeLib* typeLib = LoadWithOleAut( path );
+		if( typeLib == nullptr )
+			return 0;
+
+		size_t names = 0;
+		for( UINT t = 0; t < typeLib->GetTypeInfoCount(); t++ )
+		{
+			ITypeInfo* typeInfo = nullptr;
+			if( !SUCCEEDED( typeLib->GetTypeInfo( t, &typeInfo ) ) )
+				continue;
+
+			BSTR name = nullptr;
+			typeInfo->GetDocumentation( MEMBERID_NIL, &name, nullptr, nullptr, nullptr );
+			names += ReadBstr( name );
+
+			TYPEATTR* attr = nullptr;
+			typeInfo->GetTypeAttr( &attr );
+			for( UINT f = 0; f < attr->cFuncs; f++ )
+			{
+				FUNCDESC* desc = nullptr;
+				typeInfo->GetFuncDesc( f, &desc );
+
+				BSTR funcName = nullptr;
+				typeInfo->GetDocumentation( desc->memid, &funcName, nullptr, nullptr, nullptr );
+				names += ReadBstr( funcName );
+				typeInfo->ReleaseFuncDesc( desc );
+			}
+
+			typeInfo->ReleaseTypeAttr( attr );
+			typeInfo->Release();
+		}
+
+		typeLib->Release();
+		return names;
+	}
+
+	// The snapshot written from the library that is being measured.
+	std::string benchmarkSnapshot;
+
+	/**
+	 * load() with a snapshot still loads the library for the calls.
+	 */
+	size_t ReadTypeInfoSnapshot( const std::string& path )
+	{
+		ITypeLib* typeLib = LoadWithOleAut( path );
+		if( typeLib == nullptr )
+			return 0;
+
+		size_t names = ReadSnapshot( benchmarkSnapshot );
+		typeLib->Release();
+		return names;
+	}
+
+#endif
+
+	template< typename Load >
+	double Measure( Load load, const std::string& path, int iterations, size_t& names )
+	{
+		Clock::time_point start = Clock::now();
+		for( int i = 0; i < iterations; i++ )
+			names = load( path );
+		return Milliseconds( Clock::now() - start ) / iterations;
+	}
+}
+
+int main( int argc, char** argv )
+{
+	int iterations = argc > 1 ? atoi( argv[ 1 ] ) : 200;
+	std::string path = argc > 2 ? argv[ 2 ] : std::string( FIXTURE_DIR ) + "/dia2.tlb";
+	if( iterations <= 0 )
+		iterations = 1;
+
+	std::string snapshotPath = "SnapshotBenchmark.snapshot";
+	try
+	{
+		MappedFile file;
+		if( !file.Open( path ) )
+		{
+			fprintf( stderr, "Could not open %s\n", path.c_str() );
+			return 1;
+		}
+
+		TypeLibReader reader( file.Data(), file.Size() );
+		if( !SnapshotWriter::WriteFile( reader, snapshotPath ) )
+		{
+			fprintf( stderr, "Could not write %s\n", snapshotPath.c_str() );
+			return 1;
+		}
+	}
+	catch( const TypeLibReader::FormatError& e )
+	{
+		fprintf( stderr, "%s: %s\n", path.c_str(), e.what() );
+		return 1;
+	}
+
+	size_t typeLibNames = 0;
+	size_t snapshotNames = 0;
+	double typeLibTime = Measure( ReadTypeLib, path, iterations, typeLibNames );
+	double snapshotTime = Measure( ReadSnapshot, snapshotPath, iterations, snapshotNames );
+
+
+#ifdef _WIN32
+	CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+	benchmarkSnapshot = snapshotPath;
+	size_t typeInfoNames = 0;
+	size_t typeInfoSnapshotNames = 0;
+	double typeInfoTime = Measure( ReadTypeInfo, path, iterations, typeInfoNames );
+	double typeInfoSnapshotTime = Measure( ReadTypeInfoSnapshot, path, iterations, typeInfoSnapshotNames );
+#endif
+	remove( snapshotPath.c_str() );
+
+	printf( "%s, %d iterations\n", path.c_str(), iterations );
+	printf( "  TypeLibReader           %10.4f ms\n", typeLibTime );
+	printf( "  snapshot                %10.4f ms\n", snapshotTime );
+	printf( "  speedup                 %10.1fx\n", snapshotTime > 0 ? typeLibTime / snapshotTime : 0.0 );
+#ifdef _WIN32
+	printf( "  ITypeInfo               %10.4f ms\n", typeInfoTime );
+	printf( "  LoadTypeLib + snapshot  %10.4f ms\n", typeInfoSnapshotTime );
+	printf( "  speedup                 %10.1fx\n",
+			typeInfoSnapshotTime > 0 ? typeInfoTime / typeInfoSnapshotTime : 0.0 );
+	CoUninitialize();
+
+	if( typeInfoNames == 0 || typeInfoNames > typeInfoSnapshotNames )
+	{
+		fprintf( stderr, "Snapshot lists %zu name characters, ITypeInfo %zu\n", typeInfoSnapshotNames, typeInfoNames );
+		return 1;
+	}
+#endif
+
+	// Both must have seen the same names for the comparison to mean anything.
+	if( typeLibNames == 0 || typeLibNames > snapshotNames )
+	{
+		fprintf( stderr, "Snapshot lists %zu name characters, the library %zu\n", snapshotNames, typeLibNames );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,354 @@
+#include "Test.h"
+
+#include "MappedFile.h"
+#include "Snapshot.h"
+#include "SnapshotWriter.h"
+#include "TypeLibReader.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <oleauto.h>
+#endif
+
+/**
+ * Snapshots written from the fixtures are read back and compared with the
+ * reader. On Windows the function lists are also compared with the ones
+ * ITypeInfo presents, which is what InteropType matches them against.
+ */
+namespace
+{
+	const int32_t DispatchMemberId = 0x60000000;
+
+	struct Library
+	{
+		explicit Library( const std::string& name )
+		{
+			if( !file.Open( Test::Fixture( name ) ) )
+				throw Test::Failure( "Could not open " + name );
+			reader.reset( new TypeLibReader( file.Data(), file.Size() ) );
+			SnapshotWriter::Write( *reader, data );
+			if( !snapshot.Attach( data.data(), data.size() ) )
+				throw Test::Failure( "Could not attach the snapshot of " + name );
+		}
+
+		const SnapshotType& Type( const std::string& name ) const
+		{
+			for( uint32_t i = 0; i < snapshot.TypeCount(); i++ )
+				if( name == snapshot.String( snapshot.Type( i ).name ) )
+					return snapshot.Type( i );
+			throw Test::Failure( "Missing type " + name );
+		}
+
+		MappedFile file;
+		std::unique_ptr< TypeLibReader > reader;
+		std::vector< uint8_t > data;
+		Snapshot snapshot;
+	};
+
+	bool SameGuid( const SnapshotGuid& snapshotGuid, const TypeLibReader::Guid& guid )
+	{
+		return snapshotGuid.data1 == guid.data1 &&
+			snapshotGuid.data2 == guid.data2 &&
+			snapshotGuid.data3 == guid.data3 &&
+			memcmp( snapshotGuid.data4, guid.data4, sizeof( guid.data4 ) ) == 0;
+	}
+
+	void CheckTypes( const std::string& fixture )
+	{
+		Library library( fixture );
+		const TypeLibReader& reader = *library.reader;
+		const Snapshot& snapshot = library.snapshot;
+
+		const SnapshotHeader& header = snapshot.Header();
+		CHECK( SameGuid( header.libGuid, reader.guid ) );
+		CHECK_EQUAL( reader.majorVersion, header.majorVersion );
+		CHECK_EQUAL( reader.minorVersion, header.minorVersion );
+		CHECK_EQUAL( reader.lcid, header.lcid );
+		CHECK_EQUAL( reader.types.size(), static_cast< size_t >( snapshot.TypeCount() ) );
+
+		// Types are stored in the type library order so TypeLibCore can materialize them by index.
+		for( uint32_t i = 0; i < snapshot.TypeCount(); i++ )
+		{
+			const TypeLibReader::TypeInfo& type = reader.types[ i ];
+			const SnapshotType& record = snapshot.Type( i );
+			CHECK_EQUAL( type.name, std::string( snapshot.String( record.name ) ) );
+			CHECK( SameGuid( record.guid, type.guid ) );
+			CHECK_EQUAL( static_cast< uint16_t >( type.typekind ), record.typekind );
+			CHECK_EQUAL( type.flags, record.flags );
+		}
+	}
+}
+
+TEST_CASE( RoundTripsTypes )
+{
+	CheckTypes( "dia2.tlb" );
+	CheckTypes( "executor.tlb" );
+	CheckTypes( "sample.tlb" );
+}
+
+TEST_CASE( RoundTripsInterfaceFunctions )
+{
+	Library dia( "dia2.tlb" );
+	const TypeLibReader& reader = *dia.reader;
+	const Snapshot& snapshot = dia.snapshot;
+
+	size_t interfaces = 0;
+	for( uint32_t i = 0; i < snapshot.TypeCount(); i++ )
+	{
+		const TypeLibReader::TypeInfo& type = reader.types[ i ];
+		const SnapshotType& record = snapshot.Type( i );
+		if( type.typekind != TypeLibReader::TkInterface )
+		{
+			CHECK_EQUAL( 0u, record.funcCount );
+			continue;
+		}
+
+		// Plain interfaces list their own functions only.
+		interfaces++;
+		CHECK_EQUAL( type.funcs.size(), static_cast< size_t >( record.funcCount ) );
+		const SnapshotFunc* funcs = snapshot.Funcs( record );
+		for( size_t f = 0; f < type.funcs.size(); f++ )
+		{
+			CHECK_EQUAL( type.funcs[ f ].name, std::string( snapshot.String( funcs[ f ].name ) ) );
+			CHECK_EQUAL( type.funcs[ f ].memid, funcs[ f ].memid );
+			CHECK_EQUAL( static_cast< uint16_t >( type.funcs[ f ].invkind ), funcs[ f ].invkind );
+			CHECK_EQUAL( type.funcs[ f ].flags, funcs[ f ].flags );
+			CHECK_EQUAL( type.funcs[ f ].params.size(), static_cast< size_t >( funcs[ f ].paramCount ) );
+		}
+	}
+
+	CHECK_EQUAL( 38u, interfaces );
+
+	const SnapshotType& session = dia.Type( "IDiaSession" );
+	const SnapshotFunc* funcs = snapshot.Funcs( session );
+	CHECK_EQUAL( "loadAddress", std::string( snapshot.String( funcs[ 0 ].name ) ) );
+	CHECK_EQUAL( 2, funcs[ 0 ].invkind );
+	CHECK_EQUAL( "loadAddress", std::string( snapshot.String( funcs[ 1 ].name ) ) );
+	CHECK_EQUAL( 4, funcs[ 1 ].invkind );
+}
+
+TEST_CASE( ListsDispatchMembersOfDualInterfaces )
+{
+	Library sample( "sample.tlb" );
+	const Snapshot& snapshot = sample.snapshot;
+
+	// IDispatch members first, then the functions in their dispatch form.
+	const SnapshotType& thing = sample.Type( "IThing" );
+	CHECK_EQUAL( 11u, thing.funcCount );
+
+	const SnapshotFunc* funcs = snapshot.Funcs( thing );
+	const char* const dispatchMembers[] = {
+		"QueryInterface", "AddRef", "Release", "GetTypeInfoCount", "GetTypeInfo", "GetIDsOfNames", "Invoke"
+	};
+	const uint16_t dispatchParams[] = { 2, 0, 0, 1, 3, 5, 8 };
+	for( int i = 0; i < 7; i++ )
+	{
+		CHECK_EQUAL( dispatchMembers[ i ], std::string( snapshot.String( funcs[ i ].name ) ) );
+		CHECK_EQUAL( DispatchMemberId + i, funcs[ i ].memid );
+		CHECK_EQUAL( dispatchParams[ i ], funcs[ i ].paramCount );
+	}
+
+	// [out, retval] is not a parameter in the dispatch form.
+	CHECK_EQUAL( "Name", std::string( snapshot.String( funcs[ 7 ].name ) ) );
+	CHECK_EQUAL( 1, funcs[ 7 ].memid );
+	CHECK_EQUAL( 2, funcs[ 7 ].invkind );
+	CHECK_EQUAL( 0, funcs[ 7 ].paramCount );
+
+	CHECK_EQUAL( "Name", std::string( snapshot.String( funcs[ 8 ].name ) ) );
+	CHECK_EQUAL( 4, funcs[ 8 ].invkind );
+	CHECK_EQUAL( 1, funcs[ 8 ].paramCount );
+
+	CHECK_EQUAL( "GetColor", std::string( snapshot.String( funcs[ 9 ].name ) ) );
+	CHECK_EQUAL( 1, funcs[ 9 ].paramCount );
+	CHECK_EQUAL( "Add", std::string( snapshot.String( funcs[ 10 ].name ) ) );
+	CHECK_EQUAL( 2, funcs[ 10 ].paramCount );
+
+	// Enums and coclasses have no functions.
+	CHECK_EQUAL( 0u, sample.Type( "Color" ).funcCount );
+	CHECK_EQUAL( 0u, sample.Type( "Thing" ).funcCount );
+}
+
+TEST_CASE( FindsTypesByGuid )
+{
+	Library dia( "dia2.tlb" );
+
+	const TypeLibReader::TypeInfo& source = dia.reader->types[ 3 ];
+	SnapshotGuid guid;
+	memcpy( &guid, &source.guid, sizeof( guid ) );
+
+	const SnapshotType* found = dia.snapshot.FindType( guid );
+	CHECK( found == &dia.snapshot.Type( 3 ) );
+
+	guid.data1 ^= 0xffffffff;
+	CHECK( dia.snapshot.FindType( guid ) == nullptr );
+}
+
+TEST_CASE( OpensSnapshotFile )
+{
+	Library executor( "executor.tlb" );
+
+	const std::string path = "SnapshotTest.snapshot";
+	CHECK( SnapshotWriter::WriteFile( *executor.reader, path ) );
+
+	{
+		Snapshot snapshot;
+		CHECK( snapshot.Open( path ) );
+		CHECK_EQUAL( executor.data.size(), static_cast< size_t >( snapshot.Header().size ) );
+		CHECK_EQUAL( executor.snapshot.TypeCount(), snapshot.TypeCount() );
+	}
+
+	remove( path.c_str() );
+
+	Snapshot missing;
+	CHECK( !missing.Open( path ) );
+}
+
+TEST_CASE( RejectsMismatchedHeader )
+{
+	Library sample( "sample.tlb" );
+	Snapshot snapshot;
+
+	std::vector< uint8_t > data = sample.data;
+	CHECK( snapshot.Attach( data.data(), data.size() ) );
+	CHECK( !snapshot.Attach( data.data(), sizeof( SnapshotHeader ) - 1 ) );
+	CHECK( !snapshot.Attach( data.data(), data.size() - 8 ) );
+
+	data[ 0 ] = 'X';
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+
+	// Snapshots of the earlier format are ignored.
+	data = sample.data;
+	reinterpret_cast< SnapshotHeader* >( data.data() )->formatVersion = Snapshot::FormatVersion - 1;
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+
+	data = sample.data;
+	reinterpret_cast< SnapshotHeader* >( data.data() )->funcsOffset += 4;
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+
+	data = sample.data;
+	data.back() = 'x';
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+}
+
+TEST_CASE( RejectsInvalidRecords )
+{
+	Library sample( "sample.tlb" );
+	const SnapshotHeader& header = sample.snapshot.Header();
+	Snapshot snapshot;
+
+	// IThing is the type with functions.
+	const uint32_t thing = 1;
+	CHECK_EQUAL( 11u, sample.snapshot.Type( thing ).funcCount );
+
+	auto type = [ & ]( std::vector< uint8_t >& data, uint32_t index ) -> SnapshotType& {
+		return reinterpret_cast< SnapshotType* >( data.data() + header.typesOffset )[ index ];
+	};
+	auto func = [ & ]( std::vector< uint8_t >& data, uint32_t index ) -> SnapshotFunc& {
+		return reinterpret_cast< SnapshotFunc* >( data.data() + header.funcsOffset )[ index ];
+	};
+
+	std::vector< uint8_t > data = sample.data;
+	type( data, thing ).funcCount++;
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+
+	data = sample.data;
+	type( data, thing ).firstFunc = header.funcCount + 1;
+	type( data, thing ).funcCount = 0;
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+
+	// firstFunc + funcCount must not wrap around.
+	data = sample.data;
+	type( data, thing ).firstFunc = 1;
+	type( data, thing ).funcCount = 0xffffffff;
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+
+	data = sample.data;
+	type( data, 0 ).name = header.stringsSize;
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+
+	data = sample.data;
+	func( data, header.funcCount - 1 ).name = header.stringsSize;
+	CHECK( !snapshot.Attach( data.data(), data.size() ) );
+
+	// The last string and an empty function list at the end are valid.
+	data = sample.data;
+	type( data, 0 ).name = header.stringsSize - 1;
+	type( data, 0 ).firstFunc = header.funcCount;
+	type( data, 0 ).funcCount = 0;
+	CHECK( snapshot.Attach( data.data(), data.size() ) );
+	CHECK_EQUAL( std::string(), std::string( snapshot.String( snapshot.Type( 0 ).name ) ) );
+}
+
+#ifdef _WIN32
+
+namespace
+{
+	std::string Narrow( BSTR str )
+	{
+		std::string out;
+		for( UINT i = 0; i < SysStringLen( str ); i++ )
+			out.push_back( static_cast< char >( str[ i ] ) );
+		return out;
+	}
+
+	/**
+	 * Compares the function lists with the FUNCDESCs InteropType::Init checks them against.
+	 */
+	void CompareWithTypeInfo( const std::string& fixture )
+	{
+		Library library( fixture );
+		const Snapshot& snapshot = library.snapshot;
+
+		std::string path = Test::Fixture( fixture );
+		std::wstring widePath( path.begin(), path.end() );
+		ITypeLib* typeLib = nullptr;
+		CHECK( SUCCEEDED( LoadTypeLibEx( widePath.c_str(), REGKIND_NONE, &typeLib ) ) );
+		CHECK_EQUAL( typeLib->GetTypeInfoCount(), snapshot.TypeCount() );
+
+		for( UINT t = 0; t < typeLib->GetTypeInfoCount(); t++ )
+		{
+			const SnapshotType& record = snapshot.Type( t );
+			ITypeInfo* typeInfo = nullptr;
+			CHECK( SUCCEEDED( typeLib->GetTypeInfo( t, &typeInfo ) ) );
+
+			TYPEATTR* attr = nullptr;
+			typeInfo->GetTypeAttr( &attr );
+			if( attr->typekind == TKIND_INTERFACE || attr->typekind == TKIND_DISPATCH )
+				CHECK_EQUAL( static_cast< uint32_t >( attr->cFuncs ), record.funcCount );
+
+			const SnapshotFunc* funcs = snapshot.Funcs( record );
+			for( UINT f = 0; f < record.funcCount; f++ )
+			{
+				FUNCDESC* desc = nullptr;
+				typeInfo->GetFuncDesc( f, &desc );
+
+				BSTR name = nullptr;
+				typeInfo->GetDocumentation( desc->memid, &name, nullptr, nullptr, nullptr );
+				CHECK_EQUAL( Narrow( name ), std::string( snapshot.String( funcs[ f ].name ) ) );
+				SysFreeString( name );
+
+				CHECK_EQUAL( static_cast< int32_t >( desc->memid ), funcs[ f ].memid );
+				CHECK_EQUAL( static_cast< uint16_t >( desc->invkind ), funcs[ f ].invkind );
+				CHECK_EQUAL( static_cast< uint16_t >( desc->cParams ), funcs[ f ].paramCount );
+
+				typeInfo->ReleaseFuncDesc( desc );
+			}
+
+			typeInfo->ReleaseTypeAttr( attr );
+			typeInfo->Release();
+		}
+
+		typeLib->Release();
+	}
+}
+
+TEST_CASE( MatchesTypeInfo )
+{
+	CompareWithTypeInfo( "dia2.tlb" );
+	CompareWithTypeInfo( "executor.tlb" );
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+
+std::vector< Test::Case >& Test::Cases()
+{
+	static std::vector< Case > cases;
+	return cases;
+}
+
+void Test::Fail( const char* file, int line, const std::string& message )
+{
+	std::ostringstream out;
+	out << file << ":" << line << ": " << message;
+	throw Failure( out.str() );
+}
+
+std::string Test::Fixture( const std::string& name )
+{
+	return std::string( FIXTURE_DIR ) + "/" + name;
+}
+
+/**
+ * Runs the cases of the executable. A case name as the argument runs only that case.
+ */
+int main( int argc, char** argv )
+{
+	int failures = 0;
+	for( const Test::Case& testCase : Test::Cases() )
+	{
+		if( argc > 1 && strcmp( argv[ 1 ], testCase.name ) != 0 )
+			continue;
+
+		try
+		{
+			testCase.run();
+			printf( "[ ok ] %s\n", testCase.name );
+		}
+		catch( const std::exception& e )
+		{
+			printf( "[fail] %s\n  %s\n", testCase.name, e.what() );
+			failures++;
+		}
+	}
+
+	return failures;
+}
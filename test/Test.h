@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal test runner for the parts of the addon that build without COM and V8.
+ *
+ * Each test executable links Test.cpp which runs every TEST_CASE in it. A
+ * failed CHECK ends the case and the process exits with the failure count.
+ */
+namespace Test
+{
+	struct Case
+	{
+		const char* name;
+		void ( *run )();
+	};
+
+	std::vector< Case >& Cases();
+
+	struct Register
+	{
+		Register( const char* name, void ( *run )() ) { Cases().push_back( Case{ name, run } ); }
+	};
+
+	class Failure : public std::runtime_error
+	{
+	public:
+		Failure( const std::string& msg ) : std::runtime_error( msg ) {}
+	};
+
+	void Fail( const char* file, int line, const std::string& message );
+
+	/**
+	 * Returns the path of a file in the fixtures directory.
+	 */
+	std::string Fixture( const std::string& name );
+
+	template< typename T >
+	std::string Describe( const T& value )
+	{
+		std::ostringstream out;
+		out << value;
+		return out.str();
+	}
+
+	inline std::string Describe( const std::string& value ) { return "\"" + value + "\""; }
+	inline std::string Describe( const char* value ) { return Describe( std::string( value ) ); }
+	inline std::string Describe( uint8_t value ) { return Describe( static_cast< unsigned >( value ) ); }
+	inline std::string Describe( int8_t value ) { return Describe( static_cast< int >( value ) ); }
+}
+
+#define TEST_CASE( name ) \
+	static void name(); \
+	static Test::Register name##Registration( #name, name ); \
+	static void name()
+
+#define CHECK( expr ) \
+	do { \
+		if( !( expr ) ) \
+			Test::Fail( __FILE__, __LINE__, "CHECK( " #expr " )" ); \
+	} while( false )
+
+#define CHECK_EQUAL( expected, actual ) \
+	do { \
+		const auto& expectedValue = ( expected ); \
+		const auto& actualValue = ( actual ); \
+		if( !( expectedValue == actualValue ) ) \
+			Test::Fail( __FILE__, __LINE__, "CHECK_EQUAL( " #expected ", " #actual " ): expected " + \
+					Test::Describe( expectedValue ) + ", got " + Test::Describe( actualValue ) ); \
+	} while( false )
+
+#define CHECK_THROWS( exception, expr ) \
+	do { \
+		bool thrown = false; \
+		try { expr; } catch( const exception& ) { thrown = true; } \
+		if( !thrown ) \
+			Test::Fail( __FILE__, __LINE__, "CHECK_THROWS( " #exception ", " #expr " )" ); \
+	} while( false )
@@ -0,0 +1,497 @@
+#include "Test.h"
+
+#include "MappedFile.h"
+#include "TypeLibReader.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <oleauto.h>
+#endif
+
+/**
+ * The expected values are the ones ITypeInfo reports for the fixtures.
+ *
+ * dia2.tlb and executor.tlb are the TYPELIB resources MIDL compiled into
+ * msdia140.dll and the C++ unit test executor of Visual Studio. sample.tlb
+ * is written by fixtures/make_sample.py and covers dual interfaces and
+ * parameter defaults which the MIDL libraries don't have. On Windows the
+ * libraries are also compared member by member against LoadTypeLibEx.
+ */
+namespace
+{
+	const uint16_t VtI4 = 3;
+	const uint16_t VtBstr = 8;
+	const uint16_t VtUnknown = 13;
+	const uint16_t VtUI1 = 17;
+	const uint16_t VtUI4 = 19;
+	const uint16_t VtI8 = 20;
+	const uint16_t VtVoid = 24;
+	const uint16_t VtHresult = 25;
+	const uint16_t VtLpwstr = 31;
+
+	const uint16_t ParamIn = 0x1;
+	const uint16_t ParamOut = 0x2;
+
+	struct Library
+	{
+		explicit Library( const std::string& name )
+		{
+			if( !file.Open( Test::Fixture( name ) ) )
+				throw Test::Failure( "Could not open " + name );
+			reader.reset( new TypeLibReader( file.Data(), file.Size() ) );
+		}
+
+		const TypeLibReader::TypeInfo& Type( const std::string& name ) const
+		{
+			for( const auto& type : reader->types )
+				if( type.name == name )
+					return type;
+			throw Test::Failure( "Missing type " + name );
+		}
+
+		MappedFile file;
+		std::unique_ptr< TypeLibReader > reader;
+	};
+
+	const TypeLibReader::FuncInfo& Func( const TypeLibReader::TypeInfo& type, const std::string& name )
+	{
+		for( const auto& func : type.funcs )
+			if( func.name == name )
+				return func;
+		throw Test::Failure( "Missing function " + name );
+	}
+
+	std::vector< uint8_t > ReadFixture( const std::string& name )
+	{
+		MappedFile file;
+		if( !file.Open( Test::Fixture( name ) ) )
+			throw Test::Failure( "Could not open " + name );
+		return std::vector< uint8_t >( file.Data(), file.Data() + file.Size() );
+	}
+}
+
+TEST_CASE( ReadsLibraryAttributes )
+{
+	Library dia( "dia2.tlb" );
+	const TypeLibReader& reader = *dia.reader;
+
+	CHECK_EQUAL( "Dia2Lib", reader.name );
+	CHECK_EQUAL( "dia 2.0 Type Library", reader.docString );
+	CHECK_EQUAL( "{106173A0-0173-4E5C-84E7-E915422BE997}", reader.guid.ToString() );
+	CHECK_EQUAL( 2, reader.majorVersion );
+	CHECK_EQUAL( 0, reader.minorVersion );
+	CHECK_EQUAL( 0x409u, reader.lcid );
+
+	// SYS_WIN64
+	CHECK_EQUAL( 3, reader.syskind );
+	CHECK_EQUAL( 8u, reader.PointerSize() );
+	CHECK_EQUAL( 48u, reader.types.size() );
+}
+
+TEST_CASE( ReadsTypeAttributes )
+{
+	Library dia( "dia2.tlb" );
+
+	const TypeLibReader::TypeInfo& source = dia.Type( "IDiaDataSource" );
+	CHECK_EQUAL( TypeLibReader::TkInterface, source.typekind );
+	CHECK_EQUAL( "{79F1BB5F-B66E-48E5-B6A9-1545C323CA3D}", source.guid.ToString() );
+	CHECK_EQUAL( "IDiaDataSource Interface", source.docString );
+	CHECK_EQUAL( 8u, source.funcs.size() );
+	CHECK_EQUAL( 0u, source.vars.size() );
+
+	// IUnknown plus the eight members.
+	CHECK_EQUAL( 88, source.cbSizeVft );
+
+	const TypeLibReader::TypeInfo& coclass = dia.Type( "DiaSource" );
+	CHECK_EQUAL( TypeLibReader::TkCoclass, coclass.typekind );
+	CHECK_EQUAL( "{E6756135-1E65-4D17-8576-610761398C3C}", coclass.guid.ToString() );
+
+	// TYPEFLAG_FCANCREATE
+	CHECK_EQUAL( 0x2, coclass.flags );
+
+	const TypeLibReader::TypeInfo& statstg = dia.Type( "tagSTATSTG" );
+	CHECK_EQUAL( TypeLibReader::TkRecord, statstg.typekind );
+	CHECK_EQUAL( 11u, statstg.vars.size() );
+	CHECK_EQUAL( 80u, statstg.cbSizeInstance );
+	CHECK_EQUAL( 8, statstg.alignment );
+}
+
+TEST_CASE( ReadsFunctions )
+{
+	Library dia( "dia2.tlb" );
+	const TypeLibReader::TypeInfo& source = dia.Type( "IDiaDataSource" );
+
+	// [propget, id(1)] HRESULT lastError([out, retval] BSTR* pRetVal)
+	const TypeLibReader::FuncInfo& lastError = source.funcs[ 0 ];
+	CHECK_EQUAL( "lastError", lastError.name );
+	CHECK_EQUAL( 1, lastError.memid );
+	CHECK_EQUAL( 2, lastError.invkind );
+	CHECK_EQUAL( 1, lastError.funckind );
+	CHECK_EQUAL( 4, lastError.callconv );
+	CHECK_EQUAL( 24, lastError.oVft );
+	CHECK_EQUAL( VtHresult, lastError.returnType.vt );
+	CHECK_EQUAL( 1u, lastError.params.size() );
+	CHECK_EQUAL( "pRetVal", lastError.params[ 0 ].name );
+	CHECK_EQUAL( TypeLibReader::VtPtr, lastError.params[ 0 ].type.vt );
+	CHECK_EQUAL( VtBstr, lastError.params[ 0 ].type.pointee->vt );
+	CHECK_EQUAL( ParamOut | TypeLibReader::ParamFlagRetval, lastError.params[ 0 ].flags );
+
+	// HRESULT loadAndValidateDataFromPdb([in] LPCOLESTR pdbPath, [in] GUID* pcsig70, [in] DWORD sig, [in] DWORD age)
+	const TypeLibReader::FuncInfo& validate = Func( source, "loadAndValidateDataFromPdb" );
+	CHECK_EQUAL( 0x60010002, validate.memid );
+	CHECK_EQUAL( 1, validate.invkind );
+	CHECK_EQUAL( 40, validate.oVft );
+	CHECK_EQUAL( 0, validate.cParamsOpt );
+	CHECK_EQUAL( 4u, validate.params.size() );
+	CHECK_EQUAL( VtLpwstr, validate.params[ 0 ].type.vt );
+	CHECK_EQUAL( TypeLibReader::VtPtr, validate.params[ 1 ].type.vt );
+	CHECK_EQUAL( TypeLibReader::VtUserDefined, validate.params[ 1 ].type.pointee->vt );
+	CHECK_EQUAL( VtUI4, validate.params[ 2 ].type.vt );
+	CHECK_EQUAL( "age", validate.params[ 3 ].name );
+	CHECK_EQUAL( ParamIn, validate.params[ 3 ].flags );
+
+	// HRESULT loadDataFromCodeViewInfo(..., [in, size_is(cbCvInfo)] BYTE* pbCvInfo, [in] IUnknown* pCallback)
+	const TypeLibReader::FuncInfo& codeView = Func( source, "loadDataFromCodeViewInfo" );
+	CHECK_EQUAL( 5u, codeView.params.size() );
+	CHECK_EQUAL( VtUI1, codeView.params[ 3 ].type.pointee->vt );
+	CHECK_EQUAL( VtUnknown, codeView.params[ 4 ].type.vt );
+
+	// Standard DISPIDs on the collection interfaces.
+	const TypeLibReader::TypeInfo& symbols = dia.Type( "IDiaEnumSymbols" );
+	CHECK_EQUAL( -4, Func( symbols, "_NewEnum" ).memid );
+	CHECK_EQUAL( 0, Func( symbols, "Item" ).memid );
+	CHECK_EQUAL( 0x60010003, Func( symbols, "Next" ).memid );
+}
+
+TEST_CASE( ResolvesReferences )
+{
+	Library dia( "dia2.tlb" );
+	const TypeLibReader& reader = *dia.reader;
+
+	// [in] IStream* pIStream refers to a type in the library.
+	const TypeLibReader::FuncInfo& stream = Func( dia.Type( "IDiaDataSource" ), "loadDataFromIStream" );
+	uint32_t streamRef = stream.params[ 0 ].type.pointee->hreftype;
+	CHECK_EQUAL( 200u, streamRef );
+	CHECK_EQUAL( "IStream", reader.GetRefType( streamRef )->name );
+
+	// IStream derives from ISequentialStream in the same library.
+	const TypeLibReader::TypeInfo& istream = dia.Type( "IStream" );
+	CHECK_EQUAL( 1u, istream.implTypes.size() );
+	TypeLibReader::TypeRef base = reader.ResolveRef( istream.implTypes[ 0 ].hreftype );
+	CHECK( base.local );
+	CHECK_EQUAL( "ISequentialStream", reader.types[ base.index ].name );
+	CHECK_EQUAL( "{0C733A30-2A1C-11CE-ADE5-00AA0044773D}", base.guid.ToString() );
+
+	// Records by value.
+	const TypeLibReader::FuncInfo& seek = Func( istream, "RemoteSeek" );
+	CHECK_EQUAL( TypeLibReader::VtUserDefined, seek.params[ 0 ].type.vt );
+	CHECK_EQUAL( "_LARGE_INTEGER", reader.GetRefType( seek.params[ 0 ].type.hreftype )->name );
+
+	// IUnknown is imported from stdole2 by GUID.
+	const TypeLibReader::TypeInfo& source = dia.Type( "IDiaDataSource" );
+	TypeLibReader::TypeRef unknown = reader.ResolveRef( source.implTypes[ 0 ].hreftype );
+	CHECK( !unknown.local );
+	CHECK( unknown.hasGuid );
+	CHECK_EQUAL( "{00000000-0000-0000-C000-000000000046}", unknown.guid.ToString() );
+	CHECK_EQUAL( "stdole2.tlb", unknown.importFile );
+	CHECK( reader.GetRefType( source.implTypes[ 0 ].hreftype ) == nullptr );
+
+	// GUID is imported from stdole2 by its index.
+	const TypeLibReader::FuncInfo& validate = Func( source, "loadAndValidateDataFromPdb" );
+	TypeLibReader::TypeRef guid = reader.ResolveRef( validate.params[ 1 ].type.pointee->hreftype );
+	CHECK( !guid.local );
+	CHECK( !guid.hasGuid );
+	CHECK_EQUAL( 0, guid.index );
+	CHECK_EQUAL( "stdole2.tlb", guid.importFile );
+
+	// The default interface of the coclass.
+	const TypeLibReader::TypeInfo& coclass = dia.Type( "DiaSource" );
+	CHECK_EQUAL( 1u, coclass.implTypes.size() );
+	CHECK_EQUAL( 1, coclass.implTypes[ 0 ].flags );
+	CHECK_EQUAL( "IDiaDataSource", reader.GetRefType( coclass.implTypes[ 0 ].hreftype )->name );
+
+	CHECK_THROWS( TypeLibReader::FormatError, reader.ResolveRef( 100 * 1000 ) );
+}
+
+TEST_CASE( ReadsEnumValues )
+{
+	Library dia( "dia2.tlb" );
+
+	// enum SymTagEnum { SymTagNull, SymTagExe, ..., SymTagMax } from cvconst.h
+	const TypeLibReader::TypeInfo& symTag = dia.Type( "SymTagEnum" );
+	CHECK_EQUAL( TypeLibReader::TkEnum, symTag.typekind );
+	CHECK_EQUAL( 44u, symTag.vars.size() );
+	for( size_t i = 0; i < symTag.vars.size(); i++ )
+	{
+		CHECK( symTag.vars[ i ].hasValue );
+		CHECK_EQUAL( static_cast< int64_t >( i ), symTag.vars[ i ].value.intValue );
+	}
+	CHECK_EQUAL( "SymTagExe", symTag.vars[ 1 ].name );
+	CHECK_EQUAL( "SymTagMax", symTag.vars.back().name );
+	CHECK_EQUAL( 0x40000000 + 43, symTag.vars.back().memid );
+
+	// MemTypeAny = -1 doesn't fit the offset and is stored as custom data.
+	const TypeLibReader::TypeInfo& memoryType = dia.Type( "MemoryTypeEnum" );
+	CHECK_EQUAL( "MemTypeAny", memoryType.vars.back().name );
+	CHECK_EQUAL( VtI4, memoryType.vars.back().value.vt );
+	CHECK_EQUAL( -1, memoryType.vars.back().value.intValue );
+
+	// Record fields are per instance.
+	const TypeLibReader::TypeInfo& largeInteger = dia.Type( "_LARGE_INTEGER" );
+	CHECK_EQUAL( "QuadPart", largeInteger.vars[ 0 ].name );
+	CHECK_EQUAL( VtI8, largeInteger.vars[ 0 ].type.vt );
+	CHECK_EQUAL( 0, largeInteger.vars[ 0 ].varkind );
+	CHECK( !largeInteger.vars[ 0 ].hasValue );
+}
+
+TEST_CASE( ReadsImportedCoclassInterface )
+{
+	Library executor( "executor.tlb" );
+	const TypeLibReader& reader = *executor.reader;
+
+	CHECK_EQUAL( "ComExecutorServer", reader.name );
+	CHECK_EQUAL( "{9CB4FAD6-7BBF-4A14-A58E-74B2226FCE13}", reader.guid.ToString() );
+	CHECK_EQUAL( 1u, reader.types.size() );
+
+	const TypeLibReader::TypeInfo& coclass = reader.types[ 0 ];
+	CHECK_EQUAL( "CComExecutor", coclass.name );
+	CHECK_EQUAL( TypeLibReader::TkCoclass, coclass.typekind );
+	CHECK_EQUAL( "{6FF9D910-9D48-495C-AAAD-C82E9EE05EC1}", coclass.guid.ToString() );
+
+	// The only interface is IUnknown from stdole2.
+	CHECK_EQUAL( 1u, coclass.implTypes.size() );
+	TypeLibReader::TypeRef ref = reader.ResolveRef( coclass.implTypes[ 0 ].hreftype );
+	CHECK( !ref.local );
+	CHECK( ref.hasGuid );
+	CHECK_EQUAL( "{00000000-0000-0000-C000-000000000046}", ref.guid.ToString() );
+	CHECK_EQUAL( "stdole2.tlb", ref.importFile );
+}
+
+TEST_CASE( ConvertsDualFunctionsToDispatch )
+{
+	Library sample( "sample.tlb" );
+	const TypeLibReader& reader = *sample.reader;
+
+	const TypeLibReader::TypeInfo& thing = sample.Type( "IThing" );
+	CHECK_EQUAL( TypeLibReader::TkDispatch, thing.typekind );
+	CHECK( ( thing.flags & TypeLibReader::TypeFlagDual ) != 0 );
+	CHECK_EQUAL( 4u, thing.funcs.size() );
+
+	// The base is IDispatch from stdole.
+	CHECK_EQUAL( 1u, thing.implTypes.size() );
+	TypeLibReader::TypeRef base = reader.ResolveRef( thing.implTypes[ 0 ].hreftype );
+	CHECK( !base.local );
+	CHECK_EQUAL( "stdole2.tlb", base.importFile );
+	CHECK_EQUAL( "{00020400-0000-0000-C000-000000000046}", base.guid.ToString() );
+
+	// The property put shares the name of the get.
+	CHECK_EQUAL( "Name", thing.funcs[ 1 ].name );
+	CHECK_EQUAL( 4, thing.funcs[ 1 ].invkind );
+
+	// [out, retval] becomes the return value.
+	TypeLibReader::FuncInfo name = TypeLibReader::ToDispatch( thing.funcs[ 0 ] );
+	CHECK_EQUAL( VtBstr, name.returnType.vt );
+	CHECK_EQUAL( 0u, name.params.size() );
+
+	TypeLibReader::FuncInfo put = TypeLibReader::ToDispatch( thing.funcs[ 1 ] );
+	CHECK_EQUAL( VtVoid, put.returnType.vt );
+	CHECK_EQUAL( 1u, put.params.size() );
+
+	TypeLibReader::FuncInfo getColor = TypeLibReader::ToDispatch( Func( thing, "GetColor" ) );
+	CHECK_EQUAL( TypeLibReader::VtUserDefined, getColor.returnType.vt );
+	CHECK_EQUAL( "Color", reader.GetRefType( getColor.returnType.hreftype )->name );
+
+	// [in, defaultvalue(2)] Color c
+	CHECK_EQUAL( 1u, getColor.params.size() );
+	CHECK( getColor.params[ 0 ].hasDefault );
+	CHECK_EQUAL( VtI4, getColor.params[ 0 ].defaultValue.vt );
+	CHECK_EQUAL( 2, getColor.params[ 0 ].defaultValue.intValue );
+
+	const TypeLibReader::TypeInfo& color = sample.Type( "Color" );
+	CHECK_EQUAL( 1, color.vars[ 0 ].value.intValue );
+	CHECK_EQUAL( -5, color.vars[ 1 ].value.intValue );
+}
+
+TEST_CASE( FindsLibraryInImage )
+{
+	// Embedded libraries are found after the PE headers.
+	std::vector< uint8_t > tlb = ReadFixture( "executor.tlb" );
+	std::vector< uint8_t > image( 0x400, 0 );
+	image[ 0 ] = 'M';
+	image[ 1 ] = 'Z';
+	image.insert( image.end(), tlb.begin(), tlb.end() );
+
+	TypeLibReader reader( image.data(), image.size() );
+	CHECK_EQUAL( "ComExecutorServer", reader.name );
+	CHECK_EQUAL( 1u, reader.types.size() );
+
+	std::vector< uint8_t > empty( 0x400, 0 );
+	empty[ 0 ] = 'M';
+	empty[ 1 ] = 'Z';
+	CHECK_THROWS( TypeLibReader::FormatError, TypeLibReader( empty.data(), empty.size() ) );
+}
+
+TEST_CASE( RejectsInvalidData )
+{
+	std::vector< uint8_t > tlb = ReadFixture( "dia2.tlb" );
+
+	// Every truncation of the library either fails cleanly or still parses.
+	for( size_t length = 0; length < tlb.size(); length += 97 )
+	{
+		try
+		{
+			TypeLibReader reader( tlb.data(), length );
+		}
+		catch( const TypeLibReader::FormatError& )
+		{
+		}
+	}
+	CHECK_THROWS( TypeLibReader::FormatError, TypeLibReader( tlb.data(), tlb.size() / 2 ) );
+
+	std::vector< uint8_t > sltg( tlb.begin(), tlb.begin() + 0x100 );
+	memcpy( sltg.data(), "SLTG", 4 );
+	CHECK_THROWS( TypeLibReader::FormatError, TypeLibReader( sltg.data(), sltg.size() ) );
+
+	std::vector< uint8_t > garbage( 0x100, 0x5a );
+	CHECK_THROWS( TypeLibReader::FormatError, TypeLibReader( garbage.data(), garbage.size() ) );
+}
+
+#ifdef _WIN32
+
+namespace
+{
+	std::string Narrow( BSTR str )
+	{
+		std::string out;
+		for( UINT i = 0; str != nullptr && i < SysStringLen( str ); i++ )
+			out.push_back( static_cast< char >( str[ i ] ) );
+		return out;
+	}
+
+	void CompareTypeDesc( const TYPEDESC& expected, const TypeLibReader::TypeDesc& actual )
+	{
+		CHECK_EQUAL( expected.vt, actual.vt );
+		if( expected.vt == VT_PTR || expected.vt == VT_SAFEARRAY )
+		{
+			CHECK( actual.pointee != nullptr );
+			CompareTypeDesc( *expected.lptdesc, *actual.pointee );
+		}
+		else if( expected.vt == VT_USERDEFINED )
+		{
+			CHECK_EQUAL( static_cast< uint32_t >( expected.hreftype ), actual.hreftype );
+		}
+	}
+
+	/**
+	 * Compares everything the reader exposes with what oleaut32 reads from the same file.
+	 */
+	void CompareWithTypeInfo( const std::string& fixture )
+	{
+		Library library( fixture );
+		const TypeLibReader& reader = *library.reader;
+
+		std::string path = Test::Fixture( fixture );
+		std::wstring widePath( path.begin(), path.end() );
+		ITypeLib* typeLib = nullptr;
+		CHECK( SUCCEEDED( LoadTypeLibEx( widePath.c_str(), REGKIND_NONE, &typeLib ) ) );
+		CHECK_EQUAL( static_cast< size_t >( typeLib->GetTypeInfoCount() ), reader.types.size() );
+
+		for( UINT t = 0; t < typeLib->GetTypeInfoCount(); t++ )
+		{
+			const TypeLibReader::TypeInfo& type = reader.types[ t ];
+			ITypeInfo* typeInfo = nullptr;
+			CHECK( SUCCEEDED( typeLib->GetTypeInfo( t, &typeInfo ) ) );
+
+			BSTR name = nullptr;
+			typeInfo->GetDocumentation( MEMBERID_NIL, &name, nullptr, nullptr, nullptr );
+			CHECK_EQUAL( Narrow( name ), type.name );
+			SysFreeString( name );
+
+			TYPEATTR* attr = nullptr;
+			typeInfo->GetTypeAttr( &attr );
+			CHECK( memcmp( &attr->guid, &type.guid, sizeof( GUID ) ) == 0 );
+			CHECK_EQUAL( static_cast< int >( attr->typekind ), static_cast< int >( type.typekind ) );
+			CHECK_EQUAL( attr->wTypeFlags, type.flags );
+			CHECK_EQUAL( static_cast< size_t >( attr->cFuncs ), type.funcs.size() );
+			CHECK_EQUAL( static_cast< size_t >( attr->cVars ), type.vars.size() );
+			CHECK_EQUAL( static_cast< size_t >( attr->cImplTypes ), type.implTypes.size() );
+			CHECK_EQUAL( attr->cbSizeVft, type.cbSizeVft );
+
+			for( UINT i = 0; i < attr->cImplTypes; i++ )
+			{
+				HREFTYPE href;
+				INT flags = 0;
+				typeInfo->GetRefTypeOfImplType( i, &href );
+				typeInfo->GetImplTypeFlags( i, &flags );
+				CHECK_EQUAL( static_cast< uint32_t >( href ), type.implTypes[ i ].hreftype );
+				if( type.typekind == TypeLibReader::TkCoclass )
+					CHECK_EQUAL( flags, type.implTypes[ i ].flags );
+			}
+
+			for( UINT f = 0; f < attr->cFuncs; f++ )
+			{
+				const TypeLibReader::FuncInfo& func = type.funcs[ f ];
+				FUNCDESC* desc = nullptr;
+				typeInfo->GetFuncDesc( f, &desc );
+
+				BSTR funcName = nullptr;
+				typeInfo->GetDocumentation( desc->memid, &funcName, nullptr, nullptr, nullptr );
+				CHECK_EQUAL( Narrow( funcName ), func.name );
+				SysFreeString( funcName );
+
+				CHECK_EQUAL( static_cast< int32_t >( desc->memid ), func.memid );
+				CHECK_EQUAL( static_cast< int >( desc->funckind ), static_cast< int >( func.funckind ) );
+				CHECK_EQUAL( static_cast< int >( desc->invkind ), static_cast< int >( func.invkind ) );
+				CHECK_EQUAL( static_cast< int >( desc->callconv ), static_cast< int >( func.callconv ) );
+				CHECK_EQUAL( desc->oVft, func.oVft );
+				CHECK_EQUAL( desc->cParamsOpt, func.cParamsOpt );
+				CHECK_EQUAL( static_cast< size_t >( desc->cParams ), func.params.size() );
+				CompareTypeDesc( desc->elemdescFunc.tdesc, func.returnType );
+
+				for( SHORT p = 0; p < desc->cParams; p++ )
+				{
+					const ELEMDESC& elem = desc->lprgelemdescParam[ p ];
+					CompareTypeDesc( elem.tdesc, func.params[ p ].type );
+					CHECK_EQUAL( elem.paramdesc.wParamFlags, func.params[ p ].flags );
+				}
+
+				typeInfo->ReleaseFuncDesc( desc );
+			}
+
+			for( UINT v = 0; v < attr->cVars; v++ )
+			{
+				const TypeLibReader::VarInfo& var = type.vars[ v ];
+				VARDESC* desc = nullptr;
+				typeInfo->GetVarDesc( v, &desc );
+				CHECK_EQUAL( static_cast< int32_t >( desc->memid ), var.memid );
+				CHECK_EQUAL( static_cast< int >( desc->varkind ), static_cast< int >( var.varkind ) );
+				CompareTypeDesc( desc->elemdescVar.tdesc, var.type );
+
+				if( desc->varkind == VAR_CONST )
+				{
+					VARIANT value;
+					VariantInit( &value );
+					VariantChangeType( &value, desc->lpvarValue, 0, VT_I8 );
+					CHECK_EQUAL( static_cast< int64_t >( value.llVal ), var.value.intValue );
+				}
+
+				typeInfo->ReleaseVarDesc( desc );
+			}
+
+			typeInfo->ReleaseTypeAttr( attr );
+			typeInfo->Release();
+		}
+
+		typeLib->Release();
+	}
+}
+
+TEST_CASE( MatchesTypeInfo )
+{
+	CompareWithTypeInfo( "dia2.tlb" );
+	CompareWithTypeInfo( "executor.tlb" );
+}
+
+#endif
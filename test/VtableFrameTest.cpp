@@ -0,0 +1,266 @@
+#include "Test.h"
+
+#include "VtableFrame.h"
+
+#include <cstdint>
+
+/**
+ * Calls through VtableFrame into mock objects that have the vtable layout
+ * of a COM interface: the IUnknown members first, then the interface members
+ * in declaration order. The Win64 convention is checked on any x64 target
+ * through ms_abi members.
+ */
+#if defined( _M_X64 ) || defined( __x86_64__ )
+
+namespace
+{
+	const int32_t Failed = static_cast< int32_t >( 0x80004005 );
+
+	/**
+	 * Arguments received by the mock members.
+	 */
+	struct Received
+	{
+		Received() : integers(), reals(), singles(), integerCount( 0 ), realCount( 0 ), singleCount( 0 ) {}
+
+		int32_t Mixed( int32_t a, double b, float c, int64_t d, int64_t* result )
+		{
+			integers[ integerCount++ ] = a;
+			reals[ realCount++ ] = b;
+			singles[ singleCount++ ] = c;
+			integers[ integerCount++ ] = d;
+			*result = a + d;
+			return 0;
+		}
+
+		int32_t Many(
+				int16_t i1, double r1, float s1, int64_t i2, double r2, float s2, int32_t i3, double r3,
+				float s3, uint8_t i4, double r4, float s4, double r5, float s5, int64_t i5, double* result )
+		{
+			int64_t ints[] = { i1, i2, i3, i4, i5 };
+			double doubles[] = { r1, r2, r3, r4, r5 };
+			float floats[] = { s1, s2, s3, s4, s5 };
+			for( int i = 0; i < 5; i++ )
+			{
+				integers[ integerCount++ ] = ints[ i ];
+				reals[ realCount++ ] = doubles[ i ];
+				singles[ singleCount++ ] = floats[ i ];
+			}
+
+			*result = r1 + r2 + r3 + r4 + r5;
+			return 1;
+		}
+
+		int32_t Singles( float a, float b, float c, float* result )
+		{
+			singles[ singleCount++ ] = a;
+			singles[ singleCount++ ] = b;
+			singles[ singleCount++ ] = c;
+			*result = a + b + c;
+			return 0;
+		}
+
+		int64_t integers[ 16 ];
+		double reals[ 16 ];
+		float singles[ 16 ];
+		int integerCount;
+		int realCount;
+		int singleCount;
+	};
+
+	enum Slots { MixedSlot = 3, ManySlot, SinglesSlot, FailSlot };
+
+	class Win64Mock
+	{
+	public:
+		virtual int32_t VTABLE_FRAME_WIN64 QueryInterface( const void*, void** ) { return Failed; }
+		virtual uint32_t VTABLE_FRAME_WIN64 AddRef() { return 1; }
+		virtual uint32_t VTABLE_FRAME_WIN64 Release() { return 1; }
+
+		virtual int32_t VTABLE_FRAME_WIN64 Mixed( int32_t a, double b, float c, int64_t d, int64_t* result )
+		{
+			return received.Mixed( a, b, c, d, result );
+		}
+
+		virtual int32_t VTABLE_FRAME_WIN64 Many(
+				int16_t i1, double r1, float s1, int64_t i2, double r2, float s2, int32_t i3, double r3,
+				float s3, uint8_t i4, double r4, float s4, double r5, float s5, int64_t i5, double* result )
+		{
+			return received.Many( i1, r1, s1, i2, r2, s2, i3, r3, s3, i4, r4, s4, r5, s5, i5, result );
+		}
+
+		virtual int32_t VTABLE_FRAME_WIN64 Singles( float a, float b, float c, float* result )
+		{
+			return received.Singles( a, b, c, result );
+		}
+
+		virtual int32_t VTABLE_FRAME_WIN64 Fail( int32_t code ) { return code; }
+
+		Received received;
+	};
+
+#if defined( __x86_64__ )
+
+	class SysVMock
+	{
+	public:
+		virtual int32_t VTABLE_FRAME_SYSV QueryInterface( const void*, void** ) { return Failed; }
+		virtual uint32_t VTABLE_FRAME_SYSV AddRef() { return 1; }
+		virtual uint32_t VTABLE_FRAME_SYSV Release() { return 1; }
+
+		virtual int32_t VTABLE_FRAME_SYSV Mixed( int32_t a, double b, float c, int64_t d, int64_t* result )
+		{
+			return received.Mixed( a, b, c, d, result );
+		}
+
+		virtual int32_t VTABLE_FRAME_SYSV Many(
+				int16_t i1, double r1, float s1, int64_t i2, double r2, float s2, int32_t i3, double r3,
+				float s3, uint8_t i4, double r4, float s4, double r5, float s5, int64_t i5, double* result )
+		{
+			return received.Many( i1, r1, s1, i2, r2, s2, i3, r3, s3, i4, r4, s4, r5, s5, i5, result );
+		}
+
+		virtual int32_t VTABLE_FRAME_SYSV Singles( float a, float b, float c, float* result )
+		{
+			return received.Singles( a, b, c, result );
+		}
+
+		virtual int32_t VTABLE_FRAME_SYSV Fail( int32_t code ) { return code; }
+
+		Received received;
+	};
+
+#endif
+
+	void* Slot( void* object, size_t index )
+	{
+		return ( *reinterpret_cast< void*** >( object ) )[ index ];
+	}
+
+	uint64_t Pointer( void* pointer )
+	{
+		return reinterpret_cast< uintptr_t >( pointer );
+	}
+
+	/**
+	 * Sign extends like DirectCall does for the signed integer types.
+	 */
+	uint64_t Signed( int64_t value )
+	{
+		return static_cast< uint64_t >( value );
+	}
+
+	template< typename Frame, typename Mock >
+	void CheckMixed()
+	{
+		Mock mock;
+		int64_t result = 0;
+		Frame frame;
+		frame.AddInteger( Signed( -7 ) );
+		frame.AddReal( 2.5 );
+		frame.AddSingle( 0.25f );
+		frame.AddInteger( Signed( 1ll << 40 ) );
+		frame.AddInteger( Pointer( &result ) );
+
+		CHECK_EQUAL( 0, frame.template Call< int32_t >( Slot( &mock, MixedSlot ), &mock ) );
+		CHECK_EQUAL( 2, mock.received.integerCount );
+		CHECK_EQUAL( -7, mock.received.integers[ 0 ] );
+		CHECK_EQUAL( 2.5, mock.received.reals[ 0 ] );
+		CHECK_EQUAL( 0.25f, mock.received.singles[ 0 ] );
+		CHECK_EQUAL( 1ll << 40, mock.received.integers[ 1 ] );
+		CHECK_EQUAL( ( 1ll << 40 ) - 7, result );
+	}
+
+	template< typename Frame, typename Mock >
+	void CheckMany()
+	{
+		// More of each class than either convention has registers for.
+		Mock mock;
+		double result = 0;
+		Frame frame;
+		frame.AddInteger( Signed( -300 ) );
+		frame.AddReal( 1.5 );
+		frame.AddSingle( -1.25f );
+		frame.AddInteger( Signed( -( 1ll << 50 ) ) );
+		frame.AddReal( 2.5 );
+		frame.AddSingle( 2.75f );
+		frame.AddInteger( Signed( -2000000000 ) );
+		frame.AddReal( 3.5 );
+		frame.AddSingle( 3.125f );
+		frame.AddInteger( 200 );
+		frame.AddReal( 4.5 );
+		frame.AddSingle( 4.0625f );
+		frame.AddReal( 5.5 );
+		frame.AddSingle( -5.5f );
+		frame.AddInteger( Signed( 123456789012345ll ) );
+		frame.AddInteger( Pointer( &result ) );
+		CHECK_EQUAL( VtableFrame::MaxArgs, frame.Count() );
+
+		CHECK_EQUAL( 1, frame.template Call< int32_t >( Slot( &mock, ManySlot ), &mock ) );
+
+		const Received& received = mock.received;
+		CHECK_EQUAL( 5, received.integerCount );
+		CHECK_EQUAL( -300, received.integers[ 0 ] );
+		CHECK_EQUAL( -( 1ll << 50 ), received.integers[ 1 ] );
+		CHECK_EQUAL( -2000000000, received.integers[ 2 ] );
+		CHECK_EQUAL( 200, received.integers[ 3 ] );
+		CHECK_EQUAL( 123456789012345ll, received.integers[ 4 ] );
+
+		CHECK_EQUAL( 1.5, received.reals[ 0 ] );
+		CHECK_EQUAL( 2.5, received.reals[ 1 ] );
+		CHECK_EQUAL( 3.5, received.reals[ 2 ] );
+		CHECK_EQUAL( 4.5, received.reals[ 3 ] );
+		CHECK_EQUAL( 5.5, received.reals[ 4 ] );
+
+		CHECK_EQUAL( -1.25f, received.singles[ 0 ] );
+		CHECK_EQUAL( 2.75f, received.singles[ 1 ] );
+		CHECK_EQUAL( 3.125f, received.singles[ 2 ] );
+		CHECK_EQUAL( 4.0625f, received.singles[ 3 ] );
+		CHECK_EQUAL( -5.5f, received.singles[ 4 ] );
+
+		CHECK_EQUAL( 17.5, result );
+	}
+
+	template< typename Frame, typename Mock >
+	void CheckSingles()
+	{
+		Mock mock;
+		float result = 0;
+		Frame frame;
+		frame.AddSingle( 1.5f );
+		frame.AddSingle( -0.5f );
+		frame.AddSingle( 8.25f );
+		frame.AddInteger( Pointer( &result ) );
+
+		CHECK_EQUAL( 0, frame.template Call< int32_t >( Slot( &mock, SinglesSlot ), &mock ) );
+		CHECK_EQUAL( 1.5f, mock.received.singles[ 0 ] );
+		CHECK_EQUAL( -0.5f, mock.received.singles[ 1 ] );
+		CHECK_EQUAL( 8.25f, mock.received.singles[ 2 ] );
+		CHECK_EQUAL( 9.25f, result );
+	}
+
+	template< typename Frame, typename Mock >
+	void CheckFailure()
+	{
+		Mock mock;
+		Frame frame;
+		frame.AddInteger( Signed( Failed ) );
+		CHECK_EQUAL( Failed, frame.template Call< int32_t >( Slot( &mock, FailSlot ), &mock ) );
+	}
+}
+
+TEST_CASE( Win64PassesMixedArguments ) { CheckMixed< VtableFrame::Win64, Win64Mock >(); }
+TEST_CASE( Win64SpillsToTheStack ) { CheckMany< VtableFrame::Win64, Win64Mock >(); }
+TEST_CASE( Win64PassesSingles ) { CheckSingles< VtableFrame::Win64, Win64Mock >(); }
+TEST_CASE( Win64ReturnsFailures ) { CheckFailure< VtableFrame::Win64, Win64Mock >(); }
+
+#if defined( __x86_64__ )
+
+TEST_CASE( SysVPassesMixedArguments ) { CheckMixed< VtableFrame::SysV, SysVMock >(); }
+TEST_CASE( SysVSpillsToTheStack ) { CheckMany< VtableFrame::SysV, SysVMock >(); }
+TEST_CASE( SysVPassesSingles ) { CheckSingles< VtableFrame::SysV, SysVMock >(); }
+TEST_CASE( SysVReturnsFailures ) { CheckFailure< VtableFrame::SysV, SysVMock >(); }
+
+#endif
+
+#endif
@@ -0,0 +1,398 @@
+#include "Test.h"
+
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * The scheduler core with mock tasks in place of the invoke batons.
+ *
+ * The tests drive the pool the way InvokePool does: the notify callback
+ * only signals, and the owner thread completes the finished tasks.
+ */
+namespace
+{
+	/**
+	 * Blocks the tasks that wait on it until it is opened.
+	 */
+	class Gate
+	{
+	public:
+		Gate() : open( false ) {}
+
+		void Open()
+		{
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				open = true;
+			}
+			changed.notify_all();
+		}
+
+		void Wait()
+		{
+			std::unique_lock< std::mutex > lock( mutex );
+			changed.wait( lock, [ this ]() { return open; } );
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable changed;
+		bool open;
+	};
+
+	struct Counters
+	{
+		Counters() : executed( 0 ), completed( 0 ), released( 0 ), notified( 0 ), wrongThread( 0 ) {}
+
+		std::atomic< int > executed;
+		std::atomic< int > completed;
+		std::atomic< int > released;
+		std::atomic< int > notified;
+		std::atomic< int > wrongThread;
+	};
+
+	class MockTask : public WorkerPool::Task
+	{
+	public:
+		MockTask( Counters& counters, std::thread::id owner, Gate* gate = nullptr,
+				std::chrono::milliseconds completeTime = std::chrono::milliseconds( 0 ) )
+			: counters( counters ), owner( owner ), gate( gate ), completeTime( completeTime ) {}
+
+		void Execute() override
+		{
+			if( std::this_thread::get_id() == owner )
+				counters.wrongThread++;
+			if( gate != nullptr )
+				gate->Wait();
+			counters.executed++;
+		}
+
+		void Complete() override
+		{
+			if( std::this_thread::get_id() != owner )
+				counters.wrongThread++;
+			std::this_thread::sleep_for( completeTime );
+			counters.completed++;
+		}
+
+		void Release() override
+		{
+			counters.released++;
+			delete this;
+		}
+
+	private:
+		Counters& counters;
+		std::thread::id owner;
+		Gate* gate;
+		std::chrono::milliseconds completeTime;
+	};
+
+	/**
+	 * Task that has to execute in the owner thread.
+	 */
+	class OwnerTask : public WorkerPool::Task
+	{
+	public:
+		OwnerTask( Counters& counters, std::thread::id owner ) : counters( counters ), owner( owner ) {}
+
+		void Execute() override
+		{
+			if( std::this_thread::get_id() != owner )
+				counters.wrongThread++;
+			counters.executed++;
+		}
+
+		void Complete() override
+		{
+			if( std::this_thread::get_id() != owner )
+				counters.wrongThread++;
+			counters.completed++;
+		}
+
+		void Release() override
+		{
+			counters.released++;
+			delete this;
+		}
+
+	private:
+		Counters& counters;
+		std::thread::id owner;
+	};
+
+	WorkerPool::Callback Notify( Counters& counters )
+	{
+		return [ &counters ]() { counters.notified++; };
+	}
+
+	/**
+	 * Waits until the workers have executed the given number of tasks.
+	 */
+	void WaitExecuted( const WorkerPool& pool, uint64_t count )
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+		while( pool.GetStats().completed < count )
+		{
+			if( std::chrono::steady_clock::now() > deadline )
+				throw Test::Failure( "Timed out waiting for the workers" );
+			std::this_thread::yield();
+		}
+	}
+}
+
+TEST_CASE( ExecutesAndCompletesEveryTask )
+{
+	Counters counters;
+	const int count = 2000;
+	{
+		WorkerPool pool( 4, nullptr, nullptr, Notify( counters ) );
+		for( int i = 0; i < count; i++ )
+			pool.Submit( new MockTask( counters, std::this_thread::get_id() ) );
+
+		WaitExecuted( pool, count );
+		size_t completed = 0;
+		while( pool.HasCompleted() )
+			completed += pool.RunCompleted();
+
+		CHECK_EQUAL( static_cast< size_t >( count ), completed );
+
+		WorkerPool::Stats stats = pool.GetStats();
+		CHECK_EQUAL( 4u, stats.threads );
+		CHECK_EQUAL( 0u, stats.queued );
+		CHECK_EQUAL( 0u, stats.active );
+		CHECK_EQUAL( static_cast< uint64_t >( count ), stats.submitted );
+	}
+
+	// Execute in the workers, Complete and Release once each in the owner.
+	CHECK_EQUAL( count, counters.executed.load() );
+	CHECK_EQUAL( count, counters.completed.load() );
+	CHECK_EQUAL( count, counters.released.load() );
+	CHECK_EQUAL( 0, counters.wrongThread.load() );
+	CHECK( counters.notified.load() >= 1 );
+}
+
+TEST_CASE( QueuedCountNeverUnderflows )
+{
+	// Workers take the tasks as soon as they are queued. Another thread
+	// samples the queued count, which must stay within the submitted tasks.
+	Counters counters;
+	WorkerPool pool( 4, nullptr, nullptr, nullptr );
+	const size_t count = 50000;
+
+	std::atomic< bool > done( false );
+	std::atomic< size_t > maxQueued( 0 );
+	std::thread sampler( [ & ]() {
+		while( !done )
+		{
+			size_t queued = pool.GetStats().queued;
+			if( queued > maxQueued )
+				maxQueued = queued;
+		}
+	} );
+
+	for( size_t i = 0; i < count; i++ )
+		pool.Submit( new MockTask( counters, std::this_thread::get_id() ) );
+
+	WaitExecuted( pool, count );
+	done = true;
+	sampler.join();
+
+	CHECK( maxQueued.load() <= count );
+	CHECK_EQUAL( 0u, pool.GetStats().queued );
+	pool.RunCompleted();
+	CHECK_EQUAL( static_cast< int >( count ), counters.completed.load() );
+}
+
+TEST_CASE( NotifiesOncePerBurst )
+{
+	Counters counters;
+	Gate gate;
+	WorkerPool pool( 1, nullptr, nullptr, Notify( counters ) );
+
+	// The first task holds the only worker until the rest are queued.
+	pool.Submit( new MockTask( counters, std::this_thread::get_id(), &gate ) );
+	for( int i = 0; i < 10; i++ )
+		pool.Submit( new MockTask( counters, std::this_thread::get_id() ) );
+	gate.Open();
+
+	WaitExecuted( pool, 11 );
+	CHECK_EQUAL( 1, counters.notified.load() );
+	CHECK_EQUAL( 11u, pool.RunCompleted() );
+
+	// The list was emptied, so the next task notifies again.
+	pool.Submit( new MockTask( counters, std::this_thread::get_id() ) );
+	WaitExecuted( pool, 12 );
+	CHECK_EQUAL( 2, counters.notified.load() );
+	CHECK_EQUAL( 1u, pool.RunCompleted() );
+}
+
+TEST_CASE( CompletesInlineTasksWithTheOthers )
+{
+	Counters counters;
+	std::thread::id owner = std::this_thread::get_id();
+	{
+		WorkerPool pool( 2, nullptr, nullptr, Notify( counters ) );
+
+		// Executed before returning but only completed by the drain.
+		pool.ExecuteInline( new OwnerTask( counters, owner ) );
+		CHECK_EQUAL( 1, counters.executed.load() );
+		CHECK_EQUAL( 0, counters.completed.load() );
+		CHECK_EQUAL( 1, counters.notified.load() );
+
+		// The list wasn't drained, so the worker's task doesn't notify again.
+		pool.Submit( new MockTask( counters, owner ) );
+		WaitExecuted( pool, 2 );
+		CHECK_EQUAL( 1, counters.notified.load() );
+		CHECK_EQUAL( 2u, pool.RunCompleted() );
+		CHECK_EQUAL( 2u, pool.GetStats().submitted );
+	}
+
+	CHECK_EQUAL( 2, counters.completed.load() );
+	CHECK_EQUAL( 2, counters.released.load() );
+	CHECK_EQUAL( 0, counters.wrongThread.load() );
+}
+
+TEST_CASE( StopsCompletingAtBudget )
+{
+	Counters counters;
+	WorkerPool pool( 2, nullptr, nullptr, nullptr );
+	for( int i = 0; i < 5; i++ )
+		pool.Submit( new MockTask( counters, std::this_thread::get_id(), nullptr, std::chrono::milliseconds( 2 ) ) );
+	WaitExecuted( pool, 5 );
+
+	// At least one task is completed per call, then the budget ends the drain.
+	CHECK_EQUAL( 1u, pool.RunCompleted( std::chrono::nanoseconds( 1 ) ) );
+	CHECK( pool.HasCompleted() );
+
+	CHECK_EQUAL( 4u, pool.RunCompleted() );
+	CHECK( !pool.HasCompleted() );
+	CHECK_EQUAL( 5, counters.completed.load() );
+}
+
+TEST_CASE( StealsFromBusyWorkers )
+{
+	Counters counters;
+	Gate gate;
+	WorkerPool pool( 2, nullptr, nullptr, nullptr );
+
+	// Tasks alternate between the two queues. With one worker blocked, the
+	// other one has to steal the tasks queued behind the blocked one.
+	pool.Submit( new MockTask( counters, std::this_thread::get_id(), &gate ) );
+	for( int i = 0; i < 9; i++ )
+		pool.Submit( new MockTask( counters, std::this_thread::get_id() ) );
+
+	WaitExecuted( pool, 9 );
+	CHECK( pool.GetStats().stolen >= 1 );
+	CHECK_EQUAL( 1u, pool.GetStats().active );
+
+	gate.Open();
+	WaitExecuted( pool, 10 );
+	CHECK_EQUAL( 10u, pool.RunCompleted() );
+}
+
+TEST_CASE( RunsThreadHooks )
+{
+	std::atomic< int > initialized( 0 );
+	std::atomic< int > exited( 0 );
+	Counters counters;
+	{
+		WorkerPool pool( 3,
+				[ & ]() { initialized++; },
+				[ & ]() { exited++; },
+				nullptr );
+
+		for( int i = 0; i < 10; i++ )
+			pool.Submit( new MockTask( counters, std::this_thread::get_id() ) );
+		WaitExecuted( pool, 10 );
+		pool.RunCompleted();
+	}
+
+	CHECK_EQUAL( 3, initialized.load() );
+	CHECK_EQUAL( 3, exited.load() );
+}
+
+TEST_CASE( ReleasesUncompletedTasksOnDestruction )
+{
+	Counters counters;
+	Gate gate;
+	{
+		WorkerPool pool( 1, nullptr, nullptr, nullptr );
+		pool.Submit( new MockTask( counters, std::this_thread::get_id(), &gate ) );
+		for( int i = 0; i < 4; i++ )
+			pool.Submit( new MockTask( counters, std::this_thread::get_id() ) );
+
+		// Queued tasks still execute while the pool stops.
+		gate.Open();
+	}
+
+	CHECK_EQUAL( 5, counters.executed.load() );
+	CHECK_EQUAL( 0, counters.completed.load() );
+	CHECK_EQUAL( 5, counters.released.load() );
+}
+
+namespace
+{
+	/**
+	 * Stand-in for InvokeBatch: one task that executes its calls back to back.
+	 */
+	class MockBatch : public WorkerPool::Task
+	{
+	public:
+		explicit MockBatch( size_t calls ) : order( calls, 0 ), threads( calls ), executed( 0 ), completions( 0 ) {}
+
+		void Execute() override
+		{
+			for( size_t i = 0; i < order.size(); i++ )
+			{
+				order[ i ] = ++executed;
+				threads[ i ] = std::this_thread::get_id();
+			}
+		}
+
+		void Complete() override { completions++; }
+
+		// The test owns the batches.
+		void Release() override {}
+
+		std::vector< size_t > order;
+		std::vector< std::thread::id > threads;
+		size_t executed;
+		int completions;
+	};
+}
+
+TEST_CASE( ExecutesBatchedCallsInOneTrip )
+{
+	const size_t batchCount = 8;
+	std::vector< std::unique_ptr< MockBatch > > batches;
+	for( size_t i = 0; i < batchCount; i++ )
+		batches.emplace_back( new MockBatch( 50 ) );
+
+	WorkerPool pool( 4, nullptr, nullptr, nullptr );
+	for( auto&& batch : batches )
+		pool.Submit( batch.get() );
+
+	WaitExecuted( pool, batchCount );
+	CHECK_EQUAL( batchCount, pool.RunCompleted() );
+
+	// A batch is one task: its calls run in call order on a single worker.
+	CHECK_EQUAL( static_cast< uint64_t >( batchCount ), pool.GetStats().submitted );
+	for( auto&& batch : batches )
+	{
+		CHECK_EQUAL( 1, batch->completions );
+		for( size_t i = 0; i < batch->order.size(); i++ )
+		{
+			CHECK_EQUAL( i + 1, batch->order[ i ] );
+			CHECK( batch->threads[ i ] == batch->threads[ 0 ] );
+		}
+		CHECK( batch->threads[ 0 ] != std::this_thread::get_id() );
+	}
+}
@@ -0,0 +1,57 @@
+/**
+ * Checks that the synchronous scalar getters don't allocate.
+ *
+ *   node-gyp rebuild --debug && node test/allocations.js
+ *
+ * Needs a debug build of the addon, where allocationCount() counts the heap
+ * allocations of the addon. Uses the Scripting.Dictionary of scrrun.dll,
+ * whose IDictionary is dual, so both the vtable calls and IDispatch are
+ * checked. Exits with 1 if any of the getters allocated.
+ */
+'use strict';
+
+const path = require( 'path' );
+const cominterop = require( '..' );
+
+const iterations = 10000;
+
+if( typeof cominterop.allocationCount !== 'function' ) {
+    console.error( 'allocationCount() is only available in debug builds.' );
+    process.exit( 1 );
+}
+
+const lib = cominterop.load( path.join( process.env.SystemRoot, 'System32', 'scrrun.dll' ) );
+const dictionary = new lib.Dictionary();
+dictionary.Add( 'key', 1 );
+
+const getters = {
+    Count: () => dictionary.Count,
+    CompareMode: () => dictionary.CompareMode
+};
+
+function measure( name, getter ) {
+
+    // The first calls resolve the member and fill the caches.
+    for( let i = 0; i < 100; i++ )
+        getter();
+
+    const before = cominterop.allocationCount();
+    for( let i = 0; i < iterations; i++ )
+        getter();
+
+    return cominterop.allocationCount() - before;
+}
+
+let failed = false;
+for( const enabled of [ true, false ] ) {
+    cominterop.configureDirectCalls( { enabled } );
+    for( const name of Object.keys( getters ) ) {
+        const delta = measure( name, getters[ name ] );
+        const via = enabled ? 'vtable' : 'IDispatch';
+        console.log( `${ name } (${ via }): ${ delta } allocations in ${ iterations } calls` );
+        if( delta !== 0 )
+            failed = true;
+    }
+}
+
+process.exit( failed ? 1 : 0 );
@@ -0,0 +1,284 @@
+#!/usr/bin/env python3
+"""Writes sample.tlb, a small MSFT type library for the reader tests.
+
+The MIDL produced fixtures don't have dual interfaces or parameter defaults.
+This library covers those:
+
+    enum Color { Red = 1, Green = -5 };
+
+    [dual] interface IThing : IDispatch {
+        [propget, id(1)] HRESULT Name([out, retval] BSTR* pVal);
+        [propput, id(1)] HRESULT Name([in] BSTR newVal);
+        [id(2)] HRESULT GetColor([in, defaultvalue(2)] Color c, [out, retval] Color* pResult);
+        [id(3)] HRESULT Add([in] long index, [in] IThing* item);
+    };
+
+    coclass Thing { [default] interface IThing; };
+
+Usage: make_sample.py sample.tlb
+"""
+
+import struct
+import sys
+import uuid
+
+VT_I4 = 3
+VT_BSTR = 8
+VT_HRESULT = 25
+VT_PTR = 26
+VT_USERDEFINED = 29
+
+TKIND_ENUM = 0
+TKIND_DISPATCH = 4
+TKIND_COCLASS = 5
+
+STDOLE_GUID = '00020430-0000-0000-c000-000000000046'
+IDISPATCH_GUID = '00020400-0000-0000-c000-000000000046'
+
+TYPEFLAG_FCANCREATE = 0x2
+TYPEFLAG_FDUAL = 0x40
+TYPEFLAG_FDISPATCHABLE = 0x1000
+
+INVOKE_FUNC = 1
+INVOKE_PROPERTYGET = 2
+INVOKE_PROPERTYPUT = 4
+
+PARAMFLAG_FIN = 0x1
+PARAMFLAG_FOUT = 0x2
+PARAMFLAG_FRETVAL = 0x8
+PARAMFLAG_FHASDEFAULT = 0x20
+
+TYPEINFO_SIZE = 0x64
+HEADER_SIZE = 0x54
+SEGMENT_COUNT = 15
+
+
+def i16(v): return struct.pack('<h', v)
+def i32(v): return struct.pack('<i', v)
+def u32(v): return struct.pack('<I', v & 0xffffffff)
+
+
+def align(buffer, pad=b'\0'):
+    while len(buffer) % 4:
+        buffer.extend(pad)
+
+
+def simple(vt):
+    """Type descriptions of simple VARTYPEs are encoded in the value."""
+    return struct.unpack('<i', u32(0x80000000 | (vt << 16) | vt))[0]
+
+
+def packed(vt, value):
+    """Small constants are stored in the value offset itself."""
+    return struct.unpack('<i', u32(0x80000000 | (vt << 26) | value))[0]
+
+
+class Library:
+    def __init__(self):
+        self.names = bytearray()
+        self.name_offsets = {}
+        self.strings = bytearray()
+        self.guids = bytearray()
+        self.typedescs = bytearray()
+        self.custdata = bytearray()
+        self.reftab = bytearray()
+        self.impinfos = bytearray()
+        self.impfiles = bytearray()
+
+    def name(self, text):
+        if text not in self.name_offsets:
+            self.name_offsets[text] = len(self.names)
+            data = text.encode('latin-1')
+            self.names += i32(-1) + i32(-1) + i32(len(data)) + data
+            align(self.names, b'W')
+        return self.name_offsets[text]
+
+    def string(self, text):
+        offset = len(self.strings)
+        data = text.encode('latin-1')
+        self.strings += i16(len(data)) + data
+        align(self.strings, b'W')
+        return offset
+
+    def guid(self, data1, data4_last):
+        offset = len(self.guids)
+        self.guids += struct.pack('<IHH8B', data1, 0x2222, 0x3333, 1, 2, 3, 4, 5, 6, 7, data4_last)
+        self.guids += i32(-1) + i32(-1)
+        return offset
+
+    def raw_guid(self, text):
+        offset = len(self.guids)
+        self.guids += uuid.UUID(text).bytes_le + i32(-1) + i32(-1)
+        return offset
+
+    def typedesc(self, vt, data1, data2):
+        offset = len(self.typedescs)
+        self.typedescs += struct.pack('<hhhh', vt, 0, data1, data2)
+        return offset
+
+    def userdefined(self, hreftype):
+        return self.typedesc(VT_USERDEFINED, hreftype & 0xffff, hreftype >> 16)
+
+    def pointer(self, target):
+        # Pointers to simple types keep the VARTYPE with -1 as the second word.
+        if target < 0:
+            return self.typedesc(VT_PTR, target & 0xffff, -1)
+        return self.typedesc(VT_PTR, target, 0)
+
+    def value_i4(self, value):
+        offset = len(self.custdata)
+        self.custdata += i16(VT_I4) + i32(value)
+        align(self.custdata)
+        return offset
+
+    def import_dispatch(self):
+        """References IDispatch in stdole2.tlb and returns its HREFTYPE."""
+        file_offset = len(self.impfiles)
+        data = b'stdole2.tlb'
+        self.impfiles += i32(self.raw_guid(STDOLE_GUID)) + i32(0) + i32(2) + i16(len(data) << 2) + data
+        align(self.impfiles)
+
+        # MSFT_ImpInfo: count, flags (offset is a GUID), typekind, file, GUID.
+        offset = len(self.impinfos)
+        self.impinfos += i32(1 | (0x01 << 16) | (TKIND_DISPATCH << 24))
+        self.impinfos += i32(file_offset) + i32(self.raw_guid(IDISPATCH_GUID))
+        return offset | 1
+
+    def members(self, funcs, variables):
+        """Builds the member block of a type.
+
+        funcs: (name, memid, invkind, return type, [(type, name, flags, default)])
+        variables: (name, memid, value offset)
+        """
+        records = bytearray()
+        memids = []
+        names = []
+        offsets = []
+
+        for (name, memid, invkind, rettype, params) in funcs:
+            has_defaults = any(p[3] is not None for p in params)
+            kind = 1 | (invkind << 3) | (4 << 8) | (0x1000 if has_defaults else 0)
+            vtable_offset = 56 + len(offsets) * 8
+            body = i32(rettype) + i32(0) + i16(vtable_offset) + i16(0)
+            body += i32(kind) + i16(len(params)) + i16(0)
+            body += i32(0) + i32(-1)
+            if has_defaults:
+                for p in params:
+                    body += i32(self.value_i4(p[3]) if p[3] is not None else -1)
+            for (ptype, pname, pflags, _) in params:
+                body += i32(ptype) + i32(self.name(pname)) + i32(pflags)
+            offsets.append(len(records))
+            records += i32(len(body) + 4) + body
+            memids.append(memid)
+            # The second accessor of a property has no name of its own.
+            names.append(-1 if name is None else self.name(name))
+
+        for (name, memid, value) in variables:
+            body = i32(simple(VT_I4)) + i32(0) + i16(2) + i16(0x34) + i32(value)
+            offsets.append(len(records))
+            records += i32(len(body) + 4) + body
+            memids.append(memid)
+            names.append(self.name(name))
+
+        block = i32(len(records)) + records
+        for array in (memids, names, offsets):
+            for v in array:
+                block += i32(v)
+        return bytes(block)
+
+
+def build():
+    lib = Library()
+    href_color = 0 * TYPEINFO_SIZE
+    href_thing = 1 * TYPEINFO_SIZE
+
+    color = lib.userdefined(href_color)
+    thing = lib.userdefined(href_thing)
+    pcolor = lib.pointer(color)
+    pthing = lib.pointer(thing)
+    pbstr = lib.pointer(simple(VT_BSTR))
+
+    color_members = lib.members([], [
+        ('Red', 0x40000000, packed(VT_I4, 1)),
+        ('Green', 0x40000001, lib.value_i4(-5)),
+    ])
+    thing_members = lib.members([
+        ('Name', 1, INVOKE_PROPERTYGET, simple(VT_HRESULT),
+            [(pbstr, 'pVal', PARAMFLAG_FOUT | PARAMFLAG_FRETVAL, None)]),
+        (None, 1, INVOKE_PROPERTYPUT, simple(VT_HRESULT),
+            [(simple(VT_BSTR), 'newVal', PARAMFLAG_FIN, None)]),
+        ('GetColor', 2, INVOKE_FUNC, simple(VT_HRESULT),
+            [(color, 'c', PARAMFLAG_FIN | PARAMFLAG_FHASDEFAULT, 2),
+             (pcolor, 'pResult', PARAMFLAG_FOUT | PARAMFLAG_FRETVAL, None)]),
+        ('Add', 3, INVOKE_FUNC, simple(VT_HRESULT),
+            [(simple(VT_I4), 'index', PARAMFLAG_FIN, None),
+             (pthing, 'item', PARAMFLAG_FIN, None)]),
+    ], [])
+
+    href_dispatch = lib.import_dispatch()
+
+    # The coclass implements IThing as its default interface.
+    lib.reftab += i32(href_thing) + i32(1) + i32(-1) + i32(-1)
+
+    # name, typekind, members, (funcs, vars), guid, flags, datatype1, impltypes
+    types = [
+        ('Color', TKIND_ENUM, color_members, (0, 2), lib.guid(0x11111111, 1), 0, -1, 0),
+        ('IThing', TKIND_DISPATCH, thing_members, (4, 0), lib.guid(0x22222222, 2),
+            TYPEFLAG_FDUAL | TYPEFLAG_FDISPATCHABLE, href_dispatch, 1),
+        ('Thing', TKIND_COCLASS, None, (0, 0), lib.guid(0x33333333, 3), TYPEFLAG_FCANCREATE, 0, 1),
+    ]
+    lib_guid = lib.guid(0x99999999, 9)
+    lib_name = lib.name('SampleLib')
+    lib_doc = lib.string('Sample type library')
+    type_names = [lib.name(t[0]) for t in types]
+
+    data_offset = HEADER_SIZE + len(types) * 4 + SEGMENT_COUNT * 16
+    blob = bytearray(TYPEINFO_SIZE * len(types))
+    segments = {0: (data_offset, len(blob))}
+    for index, data in ((1, lib.impinfos), (2, lib.impfiles), (3, lib.reftab), (5, lib.guids), (7, lib.names), (8, lib.strings),
+                        (9, lib.typedescs), (11, lib.custdata)):
+        segments[index] = (data_offset + len(blob), len(data))
+        blob += data
+        align(blob)
+
+    member_offsets = []
+    for t in types:
+        member_offsets.append(data_offset + len(blob) if t[2] else -1)
+        if t[2]:
+            blob += t[2]
+
+    for i, (_, kind, _, (cfuncs, cvars), guid, flags, datatype1, cimpl) in enumerate(types):
+        info = bytearray(TYPEINFO_SIZE)
+        info[0x00:0x04] = i32(kind | (4 << 11))
+        info[0x04:0x08] = i32(member_offsets[i])
+        info[0x18:0x1c] = i32(cfuncs | (cvars << 16))
+        info[0x2c:0x30] = i32(guid)
+        info[0x30:0x34] = i32(flags)
+        info[0x34:0x38] = i32(type_names[i])
+        info[0x38:0x3c] = i32(1)
+        info[0x3c:0x40] = i32(-1)
+        info[0x48:0x4c] = i32(-1)
+        info[0x4c:0x4e] = i16(cimpl)
+        info[0x4e:0x50] = i16(7 * 8 + cfuncs * 8 if kind == TKIND_DISPATCH else 0)
+        info[0x50:0x54] = i32(4)
+        info[0x54:0x58] = i32(datatype1)
+        blob[i * TYPEINFO_SIZE:(i + 1) * TYPEINFO_SIZE] = info
+
+    # SYS_WIN64 with a help string, version 1.2.
+    header = u32(0x5446534d) + i32(0x00010002) + i32(lib_guid) + i32(0x409) + i32(0)
+    header += i32(0x40 | 3) + i32(1 | (2 << 16)) + i32(0) + i32(len(types)) + i32(lib_doc)
+    header += i32(0) + i32(0) + i32(len(lib.name_offsets)) + i32(len(lib.names)) + i32(lib_name)
+    header += i32(-1) + i32(-1) + i32(0x20) + i32(0x80) + i32(href_dispatch) + i32(len(lib.impinfos) // 12)
+    assert len(header) == HEADER_SIZE
+    for i in range(len(types)):
+        header += i32(i * TYPEINFO_SIZE)
+    for i in range(SEGMENT_COUNT):
+        offset, length = segments.get(i, (-1, 0))
+        header += i32(offset if length else -1) + i32(length) + i32(-1) + i32(0xf)
+
+    return bytes(header + blob)
+
+
+if __name__ == '__main__':
+    with open(sys.argv[1], 'wb') as out:
+        out.write(build())